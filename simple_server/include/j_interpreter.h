@@ -0,0 +1,104 @@
+/*
+ * J Interpreter C ABI
+ *
+ * Embeds the interpreter in a native process. Link against the crate's
+ * cdylib (libj_interpreter_wasm.so / .dylib) built for the host target.
+ *
+ * Typical use:
+ *
+ *   JInterpreterHandle *j = j_interpreter_new();
+ *   JCompiled *expr;
+ *   j_compile(j, "x + ~3", &expr);
+ *   int32_t x[3] = {10, 20, 30};
+ *   size_t shape[1] = {3};
+ *   j_bind(j, expr, "x", J_TYPE_INT32, x, 1, shape);
+ *   JResult *r;
+ *   if (j_execute(j, expr, &r) == J_OK && j_result_type(r) == J_TYPE_INT32) {
+ *       const int32_t *data = j_result_data(r);   // 10 21 32
+ *   }
+ *   j_result_free(r);
+ *   j_compiled_free(expr);
+ *   j_interpreter_free(j);
+ *
+ * Every function returning int returns one of the J_OK / J_ERR_* codes; on
+ * failure j_last_error() describes the problem. A handle and the objects
+ * used with it must not be shared between threads without external locking;
+ * use one handle per thread instead. A panic inside the interpreter is
+ * caught and reported as J_ERR_INTERNAL; it never unwinds into the caller.
+ */
+
+#ifndef J_INTERPRETER_H
+#define J_INTERPRETER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Status codes */
+#define J_OK                  0
+#define J_ERR_TOKEN           1
+#define J_ERR_PARSE           2
+#define J_ERR_SEMANTIC        3
+#define J_ERR_EVALUATION      4
+#define J_ERR_ARGUMENT        5
+#define J_ERR_UNREPRESENTABLE 6  /* result holds boxes, characters or complex numbers */
+#define J_ERR_INTERNAL        7  /* the interpreter panicked; the handle stays usable */
+
+/* Element types */
+#define J_TYPE_INT32   0
+#define J_TYPE_INT64   1  /* inputs only; values must fit in 32 bits */
+#define J_TYPE_FLOAT64 2
+#define J_TYPE_INT8    3  /* results only: integers stored one byte wide */
+#define J_TYPE_INT16   4  /* results only: integers stored two bytes wide */
+
+typedef struct JInterpreterHandle JInterpreterHandle;
+typedef struct JCompiled JCompiled;
+typedef struct JResult JResult;
+
+JInterpreterHandle *j_interpreter_new(void);
+void j_interpreter_free(JInterpreterHandle *handle);
+
+/* Message for the last failure on this handle, valid until the next call */
+const char *j_last_error(const JInterpreterHandle *handle);
+
+/* Tokenize, parse and analyse once; the result can be executed many times */
+int j_compile(JInterpreterHandle *handle, const char *expression, JCompiled **out);
+void j_compiled_free(JCompiled *compiled);
+
+/*
+ * Bind a name used in the expression to a caller-owned buffer of `rank`
+ * dimensions (row-major, `shape` has `rank` entries; rank 0 is a scalar).
+ * Nothing is copied here: the pointer is recorded and read by j_execute, so
+ * the buffer must stay valid and unchanged until that call returns. int32
+ * and float64 buffers are read in place there too; int64 ones are narrowed
+ * to 32 bits, which copies them. Shapes whose element count overflows or
+ * passes the interpreter's element limit fail with J_ERR_ARGUMENT.
+ * Rebinding a name replaces the previous binding.
+ */
+int j_bind(JInterpreterHandle *handle, JCompiled *compiled, const char *name,
+           int element_type, const void *data, size_t rank, const size_t *shape);
+
+/* Evaluate with the current bindings; *out must be released with j_result_free */
+int j_execute(JInterpreterHandle *handle, JCompiled *compiled, JResult **out);
+
+/*
+ * Borrowed views of a result, valid until j_result_free. Results already
+ * stored as a C array (packed integers, float buffers) are handed out in
+ * place, so the type says how wide the elements are; a result never points
+ * into a bound input buffer.
+ */
+int j_result_type(const JResult *result);  /* J_TYPE_INT8, _INT16, _INT32 or _FLOAT64 */
+size_t j_result_rank(const JResult *result);
+const size_t *j_result_shape(const JResult *result);
+size_t j_result_count(const JResult *result);
+const void *j_result_data(const JResult *result);
+void j_result_free(JResult *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* J_INTERPRETER_H */
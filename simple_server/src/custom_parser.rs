@@ -1,8 +1,10 @@
 // Custom Recursive Descent Parser - Phase 5 Implementation
-// Supports: array literals, basic addition, monadic operations (~, -), J array operators (#, {, ,, <), and parentheses
+// Supports: array literals, names, basic addition, monadic operations (~, -), J array operators (#, {, ,, <), adverbs, explicit definitions, and parentheses
 
-use crate::parser::{JNode, ParseError};
+use crate::explicit;
+use crate::parser::{JNode, JVerb, ParseError};
 use crate::tokenizer::Token;
+use std::sync::Arc;
 
 pub struct CustomParser {
     tokens: Vec<Token>,
@@ -35,7 +37,7 @@ impl CustomParser {
         // Handle dyadic addition (lowest precedence)
         while self.position < self.tokens.len() {
             match &self.tokens[self.position] {
-                Token::Verb('+') => {
+                Token::Verb('+') if self.at_plain_plus() => {
                     self.position += 1; // consume '+'
                     let right = self.parse_j_operators()?; // Right operand can also be J operators
                     left = JNode::AmbiguousVerb('+', Some(Box::new(left)), Some(Box::new(right)));
@@ -54,39 +56,14 @@ impl CustomParser {
     fn parse_j_operators(&mut self) -> Result<JNode, ParseError> {
         let mut left = self.parse_monadic()?;
         
+        // Every verb other than plain '+' binds at this level, left to right;
+        // the semantic analyzer rejects verbs without a dyadic form
         while self.position < self.tokens.len() {
             match &self.tokens[self.position] {
-                Token::Verb('#') => {
-                    self.position += 1;
-                    let right = self.parse_monadic()?;
-                    left = JNode::AmbiguousVerb('#', Some(Box::new(left)), Some(Box::new(right)));
-                }
-                Token::Verb('{') => {
-                    self.position += 1;
+                Token::Verb(_) | Token::Definition(_) if !self.at_plain_plus() => {
+                    let verb = self.parse_verb_phrase()?;
                     let right = self.parse_monadic()?;
-                    left = JNode::AmbiguousVerb('{', Some(Box::new(left)), Some(Box::new(right)));
-                }
-                Token::Verb(',') => {
-                    self.position += 1;
-                    let right = self.parse_monadic()?;
-                    left = JNode::AmbiguousVerb(',', Some(Box::new(left)), Some(Box::new(right)));
-                }
-                Token::Verb('<') => {
-                    self.position += 1;
-                    let right = self.parse_monadic()?;
-                    left = JNode::AmbiguousVerb('<', Some(Box::new(left)), Some(Box::new(right)));
-                }
-                Token::Verb('~') => {
-                    // Allow dyadic ~ to pass through to semantic analyzer (like LALRPOP)
-                    self.position += 1;
-                    let right = self.parse_monadic()?;
-                    left = JNode::AmbiguousVerb('~', Some(Box::new(left)), Some(Box::new(right)));
-                }
-                Token::Verb('-') => {
-                    // Allow dyadic - to pass through to semantic analyzer (like LALRPOP)
-                    self.position += 1;
-                    let right = self.parse_monadic()?;
-                    left = JNode::AmbiguousVerb('-', Some(Box::new(left)), Some(Box::new(right)));
+                    left = Self::apply(verb, Some(left), right);
                 }
                 _ => break,
             }
@@ -95,47 +72,62 @@ impl CustomParser {
     }
     
     fn parse_monadic(&mut self) -> Result<JNode, ParseError> {
-        // Handle monadic operators (higher precedence than dyadic)
-        if self.position < self.tokens.len() {
-            match &self.tokens[self.position] {
-                Token::Verb('~') => {
-                    self.position += 1; // consume '~'
-                    let operand = self.parse_primary()?;
-                    return Ok(JNode::AmbiguousVerb('~', None, Some(Box::new(operand))));
-                }
-                Token::Verb('-') => {
-                    self.position += 1; // consume '-'
-                    let operand = self.parse_primary()?;
-                    return Ok(JNode::AmbiguousVerb('-', None, Some(Box::new(operand))));
-                }
-                Token::Verb('#') => {
-                    self.position += 1; // consume '#'
-                    let operand = self.parse_primary()?;
-                    return Ok(JNode::AmbiguousVerb('#', None, Some(Box::new(operand))));
-                }
-                Token::Verb(',') => {
-                    self.position += 1; // consume ','
-                    let operand = self.parse_primary()?;
-                    return Ok(JNode::AmbiguousVerb(',', None, Some(Box::new(operand))));
-                }
-                Token::Verb('<') => {
-                    self.position += 1; // consume '<'
-                    let operand = self.parse_primary()?;
-                    return Ok(JNode::AmbiguousVerb('<', None, Some(Box::new(operand))));
-                }
-                Token::Verb('{') => {
-                    self.position += 1; // consume '{'
-                    let operand = self.parse_primary()?;
-                    return Ok(JNode::AmbiguousVerb('{', None, Some(Box::new(operand))));
-                }
-                _ => {}
-            }
+        // Handle monadic operators (higher precedence than dyadic); the
+        // semantic analyzer rejects verbs without a monadic form
+        if let Some(Token::Verb(_) | Token::Definition(_)) = self.tokens.get(self.position) {
+            let verb = self.parse_verb_phrase()?;
+            let operand = self.parse_monadic()?;
+            return Ok(Self::apply(verb, None, operand));
         }
         
         // Fall back to primary parsing
         self.parse_primary()
     }
     
+    // '+' on its own is addition, which binds loosest; with a modifier after
+    // it, it starts a derived verb like any other
+    fn at_plain_plus(&self) -> bool {
+        matches!(self.tokens.get(self.position), Some(Token::Verb('+')))
+            && !matches!(self.tokens.get(self.position + 1), Some(Token::Adverb(_) | Token::Conjunction(_)))
+    }
+    
+    // Consume a verb and the modifiers that follow it, which apply left to
+    // right; a conjunction takes the noun right after it (a literal, a name
+    // or a parenthesized expression) as its right operand. A {{ ... }}
+    // definition is compiled here, once, into an explicit verb.
+    fn parse_verb_phrase(&mut self) -> Result<JVerb, ParseError> {
+        let mut verb = match &self.tokens[self.position] {
+            Token::Verb(symbol) => JVerb::Primitive(*symbol),
+            Token::Definition(body) => JVerb::Explicit(Arc::new(explicit::compile(body)?)),
+            _ => unreachable!("parse_verb_phrase called off a verb"),
+        };
+        self.position += 1;
+        loop {
+            match self.tokens.get(self.position) {
+                Some(Token::Adverb(adverb)) => {
+                    verb = JVerb::Adverb(*adverb, Box::new(verb));
+                    self.position += 1;
+                }
+                Some(Token::Conjunction(conjunction)) => {
+                    let conjunction = *conjunction;
+                    self.position += 1;
+                    let noun = self.parse_primary()?;
+                    verb = JVerb::Conjunction(conjunction, Box::new(verb), Box::new(noun));
+                }
+                _ => return Ok(verb),
+            }
+        }
+    }
+    
+    // Node applying a verb phrase; primitives keep their own node so the
+    // semantic analyzer can resolve them as before
+    fn apply(verb: JVerb, left: Option<JNode>, right: JNode) -> JNode {
+        match verb {
+            JVerb::Primitive(symbol) => JNode::AmbiguousVerb(symbol, left.map(Box::new), Some(Box::new(right))),
+            derived => JNode::DerivedVerb(derived, left.map(Box::new), Box::new(right)),
+        }
+    }
+    
     fn parse_primary(&mut self) -> Result<JNode, ParseError> {
         if self.position >= self.tokens.len() {
             return Err(ParseError::NotImplemented(
@@ -169,11 +161,21 @@ impl CustomParser {
                 self.position += 1;
                 Ok(node)
             }
-            Token::Verb('~') | Token::Verb('-') | Token::Verb('#') | Token::Verb(',') | Token::Verb('<') | Token::Verb('{') => {
+            Token::Name(name) => {
+                let node = JNode::Name(name.clone());
+                self.position += 1;
+                Ok(node)
+            }
+            Token::Verb(_) => {
                 Err(ParseError::NotImplemented(
                     "Error: Operator found where literal expected".to_string()
                 ))
             }
+            Token::Adverb(_) | Token::Conjunction(_) => {
+                Err(ParseError::InvalidExpression(
+                    "Error: Adverb or conjunction must follow a verb".to_string()
+                ))
+            }
             _ => {
                 Err(ParseError::NotImplemented(
                     format!("Error: Unexpected token at position {}", self.position)
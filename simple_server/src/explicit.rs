@@ -0,0 +1,500 @@
+// Explicit Definition Module
+// Multi-statement verbs written {{ ... }}, with y (and x when dyadic) as
+// arguments, local names assigned with =. and the control structures if.,
+// while. and for. A body is compiled once, when the definition is parsed:
+// every sentence is parsed and analyzed up front, names are resolved to slots
+// of a frame, and control words become jumps. A call then only steps through
+// the instructions, reading locals in place rather than copying them.
+
+use crate::custom_parser::CustomParser;
+use crate::evaluator::{Bindings, EvaluationError, JEvaluator};
+use crate::j_array::{ArrayShape, JArray, Layout};
+use crate::parser::{JNode, JVerb, ParseError};
+use crate::semantic_analyzer::JSemanticAnalyzer;
+use crate::sharing;
+use crate::tokenizer::{JTokenizer, Token};
+use std::borrow::Cow;
+use std::fmt;
+
+pub const RIGHT_SLOT: usize = 0;
+pub const LEFT_SLOT: usize = 1;
+
+// Instructions a single call may execute before it is stopped, so a runaway
+// while. cannot hold a worker forever
+pub const STEP_LIMIT: usize = 1 << 28;
+
+#[derive(Debug)]
+pub struct ExplicitDefinition {
+    source: String,
+    slots: Vec<String>,
+    code: Vec<Instruction>,
+}
+
+// An analyzed sentence, assigning its value to a slot when `target` is set
+#[derive(Debug)]
+struct Sentence {
+    target: Option<usize>,
+    node: JNode,
+}
+
+#[derive(Debug)]
+enum Instruction {
+    // A sentence whose value becomes the result of the call
+    Run(Sentence),
+    // A sentence of a condition; the last one jumps when its value is false
+    Test(Sentence, Option<usize>),
+    Jump(usize),
+    // Evaluate the list of a for. and start stepping through its items
+    ForStart(Sentence),
+    // Bind the next item (and its index), or jump to `done` when none are left
+    ForNext { item: Option<usize>, index: Option<usize>, done: usize },
+    ForEnd,
+    Return,
+}
+
+enum Word {
+    Control(String),
+    Sentence(Vec<Token>),
+}
+
+impl fmt::Display for ExplicitDefinition {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        write!(f, "{{{{{}}}}}", self.source)
+    }
+}
+
+// Compile the body of a {{ ... }} definition
+pub fn compile(source: &str) -> Result<ExplicitDefinition, ParseError> {
+    let tokens = JTokenizer::new().tokenize(source)
+        .map_err(|e| invalid(format!("Token Error in definition: {}", e)))?;
+    let words = split_words(tokens);
+
+    // Every name the body assigns gets a slot after y and x
+    let mut slots = vec!["y".to_string(), "x".to_string()];
+    for word in &words {
+        let names = match word {
+            Word::Sentence(tokens) => match tokens.as_slice() {
+                [Token::Name(name), Token::Assign, ..] => vec![name.clone()],
+                _ => vec![],
+            },
+            Word::Control(control) => match control.strip_prefix("for_") {
+                Some(name) => vec![name.to_string(), format!("{}_index", name)],
+                None => vec![],
+            },
+        };
+        for name in names {
+            if !slots.contains(&name) {
+                slots.push(name);
+            }
+        }
+    }
+
+    let mut compiler = Compiler { words, position: 0, slots, code: Vec::new(), loops: Vec::new() };
+    if let Some(control) = compiler.block(&[])? {
+        return Err(invalid(format!("Unexpected {}. in definition", control)));
+    }
+    Ok(ExplicitDefinition { source: source.to_string(), slots: compiler.slots, code: compiler.code })
+}
+
+fn invalid(message: String) -> ParseError {
+    ParseError::InvalidExpression(message)
+}
+
+// Split a body into control words and the sentences between them
+fn split_words(tokens: Vec<Token>) -> Vec<Word> {
+    let mut words = Vec::new();
+    let mut sentence = Vec::new();
+    for token in tokens {
+        match token {
+            Token::Control(control) => {
+                if !sentence.is_empty() {
+                    words.push(Word::Sentence(std::mem::take(&mut sentence)));
+                }
+                words.push(Word::Control(control));
+            }
+            Token::Newline => {
+                if !sentence.is_empty() {
+                    words.push(Word::Sentence(std::mem::take(&mut sentence)));
+                }
+            }
+            token => sentence.push(token),
+        }
+    }
+    if !sentence.is_empty() {
+        words.push(Word::Sentence(sentence));
+    }
+    words
+}
+
+// Jump targets of an enclosing loop: continue. goes to `start`, and the
+// break. jumps are patched to the loop's exit once it is known
+struct Loop {
+    start: usize,
+    breaks: Vec<usize>,
+}
+
+struct Compiler {
+    words: Vec<Word>,
+    position: usize,
+    slots: Vec<String>,
+    code: Vec<Instruction>,
+    loops: Vec<Loop>,
+}
+
+impl Compiler {
+    fn emit(&mut self, instruction: Instruction) -> usize {
+        self.code.push(instruction);
+        self.code.len() - 1
+    }
+
+    fn here(&self) -> usize {
+        self.code.len()
+    }
+
+    fn patch(&mut self, at: usize, target: usize) {
+        match &mut self.code[at] {
+            Instruction::Jump(to) => *to = target,
+            Instruction::Test(_, Some(to)) => *to = target,
+            Instruction::ForNext { done, .. } => *done = target,
+            _ => unreachable!("patching an instruction without a target"),
+        }
+    }
+
+    // Compile sentences and nested structures up to one of the control words
+    // in `ends`, which is consumed and returned; None at the end of the body
+    fn block(&mut self, ends: &[&str]) -> Result<Option<String>, ParseError> {
+        while self.position < self.words.len() {
+            self.position += 1;
+            match &self.words[self.position - 1] {
+                Word::Sentence(tokens) => {
+                    let sentence = self.sentence(tokens)?;
+                    self.emit(Instruction::Run(sentence));
+                }
+                Word::Control(control) if ends.contains(&control.as_str()) => return Ok(Some(control.clone())),
+                Word::Control(control) => {
+                    let control = control.clone();
+                    self.control(&control)?;
+                }
+            }
+        }
+        if ends.is_empty() {
+            Ok(None)
+        } else {
+            Err(invalid(format!("Definition is missing {}.", ends[ends.len() - 1])))
+        }
+    }
+
+    // The sentences between a control word and its do.
+    fn condition(&mut self) -> Result<Vec<Sentence>, ParseError> {
+        let mut sentences = Vec::new();
+        loop {
+            self.position += 1;
+            match self.words.get(self.position - 1) {
+                Some(Word::Sentence(tokens)) => sentences.push(self.sentence(tokens)?),
+                Some(Word::Control(control)) if control == "do" => return Ok(sentences),
+                Some(Word::Control(control)) => return Err(invalid(format!("Unexpected {}. before do.", control))),
+                None => return Err(invalid("Definition is missing do.".to_string())),
+            }
+        }
+    }
+
+    // Emit a condition; the returned jump is taken when it is false. An
+    // empty condition is true, as in J.
+    fn test(&mut self) -> Result<Option<usize>, ParseError> {
+        let mut sentences = self.condition()?;
+        let last = sentences.pop();
+        for sentence in sentences {
+            self.emit(Instruction::Test(sentence, None));
+        }
+        Ok(last.map(|sentence| self.emit(Instruction::Test(sentence, Some(0)))))
+    }
+
+    fn control(&mut self, control: &str) -> Result<(), ParseError> {
+        match control {
+            "if" => {
+                let mut ends = Vec::new();
+                let mut test = self.test()?;
+                loop {
+                    let end = self.block(&["elseif", "else", "end"])?.unwrap_or_default();
+                    if end != "end" {
+                        ends.push(self.emit(Instruction::Jump(0)));
+                    }
+                    let next = self.here();
+                    if let Some(test) = test {
+                        self.patch(test, next);
+                    }
+                    match end.as_str() {
+                        "elseif" => test = self.test()?,
+                        "else" => {
+                            self.block(&["end"])?;
+                            break;
+                        }
+                        _ => break,
+                    }
+                }
+                let end = self.here();
+                for jump in ends {
+                    self.patch(jump, end);
+                }
+            }
+            "while" => {
+                let start = self.here();
+                let test = self.test()?;
+                self.loops.push(Loop { start, breaks: Vec::new() });
+                self.block(&["end"])?;
+                self.emit(Instruction::Jump(start));
+                let end = self.here();
+                if let Some(test) = test {
+                    self.patch(test, end);
+                }
+                self.close_loop(end);
+            }
+            "for" => self.for_loop(None, None)?,
+            "break" | "continue" => {
+                let at = match self.loops.last() {
+                    Some(current) => current.start,
+                    None => return Err(invalid(format!("{}. outside a loop", control))),
+                };
+                let jump = self.emit(Instruction::Jump(at));
+                if control == "break" {
+                    self.loops.last_mut().unwrap().breaks.push(jump);
+                }
+            }
+            "return" => {
+                self.emit(Instruction::Return);
+            }
+            _ => match control.strip_prefix("for_") {
+                Some(name) => {
+                    let item = self.slot(name);
+                    let index = self.slot(&format!("{}_index", name));
+                    self.for_loop(item, index)?;
+                }
+                None => return Err(invalid(format!("Unexpected {}. in definition", control))),
+            },
+        }
+        Ok(())
+    }
+
+    // for. runs its body once per item of the list; break. leaves through
+    // ForEnd so the list is dropped
+    fn for_loop(&mut self, item: Option<usize>, index: Option<usize>) -> Result<(), ParseError> {
+        let mut sentences = self.condition()?;
+        let list = sentences.pop().ok_or_else(|| invalid("for. needs a list".to_string()))?;
+        for sentence in sentences {
+            self.emit(Instruction::Test(sentence, None));
+        }
+        self.emit(Instruction::ForStart(list));
+        let start = self.emit(Instruction::ForNext { item, index, done: 0 });
+        self.loops.push(Loop { start, breaks: Vec::new() });
+        self.block(&["end"])?;
+        self.emit(Instruction::Jump(start));
+        let end = self.emit(Instruction::ForEnd);
+        self.patch(start, end);
+        self.close_loop(end);
+        Ok(())
+    }
+
+    fn close_loop(&mut self, end: usize) {
+        let finished = self.loops.pop().expect("closing a loop that was never opened");
+        for jump in finished.breaks {
+            self.patch(jump, end);
+        }
+    }
+
+    fn slot(&self, name: &str) -> Option<usize> {
+        self.slots.iter().position(|slot| slot == name)
+    }
+
+    // Parse and analyze one sentence, resolving its names to slots
+    fn sentence(&self, tokens: &[Token]) -> Result<Sentence, ParseError> {
+        let (target, tokens) = match tokens {
+            [Token::Name(name), Token::Assign, rest @ ..] => (self.slot(name), rest),
+            _ => (None, tokens),
+        };
+        if tokens.contains(&Token::Assign) {
+            return Err(invalid("Assignment must start a sentence".to_string()));
+        }
+        let node = CustomParser::new().parse(tokens.to_vec())?;
+        let node = JSemanticAnalyzer::new().resolve(node)
+            .map_err(|e| invalid(format!("Semantic Error in definition: {}", e)))?;
+        Ok(Sentence { target, node: self.localize(node)? })
+    }
+
+    fn localize(&self, node: JNode) -> Result<JNode, ParseError> {
+        let boxed = |node: Box<JNode>| self.localize(*node).map(Box::new);
+        Ok(match node {
+            JNode::Name(name) => match self.slot(&name) {
+                Some(slot) => JNode::Local(slot, name),
+                None => return Err(invalid(format!("Name '{}' is not assigned in the definition", name))),
+            },
+            JNode::Literal(_) | JNode::Local(_, _) => node,
+            JNode::Shared(_, _) => unreachable!("definition sentences are resolved without sharing"),
+            JNode::MonadicVerb(verb, arg) => JNode::MonadicVerb(verb, boxed(arg)?),
+            JNode::DyadicVerb(verb, left, right) => JNode::DyadicVerb(verb, boxed(left)?, boxed(right)?),
+            JNode::DerivedVerb(verb, left, right) => {
+                JNode::DerivedVerb(self.localize_phrase(verb)?, left.map(boxed).transpose()?, boxed(right)?)
+            }
+            JNode::AmbiguousVerb(verb, left, right) => {
+                JNode::AmbiguousVerb(verb, left.map(boxed).transpose()?, right.map(boxed).transpose()?)
+            }
+        })
+    }
+
+    fn localize_phrase(&self, verb: JVerb) -> Result<JVerb, ParseError> {
+        Ok(match verb {
+            JVerb::Primitive(_) | JVerb::Explicit(_) => verb,
+            JVerb::Adverb(adverb, operand) => JVerb::Adverb(adverb, Box::new(self.localize_phrase(*operand)?)),
+            JVerb::Conjunction(conjunction, operand, noun) => JVerb::Conjunction(
+                conjunction,
+                Box::new(self.localize_phrase(*operand)?),
+                Box::new(self.localize(*noun)?),
+            ),
+        })
+    }
+}
+
+// What the call will return: the value of the last sentence run, which an
+// assignment leaves in its slot rather than copying
+enum Last {
+    Nothing,
+    Value(JArray),
+    Slot(usize),
+}
+
+impl ExplicitDefinition {
+    // True when a call may roll or deal, so two calls can differ
+    pub fn draws_random(&self) -> bool {
+        self.code.iter().any(|instruction| match instruction {
+            Instruction::Run(sentence) | Instruction::Test(sentence, _) | Instruction::ForStart(sentence) => {
+                sharing::draws_random(&sentence.node)
+            }
+            _ => false,
+        })
+    }
+
+    pub fn call(&self, left: Option<&JArray>, right: &JArray) -> Result<JArray, EvaluationError> {
+        let evaluator = JEvaluator::new();
+        let bindings = Bindings::new();
+        let mut frame: Vec<Option<Cow<JArray>>> = vec![None; self.slots.len()];
+        frame[RIGHT_SLOT] = Some(Cow::Borrowed(right));
+        frame[LEFT_SLOT] = left.map(Cow::Borrowed);
+
+        let mut last = Last::Nothing;
+        let mut lists: Vec<(JArray, usize)> = Vec::new();
+        let mut pc = 0;
+        let mut steps = 0;
+        while pc < self.code.len() {
+            steps += 1;
+            if steps > STEP_LIMIT {
+                return Err(EvaluationError::DomainError(format!(
+                    "Definition stopped after {} steps", STEP_LIMIT
+                )));
+            }
+            pc += 1;
+            match &self.code[pc - 1] {
+                Instruction::Run(sentence) => {
+                    let value = evaluator.evaluate_in(&sentence.node, &bindings, &frame)?.into_owned();
+                    last = match sentence.target {
+                        Some(slot) => {
+                            frame[slot] = Some(Cow::Owned(value));
+                            Last::Slot(slot)
+                        }
+                        None => Last::Value(value),
+                    };
+                }
+                Instruction::Test(sentence, jump) => {
+                    let value = evaluator.evaluate_in(&sentence.node, &bindings, &frame)?;
+                    let truth = is_true(&value)?;
+                    if let Some(slot) = sentence.target {
+                        let value = value.into_owned();
+                        keep_last(&mut last, &mut frame, slot);
+                        frame[slot] = Some(Cow::Owned(value));
+                    }
+                    if let (Some(target), false) = (jump, truth) {
+                        pc = *target;
+                    }
+                }
+                Instruction::Jump(target) => pc = *target,
+                Instruction::ForStart(sentence) => {
+                    let list = evaluator.evaluate_in(&sentence.node, &bindings, &frame)?.into_owned();
+                    if let Some(slot) = sentence.target {
+                        keep_last(&mut last, &mut frame, slot);
+                        frame[slot] = Some(Cow::Owned(list.clone()));
+                    }
+                    lists.push((list, 0));
+                }
+                Instruction::ForNext { item, index, done } => {
+                    let (list, next) = lists.last_mut().expect("for. without a list");
+                    if *next >= item_count(list) {
+                        pc = *done;
+                        continue;
+                    }
+                    if let Some(slot) = *item {
+                        keep_last(&mut last, &mut frame, slot);
+                        load_item(&mut frame[slot], list, *next);
+                    }
+                    if let Some(slot) = *index {
+                        keep_last(&mut last, &mut frame, slot);
+                        frame[slot] = Some(Cow::Owned(JArray::scalar(*next as i32)));
+                    }
+                    *next += 1;
+                }
+                Instruction::ForEnd => {
+                    lists.pop();
+                }
+                Instruction::Return => break,
+            }
+        }
+
+        Ok(match last {
+            Last::Nothing => JArray::from_data(Vec::new(), ArrayShape::vector(0)),
+            Last::Value(value) => value,
+            Last::Slot(slot) => frame[slot].take().map(Cow::into_owned).expect("result slot was assigned"),
+        })
+    }
+}
+
+// Before a slot is overwritten by anything but a result sentence, move the
+// result out of it
+fn keep_last(last: &mut Last, frame: &mut [Option<Cow<JArray>>], slot: usize) {
+    if let Last::Slot(result) = *last {
+        if result == slot {
+            *last = Last::Value(frame[slot].take().map(Cow::into_owned).expect("result slot was assigned"));
+        }
+    }
+}
+
+// A condition is true when it is empty or its first atom is nonzero
+fn is_true(value: &JArray) -> Result<bool, EvaluationError> {
+    match value.elements().next() {
+        None => Ok(true),
+        Some(atom) => match atom.to_float() {
+            Some(number) => Ok(number != 0.0),
+            None => Err(EvaluationError::DomainError(format!(
+                "A condition must be numeric, not {}", atom.type_name()
+            ))),
+        },
+    }
+}
+
+fn item_count(list: &JArray) -> usize {
+    list.shape.dimensions.first().copied().unwrap_or(1)
+}
+
+// Bind item `index` of a for. list, writing over the previous item when it
+// is a dense array of the same shape so each iteration reuses one buffer
+fn load_item<'a>(slot: &mut Option<Cow<'a, JArray>>, list: &JArray, index: usize) {
+    if list.shape.rank() == 0 {
+        *slot = Some(Cow::Owned(list.clone()));
+        return;
+    }
+    let cell_shape = &list.shape.dimensions[1..];
+    let cell: usize = cell_shape.iter().product();
+    if let (Some(Cow::Owned(item)), Some(values)) = (slot.as_mut(), list.contiguous()) {
+        if matches!(item.layout, Layout::Dense) && item.shape.dimensions == cell_shape {
+            item.data.clone_from_slice(&values[index * cell..(index + 1) * cell]);
+            return;
+        }
+    }
+    *slot = Some(Cow::Owned(list.item(index)));
+}
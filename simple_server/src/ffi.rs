@@ -0,0 +1,363 @@
+// C ABI Module
+// Stable C interface for embedding the interpreter in native services.
+// See include/j_interpreter.h for the contract each function follows.
+//
+// Inputs are bound by pointer and are not read until j_execute, so binding
+// costs nothing per call; the caller keeps ownership and must keep the buffer
+// alive until the execution that uses it returns. int32 and float64 buffers
+// are read in place by the kernels (Buffer::Borrowed); int64 ones are
+// narrowed into an array of their own. Results are owned by a JResult whose
+// typed data, shape and count are borrowed until j_result_free: a result
+// already stored as a C array is handed out as it is, anything else is
+// converted once, and a result that is still the caller's buffer is copied
+// so that it does not outlive the binding.
+
+use crate::interpreter::{InterpreterError, JInterpreter, PreparedExpression};
+use crate::j_array::{check_elements, ArrayShape, Buffer, JArray, JValue, Layout, Packed, PackedInts};
+use std::collections::HashMap;
+use std::ffi::{CStr, CString};
+use std::os::raw::{c_char, c_int, c_void};
+use std::panic::{self, AssertUnwindSafe};
+use std::ptr;
+use std::sync::Arc;
+
+// Status codes
+pub const J_OK: c_int = 0;
+pub const J_ERR_TOKEN: c_int = 1;
+pub const J_ERR_PARSE: c_int = 2;
+pub const J_ERR_SEMANTIC: c_int = 3;
+pub const J_ERR_EVALUATION: c_int = 4;
+pub const J_ERR_ARGUMENT: c_int = 5;
+pub const J_ERR_UNREPRESENTABLE: c_int = 6;
+pub const J_ERR_INTERNAL: c_int = 7;
+
+// Element types
+pub const J_TYPE_INT32: c_int = 0;
+pub const J_TYPE_INT64: c_int = 1;
+pub const J_TYPE_FLOAT64: c_int = 2;
+// Results only: packed integers handed out at their stored width
+pub const J_TYPE_INT8: c_int = 3;
+pub const J_TYPE_INT16: c_int = 4;
+
+pub struct JInterpreterHandle {
+    interpreter: JInterpreter,
+    last_error: CString,
+}
+
+// A caller-owned input buffer, recorded at bind time and read at execute time
+struct BoundInput {
+    element_type: c_int,
+    data: *const c_void,
+    shape: Vec<usize>,
+}
+
+pub struct JCompiled {
+    prepared: PreparedExpression,
+    inputs: HashMap<String, BoundInput>,
+}
+
+pub struct JResult {
+    element_type: c_int,
+    shape: Vec<usize>,
+    count: usize,
+    data: ResultData,
+}
+
+// Where a result's elements live: in the evaluator's own buffer, or in one
+// converted for the caller
+enum ResultData {
+    Array(JArray),
+    Ints(Vec<i32>),
+    Floats(Vec<f64>),
+}
+
+impl JInterpreterHandle {
+    fn fail(&mut self, status: c_int, message: String) -> c_int {
+        self.last_error = CString::new(message.replace('\0', " ")).unwrap_or_default();
+        status
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn j_interpreter_new() -> *mut JInterpreterHandle {
+    Box::into_raw(Box::new(JInterpreterHandle {
+        interpreter: JInterpreter::new(),
+        last_error: CString::default(),
+    }))
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn j_interpreter_free(handle: *mut JInterpreterHandle) {
+    if !handle.is_null() {
+        drop(Box::from_raw(handle));
+    }
+}
+
+// Message for the most recent failure on this handle; valid until the next call
+#[no_mangle]
+pub unsafe extern "C" fn j_last_error(handle: *const JInterpreterHandle) -> *const c_char {
+    match handle.as_ref() {
+        Some(handle) => handle.last_error.as_ptr(),
+        None => ptr::null(),
+    }
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn j_compile(
+    handle: *mut JInterpreterHandle,
+    expression: *const c_char,
+    out: *mut *mut JCompiled,
+) -> c_int {
+    guarded(handle, || compile(handle, expression, out))
+}
+
+unsafe fn compile(handle: *mut JInterpreterHandle, expression: *const c_char, out: *mut *mut JCompiled) -> c_int {
+    let handle = match handle.as_mut() {
+        Some(handle) => handle,
+        None => return J_ERR_ARGUMENT,
+    };
+    if expression.is_null() || out.is_null() {
+        return handle.fail(J_ERR_ARGUMENT, "expression and out must not be null".to_string());
+    }
+    let expression = match CStr::from_ptr(expression).to_str() {
+        Ok(expression) => expression,
+        Err(_) => return handle.fail(J_ERR_ARGUMENT, "expression is not valid UTF-8".to_string()),
+    };
+
+    let prepared = match handle.interpreter.prepare(expression) {
+        Ok(prepared) => prepared,
+        Err(e) => {
+            let status = match e {
+                InterpreterError::TokenError(_) => J_ERR_TOKEN,
+                InterpreterError::ParseError(_) => J_ERR_PARSE,
+                InterpreterError::SemanticError(_) => J_ERR_SEMANTIC,
+                _ => J_ERR_EVALUATION,
+            };
+            return handle.fail(status, e.to_string());
+        }
+    };
+
+    *out = Box::into_raw(Box::new(JCompiled {
+        prepared,
+        inputs: HashMap::new(),
+    }));
+    J_OK
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn j_compiled_free(compiled: *mut JCompiled) {
+    if !compiled.is_null() {
+        drop(Box::from_raw(compiled));
+    }
+}
+
+// Bind `name` to a caller-owned buffer of `rank` dimensions given by `shape`
+#[no_mangle]
+pub unsafe extern "C" fn j_bind(
+    handle: *mut JInterpreterHandle,
+    compiled: *mut JCompiled,
+    name: *const c_char,
+    element_type: c_int,
+    data: *const c_void,
+    rank: usize,
+    shape: *const usize,
+) -> c_int {
+    let handle = match handle.as_mut() {
+        Some(handle) => handle,
+        None => return J_ERR_ARGUMENT,
+    };
+    let compiled = match compiled.as_mut() {
+        Some(compiled) => compiled,
+        None => return handle.fail(J_ERR_ARGUMENT, "compiled must not be null".to_string()),
+    };
+    if name.is_null() || (rank > 0 && shape.is_null()) {
+        return handle.fail(J_ERR_ARGUMENT, "name and shape must not be null".to_string());
+    }
+    if !matches!(element_type, J_TYPE_INT32 | J_TYPE_INT64 | J_TYPE_FLOAT64) {
+        return handle.fail(J_ERR_ARGUMENT, format!("unknown element type {}", element_type));
+    }
+    let name = match CStr::from_ptr(name).to_str() {
+        Ok(name) => name.to_string(),
+        Err(_) => return handle.fail(J_ERR_ARGUMENT, "name is not valid UTF-8".to_string()),
+    };
+    if !compiled.prepared.names().contains(&name) {
+        return handle.fail(J_ERR_ARGUMENT, format!("'{}' is not a name in this expression", name));
+    }
+    let shape = if rank == 0 { Vec::new() } else { std::slice::from_raw_parts(shape, rank).to_vec() };
+    // The count sizes the slice read from the caller's buffer, so it must
+    // neither wrap nor pass the element limit
+    let count = match check_elements(ArrayShape { dimensions: shape.clone() }.checked_elements()) {
+        Ok(count) => count,
+        Err(e) => return handle.fail(J_ERR_ARGUMENT, format!("Binding '{}': {}", name, e)),
+    };
+    if data.is_null() && count > 0 {
+        return handle.fail(J_ERR_ARGUMENT, "data must not be null".to_string());
+    }
+
+    compiled.inputs.insert(name, BoundInput { element_type, data, shape });
+    J_OK
+}
+
+// The evaluator's view of a bound buffer: int32 and float64 buffers are
+// borrowed in place, int64 ones narrowed into an array of their own. The
+// count was checked against the element limit when the buffer was bound.
+unsafe fn read_input(input: &BoundInput) -> Result<JArray, String> {
+    let shape = ArrayShape { dimensions: input.shape.clone() };
+    let count = shape.total_elements();
+    match input.element_type {
+        J_TYPE_INT32 => {
+            let ints = PackedInts::I32(Buffer::borrowed(input.data as *const i32, count));
+            Ok(JArray { data: Vec::new(), shape, layout: Layout::Packed(Arc::new(Packed::new(ints))) })
+        }
+        J_TYPE_INT64 => {
+            let values = std::slice::from_raw_parts(input.data as *const i64, count);
+            let ints = values.iter()
+                .map(|&v| i32::try_from(v).map_err(|_| format!("integer {} does not fit in 32 bits", v)))
+                .collect::<Result<Vec<_>, _>>()?;
+            Ok(JArray::from_ints(ints, shape))
+        }
+        _ => Ok(JArray::from_floats(Buffer::borrowed(input.data as *const f64, count), shape)),
+    }
+}
+
+// The result of an execution in a form the caller can read
+fn result_data(result: JArray) -> Result<(c_int, ResultData), String> {
+    // Packed integers and float buffers are handed out in place unless they
+    // are the caller's own input, which the result must not outlive
+    let own = !result.is_borrowed();
+    match (&result.layout, own) {
+        (Layout::Packed(packed), true) => {
+            let element_type = match &packed.ints {
+                PackedInts::I8(_) => J_TYPE_INT8,
+                PackedInts::I16(_) => J_TYPE_INT16,
+                PackedInts::I32(_) => J_TYPE_INT32,
+            };
+            return Ok((element_type, ResultData::Array(result)));
+        }
+        (Layout::Floats(_), true) => return Ok((J_TYPE_FLOAT64, ResultData::Array(result))),
+        (Layout::Floats(values), false) => return Ok((J_TYPE_FLOAT64, ResultData::Floats(values.to_vec()))),
+        _ => {}
+    }
+
+    // Everything else is converted once: int32 unless any element is a float
+    let has_float = result.elements().any(|v| matches!(*v, JValue::Float(_)));
+    let (mut ints, mut floats) = (Vec::new(), Vec::new());
+    for value in result.elements() {
+        match *value {
+            JValue::Integer(i) if has_float => floats.push(i as f64),
+            JValue::Integer(i) => ints.push(i),
+            JValue::Float(f) => floats.push(f),
+            ref other => return Err(format!("{} results cannot be returned through the C ABI", other.type_name())),
+        }
+    }
+    Ok(if has_float { (J_TYPE_FLOAT64, ResultData::Floats(floats)) } else { (J_TYPE_INT32, ResultData::Ints(ints)) })
+}
+
+// Run `call`, turning a panic into J_ERR_INTERNAL so that it never unwinds
+// into the C caller
+pub(crate) unsafe fn guarded(handle: *mut JInterpreterHandle, call: impl FnOnce() -> c_int) -> c_int {
+    match panic::catch_unwind(AssertUnwindSafe(call)) {
+        Ok(status) => status,
+        Err(payload) => {
+            let message = payload.downcast_ref::<&str>().map(|s| s.to_string())
+                .or_else(|| payload.downcast_ref::<String>().cloned())
+                .unwrap_or_else(|| "unknown panic".to_string());
+            match handle.as_mut() {
+                Some(handle) => handle.fail(J_ERR_INTERNAL, format!("Internal error: {}", message)),
+                None => J_ERR_INTERNAL,
+            }
+        }
+    }
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn j_execute(
+    handle: *mut JInterpreterHandle,
+    compiled: *mut JCompiled,
+    out: *mut *mut JResult,
+) -> c_int {
+    guarded(handle, || execute(handle, compiled, out))
+}
+
+unsafe fn execute(handle: *mut JInterpreterHandle, compiled: *mut JCompiled, out: *mut *mut JResult) -> c_int {
+    let handle = match handle.as_mut() {
+        Some(handle) => handle,
+        None => return J_ERR_ARGUMENT,
+    };
+    let compiled = match compiled.as_mut() {
+        Some(compiled) => compiled,
+        None => return handle.fail(J_ERR_ARGUMENT, "compiled must not be null".to_string()),
+    };
+    if out.is_null() {
+        return handle.fail(J_ERR_ARGUMENT, "out must not be null".to_string());
+    }
+
+    for (name, input) in &compiled.inputs {
+        let bound = read_input(input)
+            .and_then(|array| compiled.prepared.bind(name, array).map_err(|e| e.to_string()));
+        if let Err(msg) = bound {
+            return handle.fail(J_ERR_ARGUMENT, format!("Binding '{}': {}", name, msg));
+        }
+    }
+
+    let result = match handle.interpreter.execute_prepared(&compiled.prepared) {
+        Ok(result) => result,
+        Err(e) => return handle.fail(J_ERR_EVALUATION, e.to_string()),
+    };
+    let (shape, count) = (result.shape.dimensions.clone(), result.element_count());
+    let (element_type, data) = match result_data(result) {
+        Ok(data) => data,
+        Err(message) => return handle.fail(J_ERR_UNREPRESENTABLE, message),
+    };
+
+    *out = Box::into_raw(Box::new(JResult { element_type, shape, count, data }));
+    J_OK
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn j_result_type(result: *const JResult) -> c_int {
+    result.as_ref().map(|r| r.element_type).unwrap_or(-1)
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn j_result_rank(result: *const JResult) -> usize {
+    result.as_ref().map(|r| r.shape.len()).unwrap_or(0)
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn j_result_shape(result: *const JResult) -> *const usize {
+    result.as_ref().map(|r| r.shape.as_ptr()).unwrap_or(ptr::null())
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn j_result_count(result: *const JResult) -> usize {
+    result.as_ref().map(|r| r.count).unwrap_or(0)
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn j_result_data(result: *const JResult) -> *const c_void {
+    let result = match result.as_ref() {
+        Some(result) => result,
+        None => return ptr::null(),
+    };
+    match &result.data {
+        ResultData::Ints(values) => values.as_ptr() as *const c_void,
+        ResultData::Floats(values) => values.as_ptr() as *const c_void,
+        ResultData::Array(array) => match (&array.layout, array.floats()) {
+            (_, Some(values)) => values.as_ptr() as *const c_void,
+            (Layout::Packed(packed), _) => match &packed.ints {
+                PackedInts::I8(values) => values.as_ptr() as *const c_void,
+                PackedInts::I16(values) => values.as_ptr() as *const c_void,
+                PackedInts::I32(values) => values.as_ptr() as *const c_void,
+            },
+            _ => ptr::null(),
+        },
+    }
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn j_result_free(result: *mut JResult) {
+    if !result.is_null() {
+        drop(Box::from_raw(result));
+    }
+}
@@ -0,0 +1,222 @@
+// Histogram Module
+// Bincount (#:: y) counts each non-negative integer key; histogram (x #:: y)
+// counts keys in i.x, or values falling between the ascending edges x. The
+// input is split across threads, each counting into private bins that are
+// added together at the end. Packed keys are read in place, and keys spread
+// thinly over a wide range are counted in hash maps instead, giving a sparse
+// result. Dense counts are held to the element limit.
+//
+// J already spells base and antibase #. and #:, so these take #:: instead.
+
+use crate::evaluator::EvaluationError;
+use crate::j_array::{check_elements, ArrayShape, JArray, JValue, Layout, PackedElement, PackedInts, Sparse};
+use crate::verbs::{self, numeric_class, Element};
+use std::borrow::Cow;
+use std::collections::HashMap;
+
+// Counts over more bins than this, and than SPARSE_RATIO per key, are
+// counted in hash maps
+const SPARSE_MIN_BINS: usize = 1 << 16;
+const SPARSE_RATIO: usize = 4;
+
+// Copies of the bins a thread keeps when there are few bins, so that runs
+// of one key do not wait on a single counter
+const LANES: usize = 4;
+const LANE_MAX_BINS: usize = 1 << 12;
+const LANE_BLOCK: usize = 1 << 30;
+
+// Bincount (#::): the number of times each of i.>:>./y occurs in y
+pub fn bincount(array: &JArray) -> Result<JArray, EvaluationError> {
+    let keys = integer_keys(array, "Bincount")?;
+    let count = array.element_count();
+    let (min, max) = match (array.packed(), keys.as_ref()) {
+        (Some(packed), _) => (packed.min, packed.max),
+        (None, PackedInts::I8(keys)) => (extreme(keys, i32::min), extreme(keys, i32::max)),
+        (None, PackedInts::I16(keys)) => (extreme(keys, i32::min), extreme(keys, i32::max)),
+        (None, PackedInts::I32(keys)) => (extreme(keys, i32::min), extreme(keys, i32::max)),
+    };
+    if count == 0 {
+        return Ok(JArray::from_ints(Vec::new(), ArrayShape::vector(0)));
+    }
+    if min < 0 {
+        return Err(EvaluationError::DomainError("Bincount requires non-negative keys".to_string()));
+    }
+    count_keys(&keys, count, max as usize + 1)
+}
+
+// Histogram (x #:: y): with a scalar x, the counts of i.x in y (other keys
+// are not counted); with a list, the counts of y in each interval between
+// consecutive edges, the last interval including its upper edge
+pub fn histogram(bins: &JArray, values: &JArray) -> Result<JArray, EvaluationError> {
+    if bins.is_scalar() {
+        let bins = match *bins.element(0) {
+            JValue::Integer(n) if n >= 0 => n as usize,
+            _ => return Err(EvaluationError::DomainError("Histogram requires a non-negative bin count".to_string())),
+        };
+        return count_keys(&*integer_keys(values, "Histogram")?, values.element_count(), bins);
+    }
+    if bins.shape.rank() != 1 || bins.element_count() < 2 {
+        return Err(EvaluationError::RankError("Histogram requires a bin count or a list of edges".to_string()));
+    }
+    numeric_class(bins, "Histogram")?;
+    numeric_class(values, "Histogram")?;
+    let edges: Vec<f64> = bins.elements().map(|value| f64::read(&value)).collect();
+    if edges.windows(2).any(|pair| !(pair[0] < pair[1])) {
+        return Err(EvaluationError::DomainError("Histogram edges must be ascending".to_string()));
+    }
+    let counts = match (&values.layout, values.packed()) {
+        (_, Some(packed)) => match &packed.ints {
+            PackedInts::I8(keys) => count_edges(keys, |key| key.widen() as f64, &edges),
+            PackedInts::I16(keys) => count_edges(keys, |key| key.widen() as f64, &edges),
+            PackedInts::I32(keys) => count_edges(keys, |&key| key as f64, &edges),
+        },
+        (Layout::Dense, _) => count_edges(&values.data, f64::read, &edges),
+        _ => count_edges(&values.elements().map(|value| f64::read(&value)).collect::<Vec<_>>(), |&value| value, &edges),
+    };
+    Ok(counts_array(counts))
+}
+
+// The keys of an array as packed integers, borrowed when already packed
+fn integer_keys<'a>(array: &'a JArray, verb: &str) -> Result<Cow<'a, PackedInts>, EvaluationError> {
+    if let Some(packed) = array.packed() {
+        return Ok(Cow::Borrowed(&packed.ints));
+    }
+    let keys = array.elements()
+        .map(|value| match *value {
+            JValue::Integer(n) => Ok(n),
+            JValue::Float(f) if f.fract() == 0.0 && f.abs() <= i32::MAX as f64 => Ok(f as i32),
+            _ => Err(EvaluationError::DomainError(format!("{} requires integer keys", verb))),
+        })
+        .collect::<Result<Vec<_>, _>>()?;
+    Ok(Cow::Owned(PackedInts::I32(keys.into())))
+}
+
+// The counts of the `count` keys in [0, bins): sparse when the bins far
+// outnumber the keys, otherwise dense within the element limit
+fn count_keys(keys: &PackedInts, count: usize, bins: usize) -> Result<JArray, EvaluationError> {
+    if bins > SPARSE_MIN_BINS && bins > SPARSE_RATIO * count {
+        let counts = match keys {
+            PackedInts::I8(keys) => count_sparse(keys),
+            PackedInts::I16(keys) => count_sparse(keys),
+            PackedInts::I32(keys) => count_sparse(keys),
+        };
+        let (indices, values) = counts.into_iter()
+            .filter(|&(key, _)| key < bins)
+            .map(|(key, count)| (key, count_value(count)))
+            .unzip();
+        let sparse = Sparse::from_entries(indices, values, JValue::Integer(0), bins);
+        return Ok(JArray::from_sparse(sparse, ArrayShape::vector(bins)));
+    }
+    check_elements(Some(bins))?;
+    Ok(counts_array(count_ints(keys, bins)))
+}
+
+fn extreme<T: PackedElement>(keys: &[T], pick: fn(i32, i32) -> i32) -> i32 {
+    keys.iter().map(|key| key.widen()).reduce(pick).unwrap_or(0)
+}
+
+fn count_ints(keys: &PackedInts, bins: usize) -> Vec<u64> {
+    match keys {
+        PackedInts::I8(keys) => count_dense(keys, bins),
+        PackedInts::I16(keys) => count_dense(keys, bins),
+        PackedInts::I32(keys) => count_dense(keys, bins),
+    }
+}
+
+// Count keys in [0, bins) into private bins per thread. Each thread gets at
+// least `bins` keys, so adding the bins never outweighs counting.
+fn count_dense<T: PackedElement + Sync>(keys: &[T], bins: usize) -> Vec<u64> {
+    let threads = verbs::available_threads();
+    let chunk = keys.len().div_ceil(threads).max(bins);
+    let parts = verbs::in_parallel(keys, chunk, threads, &|part: &[T]| {
+        let lanes = if bins <= LANE_MAX_BINS { LANES } else { 1 };
+        let mut counts = vec![0u64; bins];
+        let mut lane_counts = vec![0u32; lanes * bins];
+        let count = |lane_counts: &mut [u32], lane: usize, key: &T| {
+            let key = key.widen() as u32 as usize;
+            if key < bins {
+                lane_counts[lane * bins + key] += 1;
+            }
+        };
+        // Lane counters are 32 bits wide, so they are flushed every block
+        for block in part.chunks(LANE_BLOCK) {
+            let mut groups = block.chunks_exact(lanes);
+            for group in &mut groups {
+                for (lane, key) in group.iter().enumerate() {
+                    count(&mut lane_counts, lane, key);
+                }
+            }
+            for key in groups.remainder() {
+                count(&mut lane_counts, 0, key);
+            }
+            for lane in lane_counts.chunks_mut(bins.max(1)) {
+                for (total, lane_count) in counts.iter_mut().zip(lane.iter_mut()) {
+                    *total += std::mem::take(lane_count) as u64;
+                }
+            }
+        }
+        counts
+    });
+    fold_bins(parts.into_iter(), bins)
+}
+
+// Count every key in hash maps, one per thread, returning (key, count) by key
+fn count_sparse<T: PackedElement + Sync>(keys: &[T]) -> Vec<(usize, u64)> {
+    let threads = verbs::available_threads();
+    let parts = verbs::in_parallel(keys, keys.len().div_ceil(threads), threads, &|part: &[T]| {
+        let mut counts: HashMap<i32, u64> = HashMap::new();
+        for key in part {
+            *counts.entry(key.widen()).or_default() += 1;
+        }
+        counts
+    });
+    let mut parts = parts.into_iter();
+    let mut counts = parts.next().unwrap_or_default();
+    for part in parts {
+        for (key, count) in part {
+            *counts.entry(key).or_default() += count;
+        }
+    }
+    let mut counts: Vec<(usize, u64)> = counts.into_iter().map(|(key, count)| (key as usize, count)).collect();
+    counts.sort_unstable();
+    counts
+}
+
+// Count values between consecutive edges into private bins per thread
+fn count_edges<T: Sync>(values: &[T], read: impl Fn(&T) -> f64 + Sync, edges: &[f64]) -> Vec<u64> {
+    let (bins, first, last) = (edges.len() - 1, edges[0], edges[edges.len() - 1]);
+    let threads = verbs::available_threads();
+    let parts = verbs::in_parallel(values, values.len().div_ceil(threads), threads, &|part: &[T]| {
+        let mut counts = vec![0u64; bins];
+        for value in part {
+            let value = read(value);
+            if value >= first && value <= last {
+                let bin = edges.partition_point(|&edge| edge <= value) - 1;
+                counts[bin.min(bins - 1)] += 1;
+            }
+        }
+        counts
+    });
+    fold_bins(parts.into_iter(), bins)
+}
+
+fn fold_bins(parts: impl Iterator<Item = Vec<u64>>, bins: usize) -> Vec<u64> {
+    parts.reduce(|mut total, part| {
+        total.iter_mut().zip(part).for_each(|(total, count)| *total += count);
+        total
+    }).unwrap_or_else(|| vec![0; bins])
+}
+
+fn count_value(count: u64) -> JValue {
+    i32::try_from(count).map_or(JValue::Float(count as f64), JValue::Integer)
+}
+
+// Counts as integers, or floats when one does not fit
+fn counts_array(counts: Vec<u64>) -> JArray {
+    let shape = ArrayShape::vector(counts.len());
+    if counts.iter().all(|&count| i32::try_from(count).is_ok()) {
+        JArray::from_ints(counts.into_iter().map(|count| count as i32).collect(), shape)
+    } else {
+        JArray::from_data(counts.into_iter().map(|count| JValue::Float(count as f64)).collect(), shape)
+    }
+}
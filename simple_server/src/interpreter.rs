@@ -1,12 +1,14 @@
 // J Interpreter Module
 // Main interface that coordinates all modules
 
-use crate::j_array::JArray;
+use crate::j_array::{JArray, JValue, ArrayShape};
 use crate::tokenizer::{JTokenizer, TokenError};
-use crate::parser::{JParser, ParseError, JNode};
+use crate::parser::{JParser, ParseError, JNode, JVerb};
+use crate::custom_parser::CustomParser;
 use crate::semantic_analyzer::{JSemanticAnalyzer, SemanticError};
-use crate::evaluator::{JEvaluator, EvaluationError};
+use crate::evaluator::{JEvaluator, EvaluationError, Bindings};
 use crate::visualizer::ParseTreeVisualizer;
+use std::collections::{HashMap, VecDeque};
 use std::fmt;
 
 // Unified interpreter error type
@@ -16,6 +18,7 @@ pub enum InterpreterError {
     ParseError(ParseError),
     SemanticError(SemanticError),
     EvaluationError(EvaluationError),
+    BindingError(String),
 }
 
 impl fmt::Display for InterpreterError {
@@ -25,6 +28,7 @@ impl fmt::Display for InterpreterError {
             InterpreterError::ParseError(e) => write!(f, "Parse error: {}", e),
             InterpreterError::SemanticError(e) => write!(f, "Semantic error: {}", e),
             InterpreterError::EvaluationError(e) => write!(f, "Evaluation error: {}", e),
+            InterpreterError::BindingError(msg) => write!(f, "Binding error: {}", msg),
         }
     }
 }
@@ -54,6 +58,115 @@ impl From<EvaluationError> for InterpreterError {
     }
 }
 
+// An expression analysed once and executed many times with different
+// values bound to its names
+#[derive(Debug, Clone)]
+pub struct PreparedExpression {
+    ast: JNode,
+    names: Vec<String>,
+    bindings: Bindings,
+}
+
+impl PreparedExpression {
+    // Names used by the expression, in order of first appearance
+    pub fn names(&self) -> &[String] {
+        &self.names
+    }
+
+    // Bind a value to one of the expression's names (replacing any previous value)
+    pub fn bind(&mut self, name: &str, value: JArray) -> Result<(), InterpreterError> {
+        if !self.names.iter().any(|n| n == name) {
+            return Err(InterpreterError::BindingError(
+                format!("'{}' is not a name in this expression", name)
+            ));
+        }
+        self.bindings.insert(name.to_string(), value);
+        Ok(())
+    }
+}
+
+// Prepared expressions by id; the oldest is evicted once the store is full
+pub const MAX_PREPARED: usize = 1024;
+
+pub struct PreparedStore {
+    next_id: u64,
+    order: VecDeque<u64>,
+    expressions: HashMap<u64, PreparedExpression>,
+}
+
+impl PreparedStore {
+    pub fn new() -> Self {
+        PreparedStore { next_id: 1, order: VecDeque::new(), expressions: HashMap::new() }
+    }
+
+    pub fn insert(&mut self, prepared: PreparedExpression) -> u64 {
+        let id = self.next_id;
+        self.next_id += 1;
+        self.order.push_back(id);
+        self.expressions.insert(id, prepared);
+        while self.order.len() > MAX_PREPARED {
+            if let Some(oldest) = self.order.pop_front() {
+                self.expressions.remove(&oldest);
+            }
+        }
+        id
+    }
+
+    pub fn get_mut(&mut self, id: u64) -> Option<&mut PreparedExpression> {
+        self.expressions.get_mut(&id)
+    }
+}
+
+// Collect names in order of first appearance
+fn collect_names(node: &JNode, names: &mut Vec<String>) {
+    match node {
+        JNode::Literal(_) | JNode::Local(_, _) => {}
+        JNode::Name(name) => {
+            if !names.contains(name) {
+                names.push(name.clone());
+            }
+        }
+        JNode::MonadicVerb(_, arg) => collect_names(arg, names),
+        JNode::Shared(common, body) => {
+            for node in common {
+                collect_names(node, names);
+            }
+            collect_names(body, names);
+        }
+        JNode::DyadicVerb(_, left, right) => {
+            collect_names(left, names);
+            collect_names(right, names);
+        }
+        JNode::DerivedVerb(verb, left, right) => {
+            collect_phrase_names(verb, names);
+            if let Some(left) = left {
+                collect_names(left, names);
+            }
+            collect_names(right, names);
+        }
+        JNode::AmbiguousVerb(_, left, right) => {
+            if let Some(left) = left {
+                collect_names(left, names);
+            }
+            if let Some(right) = right {
+                collect_names(right, names);
+            }
+        }
+    }
+}
+
+// Names used as conjunction operands inside a verb phrase
+fn collect_phrase_names(verb: &JVerb, names: &mut Vec<String>) {
+    match verb {
+        JVerb::Primitive(_) | JVerb::Explicit(_) => {}
+        JVerb::Adverb(_, operand) => collect_phrase_names(operand, names),
+        JVerb::Conjunction(_, operand, noun) => {
+            collect_phrase_names(operand, names);
+            collect_names(noun, names);
+        }
+    }
+}
+
 // Main J Interpreter
 pub struct JInterpreter {
     tokenizer: JTokenizer,
@@ -100,6 +213,79 @@ impl JInterpreter {
         
         Ok((result, parse_tree_text))
     }
+
+    // Tokenize, parse and analyse an expression once for repeated execution
+    pub fn prepare(&self, input: &str) -> Result<PreparedExpression, InterpreterError> {
+        let tokens = self.tokenizer.tokenize(input)?;
+        let ast = CustomParser::new().parse(tokens)?;
+        let ast = self.semantic_analyzer.analyze(ast)?;
+        
+        let mut names = Vec::new();
+        collect_names(&ast, &mut names);
+        
+        Ok(PreparedExpression { ast, names, bindings: Bindings::new() })
+    }
+
+    // Evaluate a prepared expression with its current bindings
+    pub fn execute_prepared(&self, prepared: &PreparedExpression) -> Result<JArray, InterpreterError> {
+        if let Some(missing) = prepared.names.iter().find(|n| !prepared.bindings.contains_key(*n)) {
+            return Err(InterpreterError::BindingError(format!("'{}' is not bound", missing)));
+        }
+        Ok(self.evaluator.evaluate_with(&prepared.ast, &prepared.bindings)?)
+    }
+
+    // Evaluate a prepared expression against bindings kept elsewhere, such as
+    // a workspace's values, without copying them into the expression
+    pub fn execute_prepared_with(&self, prepared: &PreparedExpression, bindings: &Bindings) -> Result<JArray, InterpreterError> {
+        Ok(self.evaluator.evaluate_with(&prepared.ast, bindings)?)
+    }
+}
+
+// Parse a bound value: whitespace-separated numbers, optionally preceded by a
+// shape and '$' (e.g. "2 3$1 2 3 4 5 6"). A single number is a scalar. This
+// reads numbers directly rather than running the expression pipeline.
+pub fn parse_binding_value(text: &str) -> Result<JArray, InterpreterError> {
+    let (shape_text, data_text) = match text.split_once('$') {
+        Some((shape, data)) => (Some(shape), data),
+        None => (None, text),
+    };
+    
+    // J writes negative numbers with a leading underscore
+    let float = |word: &str| word.replacen('_', "-", 1).parse::<f64>().ok();
+    let mut data = Vec::new();
+    for word in data_text.split_whitespace() {
+        let value = if let Ok(i) = word.replacen('_', "-", 1).parse::<i32>() {
+            Some(JValue::Integer(i))
+        } else if let Some((re, im)) = word.split_once('j') {
+            // A complex number has j between its parts, as in 1j_2
+            float(re).zip(float(im)).map(|parts| JValue::Complex(Box::new(parts)))
+        } else {
+            float(word).map(JValue::Float)
+        };
+        data.push(value.ok_or_else(|| InterpreterError::BindingError(format!("invalid number '{}'", word)))?);
+    }
+    
+    let dimensions = match shape_text {
+        Some(shape_text) => {
+            let mut dimensions = Vec::new();
+            for word in shape_text.split_whitespace() {
+                dimensions.push(word.parse::<usize>().map_err(|_| {
+                    InterpreterError::BindingError(format!("invalid dimension '{}'", word))
+                })?);
+            }
+            dimensions
+        }
+        None if data.len() == 1 => Vec::new(),
+        None => vec![data.len()],
+    };
+    
+    let shape = ArrayShape { dimensions };
+    if shape.total_elements() != data.len() {
+        return Err(InterpreterError::BindingError(format!(
+            "shape {:?} needs {} values, got {}", shape.dimensions, shape.total_elements(), data.len()
+        )));
+    }
+    Ok(JArray::from_values(data, shape))
 }
 
 // Format result for display
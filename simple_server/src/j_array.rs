@@ -1,7 +1,10 @@
 // J Array Data Structure Module - Enhanced Implementation
 // Core data types and operations for J language arrays with full multi-dimensional support
 
+use std::borrow::{Borrow, Cow};
 use std::fmt;
+use std::sync::atomic::{AtomicUsize, Ordering};
+use std::sync::{Arc, OnceLock};
 
 // Phase 1: Multi-Dimensional Array Support
 #[derive(Debug, Clone, PartialEq)]
@@ -27,11 +30,12 @@ impl ArrayShape {
     }
     
     pub fn total_elements(&self) -> usize {
-        if self.dimensions.is_empty() {
-            1 // scalar
-        } else {
-            self.dimensions.iter().product()
-        }
+        self.checked_elements().expect("array shapes are checked when arrays are built")
+    }
+    
+    // Element count, or None when it does not fit in a usize (a scalar has one)
+    pub fn checked_elements(&self) -> Option<usize> {
+        self.dimensions.iter().try_fold(1usize, |count, &dimension| count.checked_mul(dimension))
     }
     
     pub fn is_compatible_with(&self, other: &ArrayShape) -> bool {
@@ -45,6 +49,9 @@ impl ArrayShape {
 pub enum JValue {
     Integer(i32),
     Float(f64),
+    // Real and imaginary parts, out of line so that the other values stay
+    // small; complex arrays keep them in Layout::Complex instead
+    Complex(Box<(f64, f64)>),
     Character(char),
     Box(Box<JArray>),
 }
@@ -54,13 +61,14 @@ impl JValue {
         match self {
             JValue::Integer(_) => "integer",
             JValue::Float(_) => "float",
+            JValue::Complex(_) => "complex",
             JValue::Character(_) => "character",
             JValue::Box(_) => "box",
         }
     }
     
     pub fn is_numeric(&self) -> bool {
-        matches!(self, JValue::Integer(_) | JValue::Float(_))
+        matches!(self, JValue::Integer(_) | JValue::Float(_) | JValue::Complex(_))
     }
     
     pub fn to_integer(&self) -> Option<i32> {
@@ -85,12 +93,36 @@ impl fmt::Display for JValue {
         match self {
             JValue::Integer(i) => write!(f, "{}", i),
             JValue::Float(fl) => write!(f, "{}", fl),
+            JValue::Complex(parts) => write!(f, "{}j{}", parts.0, parts.1),
             JValue::Character(c) => write!(f, "{}", c),
             JValue::Box(boxed) => write!(f, "<{}>", boxed),
         }
     }
 }
 
+// Largest result, in elements, that verbs will build; requests for more fail
+// before anything is allocated. The server sets it with --max-elements.
+pub const DEFAULT_MAX_ELEMENTS: usize = 1 << 28;
+
+static MAX_ELEMENTS: AtomicUsize = AtomicUsize::new(DEFAULT_MAX_ELEMENTS);
+
+pub fn max_elements() -> usize {
+    MAX_ELEMENTS.load(Ordering::Relaxed)
+}
+
+pub fn set_max_elements(limit: usize) {
+    MAX_ELEMENTS.store(limit, Ordering::Relaxed);
+}
+
+// An element count that is within the limit; None stands for a count too
+// large to compute
+pub fn check_elements(count: Option<usize>) -> Result<usize, ArrayError> {
+    match count {
+        Some(count) if count <= max_elements() => Ok(count),
+        count => Err(ArrayError::TooLarge(count)),
+    }
+}
+
 // Phase 3: Error Handling System
 #[derive(Debug, Clone, PartialEq)]
 pub enum ArrayError {
@@ -101,6 +133,8 @@ pub enum ArrayError {
     DivisionByZero,
     EmptyArray,
     InvalidDimension(usize),
+    // Elements a result would need (None: too many to count)
+    TooLarge(Option<usize>),
 }
 
 impl std::fmt::Display for ArrayError {
@@ -119,40 +153,800 @@ impl std::fmt::Display for ArrayError {
             ArrayError::DivisionByZero => write!(f, "Division by zero"),
             ArrayError::EmptyArray => write!(f, "Operation on empty array"),
             ArrayError::InvalidDimension(dim) => write!(f, "Invalid dimension: {}", dim),
+            ArrayError::TooLarge(Some(count)) => {
+                write!(f, "Limit error: {} elements is more than the limit of {}", count, max_elements())
+            }
+            ArrayError::TooLarge(None) => write!(f, "Limit error: result size overflows"),
         }
     }
 }
 
 impl std::error::Error for ArrayError {}
 
-// Enhanced JArray Structure
+// Phase 6: Compact Layouts
+// How an array's elements are stored. Dense arrays hold every element in
+// `data`; compact layouts describe the elements more cheaply and leave `data`
+// empty. Kernels that understand a layout work on it directly; everything
+// else sees a dense copy (see JArray::to_dense).
+#[derive(Debug, Clone)]
+pub enum Layout {
+    Dense,
+    // Element i is pattern[i % pattern.len()] - the result of a cyclic
+    // reshape, costing O(pattern) memory whatever the shape
+    Repeated(Arc<Vec<JValue>>),
+    // Pieces joined by append, flattened once on first element access
+    Rope(Arc<Rope>),
+    // Integers stored at the narrowest width that holds them all
+    Packed(Arc<Packed>),
+    // Runs of equal elements, each stored once with its end position
+    Runs(Arc<Runs>),
+    // Only the elements that differ from a fill value (usually zero)
+    Sparse(Arc<Sparse>),
+    // Complex numbers as separate real and imaginary buffers
+    Complex(Arc<ComplexParts>),
+    // Floats as a plain f64 buffer, the way a C caller binds them
+    Floats(Arc<Buffer<f64>>),
+}
+
+// Elements owned by an array, or borrowed in place from memory it does not
+// own: a buffer bound through the C ABI, which the caller keeps alive and
+// unchanged while the execution that reads it runs (see ffi.rs). Only the C
+// ABI borrows, and the server binary builds it for its tests alone.
+#[cfg_attr(not(test), allow(dead_code))]
+pub enum Buffer<T> {
+    Owned(Vec<T>),
+    Borrowed { data: *const T, len: usize },
+}
+
+// A borrowed buffer is only read, and only during the call that bound it
+unsafe impl<T: Sync> Send for Buffer<T> {}
+unsafe impl<T: Sync> Sync for Buffer<T> {}
+
+impl<T> Buffer<T> {
+    // Borrow `len` elements at `data`, which must stay valid and unchanged
+    // for as long as the buffer is used
+    #[cfg_attr(not(test), allow(dead_code))]
+    pub unsafe fn borrowed(data: *const T, len: usize) -> Self {
+        if len == 0 {
+            return Buffer::Owned(Vec::new());
+        }
+        Buffer::Borrowed { data, len }
+    }
+    
+    pub fn is_borrowed(&self) -> bool {
+        matches!(self, Buffer::Borrowed { .. })
+    }
+}
+
+impl<T> std::ops::Deref for Buffer<T> {
+    type Target = [T];
+    fn deref(&self) -> &[T] {
+        match self {
+            Buffer::Owned(values) => values,
+            Buffer::Borrowed { data, len } => unsafe { std::slice::from_raw_parts(*data, *len) },
+        }
+    }
+}
+
+impl<T> From<Vec<T>> for Buffer<T> {
+    fn from(values: Vec<T>) -> Self {
+        Buffer::Owned(values)
+    }
+}
+
+// Cloning keeps a borrowed buffer borrowed; only owned elements are copied
+impl<T: Clone> Clone for Buffer<T> {
+    fn clone(&self) -> Self {
+        match self {
+            Buffer::Owned(values) => Buffer::Owned(values.clone()),
+            Buffer::Borrowed { data, len } => Buffer::Borrowed { data: *data, len: *len },
+        }
+    }
+}
+
+impl<T: PartialEq> PartialEq for Buffer<T> {
+    fn eq(&self, other: &Self) -> bool {
+        self[..] == other[..]
+    }
+}
+
+impl<T> fmt::Debug for Buffer<T> {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        write!(f, "Buffer {{ len: {}, borrowed: {} }}", self.len(), self.is_borrowed())
+    }
+}
+
+// Integer arrays of at least this many elements are packed on creation
+pub const PACK_MIN_ELEMENTS: usize = 1024;
+
+// Narrow integer storage: 1, 2 or 4 bytes per element instead of a full JValue
 #[derive(Debug, Clone, PartialEq)]
+pub enum PackedInts {
+    I8(Vec<i8>),
+    I16(Vec<i16>),
+    I32(Buffer<i32>),
+}
+
+// Integer element that can be read from packed storage
+pub trait PackedElement: Copy {
+    fn widen(self) -> i32;
+}
+
+impl PackedElement for i8 {
+    #[inline]
+    fn widen(self) -> i32 {
+        self as i32
+    }
+}
+
+impl PackedElement for i16 {
+    #[inline]
+    fn widen(self) -> i32 {
+        self as i32
+    }
+}
+
+impl PackedElement for i32 {
+    #[inline]
+    fn widen(self) -> i32 {
+        self
+    }
+}
+
+// A packed integer array with its value range and ordering, which are known
+// from packing and let kernels pick dense tables or binary searches
+pub struct Packed {
+    pub ints: PackedInts,
+    pub min: i32,
+    pub max: i32,
+    // Non-decreasing
+    pub sorted: bool,
+}
+
+impl Packed {
+    pub fn from_i32(values: Vec<i32>) -> Self {
+        let min = values.iter().copied().min().unwrap_or(0);
+        let max = values.iter().copied().max().unwrap_or(0);
+        let sorted = values.windows(2).all(|pair| pair[0] <= pair[1]);
+        let ints = if min >= i8::MIN as i32 && max <= i8::MAX as i32 {
+            PackedInts::I8(values.into_iter().map(|v| v as i8).collect())
+        } else if min >= i16::MIN as i32 && max <= i16::MAX as i32 {
+            PackedInts::I16(values.into_iter().map(|v| v as i16).collect())
+        } else {
+            PackedInts::I32(values.into())
+        };
+        Packed { ints, min, max, sorted }
+    }
+    
+    // Packed storage built directly at its width by a kernel that knew the
+    // range of its results in advance
+    pub fn new(ints: PackedInts) -> Self {
+        fn summary<T: PackedElement + Ord>(values: &[T]) -> (i32, i32, bool) {
+            let min = values.iter().min().map_or(0, |v| v.widen());
+            let max = values.iter().max().map_or(0, |v| v.widen());
+            (min, max, values.windows(2).all(|pair| pair[0] <= pair[1]))
+        }
+        let (min, max, sorted) = match &ints {
+            PackedInts::I8(values) => summary(values),
+            PackedInts::I16(values) => summary(values),
+            PackedInts::I32(values) => summary(values),
+        };
+        Packed { ints, min, max, sorted }
+    }
+    
+    pub fn len(&self) -> usize {
+        match &self.ints {
+            PackedInts::I8(values) => values.len(),
+            PackedInts::I16(values) => values.len(),
+            PackedInts::I32(values) => values.len(),
+        }
+    }
+    
+    // Bytes per element
+    pub fn width(&self) -> usize {
+        match &self.ints {
+            PackedInts::I8(_) => 1,
+            PackedInts::I16(_) => 2,
+            PackedInts::I32(_) => 4,
+        }
+    }
+    
+    // First position whose element is not below `value` (or above it, with
+    // `inclusive`); only meaningful when sorted
+    pub fn partition_point(&self, value: i32, inclusive: bool) -> usize {
+        let before = |v: i32| if inclusive { v <= value } else { v < value };
+        match &self.ints {
+            PackedInts::I8(values) => values.partition_point(|&v| before(v as i32)),
+            PackedInts::I16(values) => values.partition_point(|&v| before(v as i32)),
+            PackedInts::I32(values) => values.partition_point(|&v| before(v)),
+        }
+    }
+    
+    pub fn get(&self, index: usize) -> i32 {
+        match &self.ints {
+            PackedInts::I8(values) => values[index] as i32,
+            PackedInts::I16(values) => values[index] as i32,
+            PackedInts::I32(values) => values[index],
+        }
+    }
+    
+    // Elements as JValues, one at a time; nothing unpacked is kept
+    pub fn values(&self) -> impl Iterator<Item = JValue> + '_ {
+        (0..self.len()).map(|i| JValue::Integer(self.get(i)))
+    }
+}
+
+impl fmt::Debug for Packed {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        write!(f, "Packed {{ len: {}, width: {} }}", self.len(), self.width())
+    }
+}
+
+// Complex numbers structure-of-arrays: element i is re[i] + im[i]j. Kernels
+// run over the two f64 buffers as they would over a float array.
+#[derive(Clone)]
+pub struct ComplexParts {
+    pub re: Vec<f64>,
+    pub im: Vec<f64>,
+}
+
+impl ComplexParts {
+    pub fn new(re: Vec<f64>, im: Vec<f64>) -> Self {
+        assert_eq!(re.len(), im.len());
+        ComplexParts { re, im }
+    }
+    
+    // Parts of any numeric elements, reals getting a zero imaginary part;
+    // None when an element is not a number
+    pub fn from_values<V: Borrow<JValue>>(values: impl Iterator<Item = V>) -> Option<Self> {
+        let (mut re, mut im) = (Vec::new(), Vec::new());
+        for value in values {
+            let (r, i) = match value.borrow() {
+                JValue::Integer(n) => (*n as f64, 0.0),
+                JValue::Float(f) => (*f, 0.0),
+                JValue::Complex(parts) => **parts,
+                _ => return None,
+            };
+            re.push(r);
+            im.push(i);
+        }
+        Some(ComplexParts::new(re, im))
+    }
+    
+    pub fn len(&self) -> usize {
+        self.re.len()
+    }
+    
+    pub fn get(&self, index: usize) -> JValue {
+        JValue::Complex(Box::new((self.re[index], self.im[index])))
+    }
+}
+
+impl fmt::Debug for ComplexParts {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        write!(f, "ComplexParts {{ len: {} }}", self.len())
+    }
+}
+
+// Large integer arrays with at most one run per this many elements are
+// run-length encoded rather than packed
+pub const RUNS_MIN_FACTOR: usize = 8;
+
+// Run-length encoding: values[k] fills positions ends[k-1]..ends[k]
+pub struct Runs {
+    pub values: Vec<JValue>,
+    pub ends: Vec<usize>,
+}
+
+impl Runs {
+    // Encode a sequence, merging equal neighbours
+    pub fn encode<I: IntoIterator<Item = JValue>>(values: I) -> Self {
+        let mut runs = Runs { values: Vec::new(), ends: Vec::new() };
+        let mut len = 0;
+        for value in values {
+            len += 1;
+            runs.push_run(value, len);
+        }
+        runs
+    }
+    
+    // Build from runs that may have equal neighbours, merging them
+    pub fn from_runs(values: Vec<JValue>, ends: Vec<usize>) -> Self {
+        let mut runs = Runs { values: Vec::with_capacity(values.len()), ends: Vec::with_capacity(ends.len()) };
+        for (value, end) in values.into_iter().zip(ends) {
+            runs.push_run(value, end);
+        }
+        runs
+    }
+    
+    fn push_run(&mut self, value: JValue, end: usize) {
+        if self.values.last() == Some(&value) {
+            *self.ends.last_mut().unwrap() = end;
+        } else {
+            self.values.push(value);
+            self.ends.push(end);
+        }
+    }
+    
+    pub fn len(&self) -> usize {
+        self.ends.last().copied().unwrap_or(0)
+    }
+    
+    pub fn run_count(&self) -> usize {
+        self.values.len()
+    }
+    
+    // Element at a position, found by binary search over the run ends
+    pub fn get(&self, index: usize) -> &JValue {
+        &self.values[self.ends.partition_point(|&end| end <= index)]
+    }
+    
+    // (value, length) of every run in order
+    pub fn iter(&self) -> impl Iterator<Item = (&JValue, usize)> + '_ {
+        let starts = std::iter::once(0).chain(self.ends.iter().copied());
+        self.values.iter().zip(self.ends.iter().zip(starts).map(|(end, start)| end - start))
+    }
+    
+    // Elements expanded into a new buffer; nothing expanded is kept
+    pub fn expand(&self) -> Vec<JValue> {
+        let mut expanded = Vec::with_capacity(self.len());
+        for (value, length) in self.iter() {
+            expanded.extend(std::iter::repeat(value).take(length).cloned());
+        }
+        expanded
+    }
+}
+
+impl fmt::Debug for Runs {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        write!(f, "Runs {{ len: {}, runs: {} }}", self.len(), self.run_count())
+    }
+}
+
+// Large integer arrays with at most one nonzero per this many elements
+// (and fewer nonzeros than runs) are stored sparse
+pub const SPARSE_MIN_FACTOR: usize = 16;
+
+// Coordinate storage: the row-major positions of the non-fill elements, in
+// increasing order, with their values. For a matrix, position / columns is
+// the row, so rows are contiguous ranges of the entries as in CSR.
+pub struct Sparse {
+    pub indices: Vec<usize>,
+    pub values: Vec<JValue>,
+    pub fill: JValue,
+    len: usize,
+}
+
+impl Sparse {
+    // Encode a sequence, keeping the elements that differ from `fill`
+    pub fn encode<I: IntoIterator<Item = JValue>>(values: I, fill: JValue) -> Self {
+        let mut sparse = Sparse::from_entries(Vec::new(), Vec::new(), fill, 0);
+        for (index, value) in values.into_iter().enumerate() {
+            if value != sparse.fill {
+                sparse.indices.push(index);
+                sparse.values.push(value);
+            }
+            sparse.len = index + 1;
+        }
+        sparse
+    }
+    
+    // Build from sorted entries, dropping any that equal the fill
+    pub fn from_entries(indices: Vec<usize>, values: Vec<JValue>, fill: JValue, len: usize) -> Self {
+        let (indices, values) = if values.iter().any(|v| *v == fill) {
+            indices.into_iter().zip(values).filter(|(_, v)| *v != fill).unzip()
+        } else {
+            (indices, values)
+        };
+        Sparse { indices, values, fill, len }
+    }
+    
+    pub fn len(&self) -> usize {
+        self.len
+    }
+    
+    pub fn nonzero_count(&self) -> usize {
+        self.indices.len()
+    }
+    
+    pub fn get(&self, index: usize) -> &JValue {
+        match self.indices.binary_search(&index) {
+            Ok(k) => &self.values[k],
+            Err(_) => &self.fill,
+        }
+    }
+    
+    // (position, value) of every stored entry in order
+    pub fn entries(&self) -> impl Iterator<Item = (usize, &JValue)> + '_ {
+        self.indices.iter().copied().zip(self.values.iter())
+    }
+    
+    // Elements expanded into a new buffer; nothing expanded is kept
+    pub fn expand(&self) -> Vec<JValue> {
+        let mut expanded = vec![self.fill.clone(); self.len];
+        for (index, value) in self.entries() {
+            expanded[index] = value.clone();
+        }
+        expanded
+    }
+}
+
+impl fmt::Debug for Sparse {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        write!(f, "Sparse {{ len: {}, nonzeros: {} }}", self.len, self.nonzero_count())
+    }
+}
+
+// Appends producing at least this many elements build a rope rather than
+// copying the left argument
+pub const ROPE_MIN_ELEMENTS: usize = 1024;
+
+// A chain of appended pieces. Appending to a rope links a new piece to the
+// existing chain, so building an array from k pieces costs O(n + k) rather
+// than copying the growing prefix on every append. Only the rope an array
+// holds keeps a flattened copy; the pieces of the chain keep none, so a
+// chain built one append at a time never holds a copy of every prefix.
+pub struct Rope {
+    last: Arc<RopePiece>,
+    len: usize,
+    flat: OnceLock<Vec<JValue>>,
+}
+
+// One appended piece and the pieces before it
+struct RopePiece {
+    prefix: Option<Arc<RopePiece>>,
+    values: Vec<JValue>,
+}
+
+impl Rope {
+    // The rope of `left` followed by `right`
+    pub fn new(left: Vec<JValue>, right: Vec<JValue>) -> Self {
+        let len = left.len();
+        let first = Rope { last: Arc::new(RopePiece { prefix: None, values: left }), len, flat: OnceLock::new() };
+        first.append(right)
+    }
+    
+    // A new rope sharing this one's pieces, with `values` after them
+    pub fn append(&self, values: Vec<JValue>) -> Self {
+        let len = self.len + values.len();
+        let last = Arc::new(RopePiece { prefix: Some(Arc::clone(&self.last)), values });
+        Rope { last, len, flat: OnceLock::new() }
+    }
+    
+    // Every element in order, assembled on first use
+    pub fn flat(&self) -> &[JValue] {
+        self.flat.get_or_init(|| {
+            let mut pieces = Vec::new();
+            let mut piece = Some(&*self.last);
+            while let Some(current) = piece {
+                pieces.push(current.values.as_slice());
+                piece = current.prefix.as_deref();
+            }
+            let mut flat = Vec::with_capacity(self.len);
+            for values in pieces.iter().rev() {
+                flat.extend_from_slice(values);
+            }
+            flat
+        })
+    }
+}
+
+// Unlink the chain iteratively; recursive drops would overflow the stack
+impl Drop for RopePiece {
+    fn drop(&mut self) {
+        let mut prefix = self.prefix.take();
+        while let Some(piece) = prefix {
+            match Arc::try_unwrap(piece) {
+                Ok(mut piece) => prefix = piece.prefix.take(),
+                Err(_) => break,
+            }
+        }
+    }
+}
+
+impl fmt::Debug for Rope {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        write!(f, "Rope {{ len: {} }}", self.len)
+    }
+}
+
+// Reshapes producing at least this many elements (and at least
+// REPEAT_MIN_FACTOR times the source) are kept as a repeated pattern
+pub const REPEAT_MIN_ELEMENTS: usize = 1024;
+pub const REPEAT_MIN_FACTOR: usize = 4;
+
+// Enhanced JArray Structure
+#[derive(Debug, Clone)]
 pub struct JArray {
     pub data: Vec<JValue>,
     pub shape: ArrayShape,
+    pub layout: Layout,
+}
+
+// Arrays are equal when shapes and elements match, whatever their layouts
+impl PartialEq for JArray {
+    fn eq(&self, other: &JArray) -> bool {
+        if self.shape != other.shape {
+            return false;
+        }
+        match (&self.layout, &other.layout) {
+            (Layout::Dense, Layout::Dense) => self.data == other.data,
+            _ => (0..self.element_count()).all(|i| self.element(i) == other.element(i)),
+        }
+    }
 }
 
 impl JArray {
+    // Dense array from its elements in row-major order
+    pub fn from_data(data: Vec<JValue>, shape: ArrayShape) -> Self {
+        JArray { data, shape, layout: Layout::Dense }
+    }
+    
+    // Array of `shape` whose elements cycle through `pattern`
+    pub fn repeated(pattern: Vec<JValue>, shape: ArrayShape) -> Self {
+        JArray { data: Vec::new(), shape, layout: Layout::Repeated(Arc::new(pattern)) }
+    }
+    
     pub fn scalar(value: i32) -> Self {
-        JArray {
-            data: vec![JValue::Integer(value)],
-            shape: ArrayShape::scalar(),
-        }
+        JArray::from_data(vec![JValue::Integer(value)], ArrayShape::scalar())
     }
     
     pub fn vector(values: Vec<i32>) -> Self {
         let len = values.len();
-        JArray {
-            data: values.into_iter().map(JValue::Integer).collect(),
-            shape: ArrayShape::vector(len),
-        }
+        JArray::from_ints(values, ArrayShape::vector(len))
     }
     
     pub fn matrix(values: Vec<i32>, rows: usize, cols: usize) -> Self {
         assert_eq!(values.len(), rows * cols);
-        JArray {
-            data: values.into_iter().map(JValue::Integer).collect(),
-            shape: ArrayShape::matrix(rows, cols),
+        JArray::from_ints(values, ArrayShape::matrix(rows, cols))
+    }
+    
+    // Integer array; large ones are stored sparse when mostly zero, run-length
+    // encoded when mostly long runs, and packed to their narrowest width otherwise
+    pub fn from_ints(values: Vec<i32>, shape: ArrayShape) -> Self {
+        if values.len() >= PACK_MIN_ELEMENTS {
+            let run_count = 1 + values.windows(2).filter(|pair| pair[0] != pair[1]).count();
+            let nonzero_count = values.iter().filter(|&&v| v != 0).count();
+            if nonzero_count * SPARSE_MIN_FACTOR <= values.len() && nonzero_count < run_count {
+                let sparse = Sparse::encode(values.into_iter().map(JValue::Integer), JValue::Integer(0));
+                return JArray::from_sparse(sparse, shape);
+            }
+            if run_count * RUNS_MIN_FACTOR <= values.len() {
+                let runs = Runs::encode(values.into_iter().map(JValue::Integer));
+                return JArray::from_runs(runs, shape);
+            }
+            JArray { data: Vec::new(), shape, layout: Layout::Packed(Arc::new(Packed::from_i32(values))) }
+        } else {
+            JArray::from_data(values.into_iter().map(JValue::Integer).collect(), shape)
+        }
+    }
+    
+    // Integer array from storage already packed; small ones are kept dense
+    // as from_ints would
+    pub fn from_packed(ints: PackedInts, shape: ArrayShape) -> Self {
+        let packed = Packed::new(ints);
+        if packed.len() < PACK_MIN_ELEMENTS {
+            return JArray::from_data((0..packed.len()).map(|i| JValue::Integer(packed.get(i))).collect(), shape);
+        }
+        JArray { data: Vec::new(), shape, layout: Layout::Packed(Arc::new(packed)) }
+    }
+    
+    pub fn from_runs(runs: Runs, shape: ArrayShape) -> Self {
+        JArray { data: Vec::new(), shape, layout: Layout::Runs(Arc::new(runs)) }
+    }
+    
+    // Run-length encoded copy of this array
+    pub fn run_length_encode(&self) -> JArray {
+        match &self.layout {
+            Layout::Runs(_) => self.clone(),
+            _ => JArray::from_runs(Runs::encode(self.elements().map(Cow::into_owned)), self.shape.clone()),
+        }
+    }
+    
+    // Complex array from its real and imaginary parts
+    pub fn from_complex(re: Vec<f64>, im: Vec<f64>, shape: ArrayShape) -> Self {
+        JArray { data: Vec::new(), shape, layout: Layout::Complex(Arc::new(ComplexParts::new(re, im))) }
+    }
+    
+    // Array over a float buffer, owned or borrowed
+    pub fn from_floats(values: Buffer<f64>, shape: ArrayShape) -> Self {
+        JArray { data: Vec::new(), shape, layout: Layout::Floats(Arc::new(values)) }
+    }
+    
+    pub fn floats(&self) -> Option<&[f64]> {
+        match &self.layout {
+            Layout::Floats(values) => Some(values),
+            _ => None,
+        }
+    }
+    
+    // True when the elements are read from a buffer the array does not own
+    #[cfg_attr(not(test), allow(dead_code))]
+    pub fn is_borrowed(&self) -> bool {
+        match &self.layout {
+            Layout::Packed(packed) => matches!(&packed.ints, PackedInts::I32(values) if values.is_borrowed()),
+            Layout::Floats(values) => values.is_borrowed(),
+            _ => false,
+        }
+    }
+    
+    pub fn complex(&self) -> Option<&ComplexParts> {
+        match &self.layout {
+            Layout::Complex(parts) => Some(parts),
+            _ => None,
+        }
+    }
+    
+    // Array of `data`, with complex numbers moved into the complex layout
+    pub fn from_values(data: Vec<JValue>, shape: ArrayShape) -> Self {
+        if data.iter().any(|value| matches!(value, JValue::Complex(_))) {
+            if let Some(parts) = ComplexParts::from_values(data.iter()) {
+                return JArray::from_complex(parts.re, parts.im, shape);
+            }
+        }
+        JArray::from_data(data, shape)
+    }
+    
+    // Real and imaginary parts of a numeric array, borrowed when it is
+    // stored that way; reals get a zero imaginary part. None when an element
+    // is not a number.
+    pub fn complex_parts(&self) -> Option<Cow<'_, ComplexParts>> {
+        match &self.layout {
+            Layout::Complex(parts) => Some(Cow::Borrowed(parts)),
+            Layout::Packed(packed) => {
+                let re = packed.values().filter_map(|v| v.to_float()).collect();
+                Some(Cow::Owned(ComplexParts::new(re, vec![0.0; packed.len()])))
+            }
+            _ => ComplexParts::from_values(self.elements()).map(Cow::Owned),
+        }
+    }
+    
+    // The elements at `positions` as an array of `shape`, gathered straight
+    // from the buffers of a packed or complex array
+    fn gather(&self, positions: impl Iterator<Item = usize>, shape: ArrayShape) -> JArray {
+        match &self.layout {
+            Layout::Packed(packed) => JArray::from_ints(positions.map(|i| packed.get(i)).collect(), shape),
+            Layout::Complex(parts) => {
+                let (re, im) = positions.map(|i| (parts.re[i], parts.im[i])).unzip();
+                JArray::from_complex(re, im, shape)
+            }
+            _ => JArray::from_data(positions.map(|i| self.value(i)).collect(), shape),
+        }
+    }
+    
+    pub fn from_sparse(sparse: Sparse, shape: ArrayShape) -> Self {
+        JArray { data: Vec::new(), shape, layout: Layout::Sparse(Arc::new(sparse)) }
+    }
+    
+    // Sparse copy of this array, storing only the elements that differ from `fill`
+    pub fn to_sparse(&self, fill: JValue) -> JArray {
+        match &self.layout {
+            Layout::Sparse(sparse) if sparse.fill == fill => self.clone(),
+            _ => JArray::from_sparse(Sparse::encode(self.elements().map(Cow::into_owned), fill), self.shape.clone()),
+        }
+    }
+    
+    pub fn sparse(&self) -> Option<&Sparse> {
+        match &self.layout {
+            Layout::Sparse(sparse) => Some(sparse),
+            _ => None,
+        }
+    }
+    
+    pub fn runs(&self) -> Option<&Runs> {
+        match &self.layout {
+            Layout::Runs(runs) => Some(runs),
+            _ => None,
+        }
+    }
+    
+    pub fn packed(&self) -> Option<&Packed> {
+        match &self.layout {
+            Layout::Packed(packed) => Some(packed),
+            _ => None,
+        }
+    }
+    
+    pub fn is_dense(&self) -> bool {
+        matches!(self.layout, Layout::Dense)
+    }
+    
+    pub fn element_count(&self) -> usize {
+        self.shape.total_elements()
+    }
+    
+    // Element at a row-major position, whatever the layout: borrowed where
+    // the layout holds JValues, made on the spot from packed integers
+    pub fn element(&self, index: usize) -> Cow<'_, JValue> {
+        match &self.layout {
+            Layout::Dense => Cow::Borrowed(&self.data[index]),
+            Layout::Repeated(pattern) => Cow::Borrowed(&pattern[index % pattern.len()]),
+            Layout::Rope(rope) => Cow::Borrowed(&rope.flat()[index]),
+            Layout::Packed(packed) => Cow::Owned(JValue::Integer(packed.get(index))),
+            Layout::Runs(runs) => Cow::Borrowed(runs.get(index)),
+            Layout::Sparse(sparse) => Cow::Borrowed(sparse.get(index)),
+            Layout::Complex(parts) => Cow::Owned(parts.get(index)),
+            Layout::Floats(values) => Cow::Owned(JValue::Float(values[index])),
+        }
+    }
+    
+    // Element at a row-major position by value
+    pub fn value(&self, index: usize) -> JValue {
+        match &self.layout {
+            Layout::Complex(parts) => parts.get(index),
+            _ => self.element(index).into_owned(),
+        }
+    }
+    
+    // Elements in row-major order, whatever the layout
+    pub fn elements(&self) -> impl Iterator<Item = Cow<'_, JValue>> + '_ {
+        (0..self.element_count()).map(move |i| self.element(i))
+    }
+    
+    // The values actually held: every element when dense, one period when
+    // repeated. Enough for questions like "is any element a float?" Layouts
+    // that keep no such values (packed integers, runs, sparse entries) give a
+    // temporary expansion; callers that can should ask for the layout first.
+    pub fn stored(&self) -> Cow<'_, [JValue]> {
+        match &self.layout {
+            Layout::Dense => Cow::Borrowed(&self.data),
+            Layout::Repeated(pattern) => Cow::Borrowed(pattern),
+            Layout::Rope(rope) => Cow::Borrowed(rope.flat()),
+            Layout::Packed(packed) => Cow::Owned(packed.values().collect()),
+            Layout::Runs(runs) => Cow::Owned(runs.expand()),
+            Layout::Sparse(sparse) => Cow::Owned(sparse.expand()),
+            Layout::Complex(parts) => Cow::Owned((0..parts.len()).map(|i| parts.get(i)).collect()),
+            Layout::Floats(values) => Cow::Owned(values.iter().map(|&v| JValue::Float(v)).collect()),
+        }
+    }
+    
+    // All elements as one slice, when the layout holds them as JValues
+    // without repeating anything (a rope flattens once, on first use)
+    pub fn contiguous(&self) -> Option<&[JValue]> {
+        match &self.layout {
+            Layout::Dense => Some(&self.data),
+            Layout::Repeated(_) | Layout::Runs(_) | Layout::Sparse(_) | Layout::Packed(_) | Layout::Complex(_) | Layout::Floats(_) => None,
+            Layout::Rope(rope) => Some(rope.flat()),
+        }
+    }
+    
+    // The sequence that the elements cycle through, when the array has one
+    // that is cheaper than its elements: a repeated layout, or a single atom
+    pub fn period(&self) -> Option<&[JValue]> {
+        match &self.layout {
+            Layout::Repeated(pattern) => Some(pattern),
+            Layout::Dense if self.data.len() == 1 => Some(&self.data),
+            _ => None,
+        }
+    }
+    
+    // Dense view: borrowed when already dense, materialized otherwise
+    pub fn to_dense(&self) -> Cow<'_, JArray> {
+        match self.layout {
+            Layout::Dense => Cow::Borrowed(self),
+            _ => Cow::Owned(self.clone().materialize()),
+        }
+    }
+    
+    // Convert to a dense array, expanding any compact layout
+    pub fn materialize(self) -> JArray {
+        match &self.layout {
+            Layout::Dense => self,
+            Layout::Repeated(pattern) => {
+                let count = self.element_count();
+                let mut data = Vec::with_capacity(count);
+                while data.len() < count {
+                    let take = pattern.len().min(count - data.len());
+                    data.extend_from_slice(&pattern[..take]);
+                }
+                JArray::from_data(data, self.shape)
+            }
+            Layout::Rope(rope) => JArray::from_data(rope.flat().to_vec(), self.shape.clone()),
+            Layout::Packed(packed) => JArray::from_data(packed.values().collect(), self.shape.clone()),
+            Layout::Runs(runs) => JArray::from_data(runs.expand(), self.shape.clone()),
+            Layout::Sparse(sparse) => JArray::from_data(sparse.expand(), self.shape.clone()),
+            Layout::Complex(parts) => JArray::from_data((0..parts.len()).map(|i| parts.get(i)).collect(), self.shape.clone()),
+            Layout::Floats(values) => JArray::from_data(values.iter().map(|&v| JValue::Float(v)).collect(), self.shape.clone()),
         }
     }
     
@@ -168,14 +962,17 @@ impl JArray {
         self.shape.rank() == 2
     }
     
-    pub fn get_at_index(&self, indices: &[usize]) -> Option<&JValue> {
+    pub fn get_at_index(&self, indices: &[usize]) -> Option<Cow<'_, JValue>> {
         let flat_index = self.calculate_flat_index(indices)?;
-        self.data.get(flat_index)
+        Some(self.element(flat_index))
     }
     
     pub fn set_at_index(&mut self, indices: &[usize], value: JValue) -> Result<(), ArrayError> {
         let flat_index = self.calculate_flat_index(indices)
             .ok_or(ArrayError::IndexOutOfBounds)?;
+        if !self.is_dense() {
+            *self = std::mem::replace(self, JArray::scalar(0)).materialize();
+        }
         if let Some(elem) = self.data.get_mut(flat_index) {
             *elem = value;
             Ok(())
@@ -206,21 +1003,47 @@ impl JArray {
     // Phase 4: Advanced Array Operations
     
     // Reshape Implementation for # Operator
+    // J reshape: the elements are taken in order and cycled to fill the new
+    // shape. Large results that repeat a short pattern stay compact.
     pub fn reshape(&self, new_shape: ArrayShape) -> Result<JArray, ArrayError> {
         let current_elements = self.shape.total_elements();
-        let new_elements = new_shape.total_elements();
+        let new_elements = check_elements(new_shape.checked_elements())?;
         
-        if current_elements != new_elements {
+        if current_elements == new_elements {
+            return Ok(JArray {
+                data: self.data.clone(),
+                shape: new_shape,
+                layout: self.layout.clone(),
+            });
+        }
+        
+        if current_elements == 0 {
+            // Nothing to cycle through
             return Err(ArrayError::InvalidReshape {
                 from_shape: self.shape.clone(),
                 to_shape: new_shape,
             });
         }
+        if self.complex().is_some() {
+            return Ok(self.gather((0..new_elements).map(|i| i % current_elements), new_shape));
+        }
         
-        Ok(JArray {
-            data: self.data.clone(),
-            shape: new_shape,
-        })
+        // The shortest sequence that the source's elements repeat
+        let pattern: Cow<'_, [JValue]> = match &self.layout {
+            Layout::Repeated(pattern) if current_elements % pattern.len() != 0 => {
+                Cow::Owned(self.to_dense().into_owned().data)
+            }
+            _ => self.stored(),
+        };
+        
+        if new_elements >= REPEAT_MIN_ELEMENTS && new_elements >= pattern.len() * REPEAT_MIN_FACTOR {
+            return Ok(JArray::repeated(pattern.into_owned(), new_shape));
+        }
+        
+        let data = (0..new_elements)
+            .map(|i| pattern[i % pattern.len()].clone())
+            .collect();
+        Ok(JArray::from_data(data, new_shape))
     }
     
     pub fn tally(&self) -> usize {
@@ -231,77 +1054,200 @@ impl JArray {
         }
     }
     
+    // Items start..start+count (leading-axis cells) as an array of that many
+    // items; an atom counts as a single item
+    pub fn take_items(&self, start: usize, count: usize) -> JArray {
+        let item_shape = self.shape.dimensions.get(1..).unwrap_or(&[]);
+        let item_size: usize = item_shape.iter().product();
+        let mut dimensions = vec![count];
+        dimensions.extend_from_slice(item_shape);
+        self.slice(start * item_size..(start + count) * item_size, ArrayShape { dimensions })
+    }
+    
+    // Elements in `range` (row-major order) as an array of `shape`
+    pub fn slice(&self, range: std::ops::Range<usize>, shape: ArrayShape) -> JArray {
+        match (&self.layout, self.contiguous()) {
+            (Layout::Packed(packed), _) => JArray::from_ints(range.map(|i| packed.get(i)).collect(), shape),
+            (Layout::Complex(parts), _) => JArray::from_complex(parts.re[range.clone()].to_vec(), parts.im[range].to_vec(), shape),
+            (Layout::Floats(values), _) => JArray::from_floats(values[range].to_vec().into(), shape),
+            (_, Some(values)) => JArray::from_data(values[range].to_vec(), shape),
+            _ => JArray::from_data(range.map(|i| self.value(i)).collect(), shape),
+        }
+    }
+    
+    // Item `index` (a leading-axis cell) with the item shape
+    pub fn item(&self, index: usize) -> JArray {
+        let mut item = self.take_items(index, 1);
+        item.shape.dimensions.remove(0);
+        item
+    }
+    
+    // Array made of equally shaped `cells` laid out in a `frame`: the result
+    // shape is the frame followed by the cell shape
+    pub fn from_cells(frame: Vec<usize>, cells: Vec<JArray>) -> Result<JArray, ArrayError> {
+        let cell_shape = cells.first().map(|cell| cell.shape.clone()).unwrap_or_else(ArrayShape::scalar);
+        let mut dimensions = frame;
+        dimensions.extend_from_slice(&cell_shape.dimensions);
+        let shape = ArrayShape { dimensions };
+        
+        if let Some(cell) = cells.iter().find(|cell| cell.shape != cell_shape) {
+            return Err(ArrayError::ShapeMismatch { expected: cell_shape, actual: cell.shape.clone() });
+        }
+        // Complex cells make a complex array when all the cells are numeric
+        if cells.iter().any(|cell| cell.complex().is_some()) {
+            if let Some(parts) = cells.iter().map(JArray::complex_parts).collect::<Option<Vec<_>>>() {
+                let re = parts.iter().flat_map(|parts| parts.re.iter().copied()).collect();
+                let im = parts.iter().flat_map(|parts| parts.im.iter().copied()).collect();
+                return Ok(JArray::from_complex(re, im, shape));
+            }
+        }
+        
+        let mut data = Vec::with_capacity(shape.total_elements());
+        for cell in &cells {
+            match cell.contiguous() {
+                Some(values) => data.extend_from_slice(values),
+                None => data.extend(cell.elements().map(Cow::into_owned)),
+            }
+        }
+        if data.len() >= PACK_MIN_ELEMENTS && data.iter().all(|v| matches!(v, JValue::Integer(_))) {
+            let ints = data.into_iter().filter_map(|v| v.to_integer()).collect();
+            return Ok(JArray::from_ints(ints, shape));
+        }
+        Ok(JArray::from_data(data, shape))
+    }
+    
     // Indexing Implementation for { Operator
     pub fn select_from(&self, indices: &JArray) -> Result<JArray, ArrayError> {
-        let mut result_data = Vec::new();
+        let mut positions = Vec::with_capacity(indices.element_count());
         
-        for index_value in &indices.data {
+        for position in 0..indices.element_count() {
+            let index_value = indices.value(position);
             let index = index_value.to_integer()
                 .ok_or(ArrayError::TypeMismatch {
                     expected: "integer".to_string(),
                     actual: index_value.type_name().to_string(),
                 })?;
             
-            if index < 0 || index as usize >= self.data.len() {
+            if index < 0 || index as usize >= self.element_count() {
                 return Err(ArrayError::IndexOutOfBounds);
             }
             
-            result_data.push(self.data[index as usize].clone());
+            positions.push(index as usize);
         }
         
-        Ok(JArray {
-            data: result_data,
-            shape: indices.shape.clone(),
-        })
+        // Selections from packed integers stay packed, and complex ones complex
+        Ok(self.gather(positions.into_iter(), indices.shape.clone()))
     }
     
     // Concatenation Implementation for , Operator
+    // J append: joins the items (leading-axis cells) of both arguments. An
+    // argument of rank one less than the other counts as a single item, and
+    // an atom is repeated to fill one item.
     pub fn concatenate(&self, other: &JArray) -> Result<JArray, ArrayError> {
-        // For vectors, simple concatenation
-        if self.is_vector() && other.is_vector() {
-            let mut result_data = self.data.clone();
-            result_data.extend(other.data.clone());
-            let result_len = result_data.len();
-            
-            Ok(JArray {
-                data: result_data,
-                shape: ArrayShape::vector(result_len),
-            })
-        } else if self.is_scalar() && other.is_scalar() {
-            // Concatenate scalars into vector
-            let mut result_data = vec![self.data[0].clone()];
-            result_data.push(other.data[0].clone());
-            
-            Ok(JArray {
-                data: result_data,
-                shape: ArrayShape::vector(2),
-            })
+        if self.is_scalar() && other.is_scalar() {
+            return Ok(JArray::from_values(
+                vec![self.value(0), other.value(0)],
+                ArrayShape::vector(2),
+            ));
+        }
+        
+        let rank = self.shape.rank().max(other.shape.rank());
+        let item_shape = if self.shape.rank() == rank {
+            &self.shape.dimensions[1..]
+        } else {
+            &other.shape.dimensions[1..]
+        };
+        let left_items = self.append_items(rank, item_shape, other)?;
+        let right_items = other.append_items(rank, item_shape, self)?;
+        
+        let mut dimensions = vec![left_items + right_items];
+        dimensions.extend_from_slice(item_shape);
+        let shape = ArrayShape { dimensions };
+        let item_size: usize = item_shape.iter().product();
+        if self.complex().is_some() || other.complex().is_some() {
+            return self.append_complex(other, item_size, shape);
+        }
+        let right_data = || -> Vec<JValue> {
+            if other.is_scalar() {
+                vec![other.value(0); item_size]
+            } else {
+                other.elements().map(Cow::into_owned).collect()
+            }
+        };
+        
+        // Extend an existing rope, or start one once the result is large
+        if let Layout::Rope(rope) = &self.layout {
+            let rope = rope.append(right_data());
+            return Ok(JArray { data: Vec::new(), shape, layout: Layout::Rope(Arc::new(rope)) });
+        }
+        let mut left_data: Vec<JValue> = if self.is_scalar() {
+            vec![self.value(0); item_size]
         } else {
-            // For now, convert to vectors and concatenate
-            let self_ravel = self.ravel();
-            let other_ravel = other.ravel();
-            self_ravel.concatenate(&other_ravel)
+            self.elements().map(Cow::into_owned).collect()
+        };
+        if shape.total_elements() >= ROPE_MIN_ELEMENTS {
+            let rope = Rope::new(left_data, right_data());
+            return Ok(JArray { data: Vec::new(), shape, layout: Layout::Rope(Arc::new(rope)) });
+        }
+        left_data.extend(right_data());
+        Ok(JArray::from_data(left_data, shape))
+    }
+    
+    // Append with a complex argument, joining the real and imaginary parts;
+    // the other argument must be numeric
+    fn append_complex(&self, other: &JArray, item_size: usize, shape: ArrayShape) -> Result<JArray, ArrayError> {
+        let count = shape.total_elements();
+        let (mut re, mut im) = (Vec::with_capacity(count), Vec::with_capacity(count));
+        for argument in [self, other] {
+            let parts = argument.complex_parts().ok_or_else(|| ArrayError::TypeMismatch {
+                expected: "numeric".to_string(),
+                actual: argument.elements().find(|v| !v.is_numeric()).map_or_else(String::new, |v| v.type_name().to_string()),
+            })?;
+            if argument.is_scalar() {
+                re.extend(std::iter::repeat(parts.re[0]).take(item_size));
+                im.extend(std::iter::repeat(parts.im[0]).take(item_size));
+            } else {
+                re.extend_from_slice(&parts.re);
+                im.extend_from_slice(&parts.im);
+            }
         }
+        Ok(JArray::from_complex(re, im, shape))
+    }
+    
+    // How many items this argument of append contributes to a result of
+    // `rank` whose items have `item_shape`
+    fn append_items(&self, rank: usize, item_shape: &[usize], other: &JArray) -> Result<usize, ArrayError> {
+        let own_item_shape = if self.is_scalar() {
+            return Ok(1);
+        } else if self.shape.rank() == rank {
+            &self.shape.dimensions[1..]
+        } else if self.shape.rank() + 1 == rank {
+            &self.shape.dimensions[..]
+        } else {
+            return Err(ArrayError::ShapeMismatch { expected: other.shape.clone(), actual: self.shape.clone() });
+        };
+        if own_item_shape != item_shape {
+            return Err(ArrayError::ShapeMismatch { expected: other.shape.clone(), actual: self.shape.clone() });
+        }
+        Ok(if self.shape.rank() == rank { self.shape.dimensions[0] } else { 1 })
     }
     
     pub fn ravel(&self) -> JArray {
         JArray {
             data: self.data.clone(),
-            shape: ArrayShape::vector(self.data.len()),
+            shape: ArrayShape::vector(self.element_count()),
+            layout: self.layout.clone(),
         }
     }
     
     // Boxing Support for < Operator
     pub fn box_array(array: JArray) -> Self {
-        JArray {
-            data: vec![JValue::Box(Box::new(array))],
-            shape: ArrayShape::scalar(),
-        }
+        JArray::from_data(vec![JValue::Box(Box::new(array))], ArrayShape::scalar())
     }
     
     pub fn unbox(&self) -> Option<&JArray> {
         if self.is_scalar() {
-            if let JValue::Box(boxed) = &self.data[0] {
+            if let Cow::Borrowed(JValue::Box(boxed)) = self.element(0) {
                 Some(boxed.as_ref())
             } else {
                 None
@@ -312,7 +1258,7 @@ impl JArray {
     }
     
     pub fn is_boxed(&self) -> bool {
-        self.is_scalar() && matches!(self.data[0], JValue::Box(_))
+        self.is_scalar() && matches!(*self.element(0), JValue::Box(_))
     }
     
     // Backward Compatibility Layer
@@ -321,7 +1267,7 @@ impl JArray {
     }
     
     pub fn get_data(&self) -> Vec<i32> {
-        self.data.iter()
+        self.to_dense().data.iter()
             .filter_map(|v| v.to_integer())
             .collect()
     }
@@ -350,8 +1296,21 @@ impl JArray {
 }
 
 // Phase 5: Display and Formatting
+// Leading elements shown for an array too large to expand for display
+const DISPLAY_ELIDED: usize = 16;
+
 impl fmt::Display for JArray {
     fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        // A compact array past the element limit (a wide sparse count, say)
+        // shows its first elements, much as J's session abbreviates output
+        if self.element_count() > max_elements() {
+            let shown: Vec<String> = (0..DISPLAY_ELIDED.min(self.element_count())).map(|i| self.element(i).to_string()).collect();
+            return write!(f, "{} ... ({} elements)", shown.join(" "), self.element_count());
+        }
+        if !self.is_dense() {
+            return write!(f, "{}", self.to_dense());
+        }
+        
         match self.shape.rank() {
             0 => {
                 // Scalar
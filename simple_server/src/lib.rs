@@ -3,17 +3,29 @@ use crate::tokenizer::JTokenizer;
 use crate::custom_parser::CustomParser;
 use crate::semantic_analyzer::JSemanticAnalyzer;
 use crate::evaluator::JEvaluator;
+use crate::interpreter::{JInterpreter, PreparedStore, format_result, parse_binding_value};
+use std::cell::RefCell;
 
 // TEMPORARILY UNUSED - Complex J interpreter
 // Module declarations
 pub mod tokenizer;
 pub mod semantic_analyzer;
+pub mod sharing;
 pub mod evaluator;
+pub mod explicit;
+pub mod verbs;
+pub mod random;
+pub mod histogram;
+pub mod modifiers;
 pub mod j_array;
 pub mod parser;
 // pub mod test_suite;
-// pub mod visualizer;
+pub mod visualizer;
 pub mod custom_parser;
+pub mod interpreter;
+pub mod workspace;
+#[cfg(not(target_arch = "wasm32"))]
+pub mod ffi;
 
 // use tokenizer::JTokenizer;
 // use custom_parser::CustomParser;
@@ -93,7 +105,7 @@ pub fn evaluate_j_expression(expression: &str) -> String {
 pub fn handle_j_eval_request(request_body: &str) -> String {
     console_error_panic_hook::set_once();
     
-    // Parse form data: "expression=4+4#~16"
+    // Parse form data: "expression=4+4$~16"
     let expression = match parse_form_data(request_body) {
         Some(expr) => expr,
         None => return r#"{"result": "Error: Invalid request format"}"#.to_string(),
@@ -103,13 +115,107 @@ pub fn handle_j_eval_request(request_body: &str) -> String {
     format!(r#"{{"result": "{}"}}"#, escape_json(&result))
 }
 
+// Prepared expressions for this WASM instance, keyed by the id handed to JS;
+// capped like the server's store
+thread_local! {
+    static PREPARED: RefCell<PreparedStore> = RefCell::new(PreparedStore::new());
+}
+
+// Mirror of POST /j_prepare: {"expression": "x + ~y"} -> {"id": "1", "names": ["x", "y"]}
+#[wasm_bindgen]
+pub fn handle_j_prepare_request(request_body: &str) -> String {
+    console_error_panic_hook::set_once();
+    
+    let expression = match extract_json_field(request_body, "expression") {
+        Some(expr) => expr,
+        None => return r#"{"error": "No expression provided"}"#.to_string(),
+    };
+    
+    match JInterpreter::new().prepare(&expression) {
+        Ok(prepared) => {
+            let names = prepared.names()
+                .iter()
+                .map(|n| format!("\"{}\"", n))
+                .collect::<Vec<_>>()
+                .join(", ");
+            let id = PREPARED.with(|store| store.borrow_mut().insert(prepared));
+            format!(r#"{{"id": "{}", "names": [{}]}}"#, id, names)
+        }
+        Err(e) => format!(r#"{{"error": "{}"}}"#, escape_json(&e.to_string())),
+    }
+}
+
+// Mirror of POST /j_execute: {"id": "1", "bindings": {"x": "1 2 3"}} -> {"result": "..."}
+#[wasm_bindgen]
+pub fn handle_j_execute_request(request_body: &str) -> String {
+    console_error_panic_hook::set_once();
+    
+    let id = match extract_json_field(request_body, "id").and_then(|id| id.parse::<u64>().ok()) {
+        Some(id) => id,
+        None => return r#"{"result": "Error: missing or invalid id"}"#.to_string(),
+    };
+    // Names are looked up inside the bindings object so they cannot clash with "id"
+    let bindings = json_field_value(request_body, "bindings").unwrap_or("");
+    
+    let result = PREPARED.with(|store| {
+        let mut store = store.borrow_mut();
+        let prepared = match store.get_mut(id) {
+            Some(prepared) => prepared,
+            None => return format!("Error: no prepared expression {}", id),
+        };
+        for name in prepared.names().to_vec() {
+            let bound = extract_json_field(bindings, &name)
+                .ok_or_else(|| format!("Error: '{}' is not bound", name))
+                .and_then(|value| parse_binding_value(&value).map_err(|e| format!("Error: {}", e)))
+                .and_then(|value| prepared.bind(&name, value).map_err(|e| format!("Error: {}", e)));
+            if let Err(msg) = bound {
+                return msg;
+            }
+        }
+        format_result(JInterpreter::new().execute_prepared(prepared))
+    });
+    format!(r#"{{"result": "{}"}}"#, escape_json(&result))
+}
+
+fn extract_json_field(json: &str, field: &str) -> Option<String> {
+    json_string(json_field_value(json, field)?.strip_prefix('"')?)
+}
+
+// The text after `"field":`, from the start of the field's value
+fn json_field_value<'a>(json: &'a str, field: &str) -> Option<&'a str> {
+    let field_pattern = format!(r#""{}""#, field);
+    let start = json.find(&field_pattern)?;
+    let after_field = &json[start + field_pattern.len()..];
+    let colon_pos = after_field.find(':')?;
+    Some(after_field[colon_pos + 1..].trim_start())
+}
+
+// A JSON string body up to its closing quote, with escapes undone; escaped
+// quotes (as in the rank conjunction, +"1) do not end the string
+fn json_string(content: &str) -> Option<String> {
+    let mut result = String::new();
+    let mut chars = content.chars();
+    while let Some(c) = chars.next() {
+        match c {
+            '"' => return Some(result),
+            '\\' => match chars.next()? {
+                'n' => result.push('\n'),
+                escaped => result.push(escaped),
+            },
+            c => result.push(c),
+        }
+    }
+    None
+}
+
 fn parse_form_data(body: &str) -> Option<String> {
     if let Some(expr_start) = body.find("expression=") {
         let expr_part = &body[expr_start + 11..];
         let expr_end = expr_part.find('&').unwrap_or(expr_part.len());
         let encoded_expr = &expr_part[..expr_end];
         
-        Some(encoded_expr.replace('+', " ").replace("%23", "#"))
+        Some(encoded_expr.replace('+', " ").replace("%23", "#").replace("%24", "$").replace("%22", "\"").replace("%5E", "^")
+            .replace("%7B", "{").replace("%7D", "}").replace("%0A", "\n"))
     } else {
         None
     }
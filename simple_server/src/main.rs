@@ -1,8 +1,8 @@
 use std::fs::File;
-use std::io::Read;
+use std::io::{Cursor, Read};
 use std::path::Path;
-use std::sync::{Arc, Mutex};
-use tiny_http::{Server, Response, Header, Method, Request};
+use std::sync::{Arc, Mutex, RwLock};
+use tiny_http::{Server, Response, Header, Method, Request, StatusCode};
 use std::collections::VecDeque;
 
 // Import our modular J interpreter modules
@@ -13,46 +13,210 @@ mod custom_parser;
 
 
 mod semantic_analyzer;
+mod sharing;
 mod evaluator;
+mod explicit;
+mod verbs;
+mod random;
+mod histogram;
+mod modifiers;
 mod interpreter;
+mod workspace;
 mod visualizer;
 mod test_suite;
+// The C ABI ships in the library; the binary builds it only for its tests
+#[cfg(test)]
+mod ffi;
+mod metrics;
+#[cfg(unix)]
+mod unix_server;
+#[cfg(unix)]
+mod supervisor;
 
-use interpreter::{JInterpreter, format_result};
+use interpreter::{JInterpreter, PreparedStore, format_result, parse_binding_value};
 use visualizer::ParseTreeVisualizer;
+use workspace::{Source, WorkspaceStore};
 
 use custom_parser::CustomParser;
 use tokenizer::JTokenizer;
 use semantic_analyzer::JSemanticAnalyzer;
 use evaluator::JEvaluator;
+use metrics::{Metrics, COUNTER_REQUESTS, COUNTER_EVALUATIONS, COUNTER_EVAL_ERRORS};
+
+const LISTEN_ADDR: &str = "0.0.0.0:5000";
 
 // Store messages and J interpreter state in a thread-safe container
 struct AppState {
     messages: Mutex<VecDeque<String>>,
+    pages: PageCache,
+    metrics: Metrics,
+    // The supervisor's snapshot of the static files, mapped by each worker
+    #[cfg(unix)]
+    assets: Option<Arc<supervisor::StaticAssets>>,
+    prepared: Mutex<PreparedStore>,
+    // Workspaces by session; shared with the other workers through files
+    workspaces: WorkspaceStore,
     j_interpreter: JInterpreter,
 }
 
+// A page as served: either fully rendered bytes or the error to report
+#[derive(Clone)]
+enum CachedPage {
+    Rendered(Arc<Vec<u8>>),
+    Failed(u16, &'static str),
+}
+
+// Both message pages, rendered together so a snapshot is always consistent
+struct RenderedPages {
+    j_repl: CachedPage,
+    hello_world: CachedPage,
+}
+
+// Templates are read once at startup; pages are re-rendered only when /submit
+// changes the messages. GET handlers clone the current Arc and never touch the
+// message queue, the disk or the template substitution.
+struct PageCache {
+    j_repl_template: Result<String, (u16, &'static str)>,
+    hello_world_template: Result<String, (u16, &'static str)>,
+    current: RwLock<Arc<RenderedPages>>,
+}
+
+impl PageCache {
+    fn load() -> Self {
+        let j_repl_template = read_template("./static/j_repl.html");
+        let hello_world_template = read_template("./static/hello_world.html");
+        let current = RwLock::new(Arc::new(render_pages(
+            &j_repl_template,
+            &hello_world_template,
+            &VecDeque::new(),
+        )));
+        PageCache { j_repl_template, hello_world_template, current }
+    }
+
+    // Take a snapshot of the current pages (one Arc clone under an uncontended lock)
+    fn snapshot(&self) -> Arc<RenderedPages> {
+        self.current.read().unwrap().clone()
+    }
+
+    // Re-render from the given messages and publish the result
+    fn rebuild(&self, messages: &VecDeque<String>) {
+        let pages = render_pages(&self.j_repl_template, &self.hello_world_template, messages);
+        *self.current.write().unwrap() = Arc::new(pages);
+    }
+}
+
 fn main() {
+    let args: Vec<String> = std::env::args().collect();
+
+    // Supervisor mode: run N worker processes sharing the port via SO_REUSEPORT
+    //   simple_server --workers 4
+    #[cfg(unix)]
+    let worker = supervisor::WorkerConfig::from_args(&args);
+    #[cfg(unix)]
+    {
+        let workers = arg_value(&args, "--workers").and_then(|n| n.parse::<usize>().ok()).unwrap_or(1);
+        if workers > 1 && worker.is_none() {
+            let mut worker_args = Vec::new();
+            let mut first_worker_args = Vec::new();
+            let mut rest = args.iter().skip(1);
+            while let Some(arg) = rest.next() {
+                match arg.as_str() {
+                    "--workers" => { rest.next(); }
+                    // Only one process can own the Unix socket path
+                    "--unix-socket" => first_worker_args.extend(rest.next().map(|p| vec![arg.clone(), p.clone()]).unwrap_or_default()),
+                    _ => worker_args.push(arg.clone()),
+                }
+            }
+            if let Err(e) = supervisor::run(workers, worker_args, first_worker_args) {
+                eprintln!("Supervisor failed: {}", e);
+                std::process::exit(1);
+            }
+            return;
+        }
+    }
+
+    // Largest result an evaluation may build, in elements:
+    //   simple_server --max-elements 100000000
+    if let Some(limit) = arg_value(&args, "--max-elements").and_then(|n| n.parse::<usize>().ok()) {
+        j_array::set_max_elements(limit);
+    }
+
+    // Optional Unix domain socket listener for co-located clients:
+    //   simple_server --unix-socket /tmp/j_interpreter.sock
+    if let Some(path) = arg_value(&args, "--unix-socket") {
+        #[cfg(unix)]
+        {
+            if let Err(e) = unix_server::spawn(&path) {
+                eprintln!("Failed to start Unix socket listener at {}: {}", path, e);
+                std::process::exit(1);
+            }
+        }
+        #[cfg(not(unix))]
+        {
+            eprintln!("--unix-socket {} ignored: Unix domain sockets are not supported on this platform", path);
+        }
+    }
+
     // Create a server listening on port 5000
-    let server = match Server::http("0.0.0.0:5000") {
+    #[cfg(unix)]
+    let server = match &worker {
+        Some(_) => supervisor::reuseport_listener(LISTEN_ADDR)
+            .map_err(|e| e.into())
+            .and_then(|listener| Server::from_listener(listener, None)),
+        None => Server::http(LISTEN_ADDR),
+    };
+    #[cfg(not(unix))]
+    let server = Server::http(LISTEN_ADDR);
+    let server = match server {
         Ok(s) => s,
         Err(e) => {
-            eprintln!("Failed to start server on 0.0.0.0:5000: {}", e);
+            eprintln!("Failed to start server on {}: {}", LISTEN_ADDR, e);
             std::process::exit(1);
         }
     };
-    println!("Server running at http://0.0.0.0:5000");
-    println!("Visit http://0.0.0.0:5000 in your browser");
+    println!("Server running at http://{}", LISTEN_ADDR);
+    println!("Visit http://{} in your browser", LISTEN_ADDR);
+
+    // Workers count into their slot of the supervisor's shared metrics file
+    #[cfg(unix)]
+    let metrics = match &worker {
+        Some(config) => match Metrics::shared(&config.metrics_file, config.index, config.count) {
+            Ok(metrics) => metrics,
+            Err(e) => {
+                eprintln!("Failed to map metrics file {}: {}", config.metrics_file.display(), e);
+                std::process::exit(1);
+            }
+        },
+        None => Metrics::local(),
+    };
+    #[cfg(not(unix))]
+    let metrics = Metrics::local();
 
     // Create shared state with J interpreter
     let state = Arc::new(AppState {
         messages: Mutex::new(VecDeque::new()),
+        pages: PageCache::load(),
+        metrics,
+        #[cfg(unix)]
+        assets: match worker.as_ref().and_then(|w| w.assets_file.as_ref()) {
+            Some(path) => match supervisor::StaticAssets::map(path) {
+                Ok(assets) => Some(Arc::new(assets)),
+                Err(e) => {
+                    println!("Static asset snapshot not mapped, reading from disk: {}", e);
+                    None
+                }
+            },
+            None => None,
+        },
+        prepared: Mutex::new(PreparedStore::new()),
+        workspaces: WorkspaceStore::new(worker.as_ref().map(|w| w.workspace_dir.clone())),
         j_interpreter: JInterpreter::new(),
     });
 
     // Handle incoming requests
     for mut request in server.incoming_requests() {
         println!("Received request: {} {}", request.method(), request.url());
+        state.metrics.increment(COUNTER_REQUESTS);
         
         let method = request.method().clone();
         let url = request.url().to_string();
@@ -85,6 +249,7 @@ fn main() {
                         response
                     } else {
                         println!("Evaluating: {} (using custom parser)", expression);
+                        state.metrics.increment(COUNTER_EVALUATIONS);
                         
                     // Use appropriate parser with manual pipeline
                     let tokenizer = JTokenizer::new();
@@ -109,12 +274,13 @@ fn main() {
                                     
                                     match semantic_analyzer.analyze(ast) {
                                         Ok(resolved_ast) => {
-                                            match evaluator.evaluate(&resolved_ast) {
+                                            match with_request_options(&body, || evaluator.evaluate(&resolved_ast)) {
                                                 Ok(result_array) => {
                                                     println!("Result: {}\n", result_array);
                                                     format!("{}", result_array)
                                                 }
                                                 Err(eval_err) => {
+                                                    state.metrics.increment(COUNTER_EVAL_ERRORS);
                                                     let error_text = format!("Evaluation Error: {}", eval_err);
                                                     println!("{}\n", error_text);
                                                     error_text
@@ -122,6 +288,7 @@ fn main() {
                                             }
                                         }
                                         Err(semantic_err) => {
+                                            state.metrics.increment(COUNTER_EVAL_ERRORS);
                                             let error_text = format!("Semantic Error: {}", semantic_err);
                                             println!("{}\n", error_text);
                                             error_text
@@ -129,6 +296,7 @@ fn main() {
                                     }
                                 }
                                 Err(parse_err) => {
+                                    state.metrics.increment(COUNTER_EVAL_ERRORS);
                                     let error_text = format!("Custom Parse Error: {}", parse_err);
                                     println!("Expression: {}", expression);
                                     println!("{}\n", error_text);
@@ -137,6 +305,7 @@ fn main() {
                             }
                         }
                         Err(token_err) => {
+                            state.metrics.increment(COUNTER_EVAL_ERRORS);
                             let error_text = format!("Token Error: {}", token_err);
                             println!("Expression: {}", expression);
                             println!("{}\n", error_text);
@@ -163,6 +332,67 @@ fn main() {
                     }
                 }
             },
+            // Prepare an expression with names for repeated execution:
+            //   {"expression": "x + ~y"} -> {"id": "1", "names": ["x", "y"]}
+            (Method::Post, "/j_prepare") => {
+                match read_request_body(&mut request) {
+                    Some(body) => {
+                        let (expression, _parser_choice) = parse_j_eval_request(&body);
+                        match state.j_interpreter.prepare(&expression) {
+                            Ok(prepared) => {
+                                let names = prepared.names()
+                                    .iter()
+                                    .map(|n| format!("\"{}\"", n))
+                                    .collect::<Vec<_>>()
+                                    .join(", ");
+                                let id = state.prepared.lock().unwrap().insert(prepared);
+                                json_response(format!("{{\"id\": \"{}\", \"names\": [{}]}}", id, names), 200)
+                            }
+                            Err(e) => json_response(format!("{{\"error\": \"{}\"}}", json_escape(&e.to_string())), 400),
+                        }
+                    }
+                    None => json_response("{\"error\": \"Could not read request body\"}".to_string(), 400),
+                }
+            },
+            // Execute a prepared expression with values for its names:
+            //   {"id": "1", "bindings": {"x": "1 2 3", "y": "3"}} -> {"result": "..."}
+            // Values are numbers, optionally shaped as "2 3$1 2 3 4 5 6".
+            // Either endpoint takes "reduction": "reproducible" for float sums
+            // whose bits do not depend on the server's thread count, and
+            // "seed": "42" for repeatable random draws.
+            (Method::Post, "/j_execute") => {
+                match read_request_body(&mut request) {
+                    Some(body) => {
+                        state.metrics.increment(COUNTER_EVALUATIONS);
+                        let result = execute_prepared_request(&state, &body);
+                        if result.is_err() {
+                            state.metrics.increment(COUNTER_EVAL_ERRORS);
+                        }
+                        json_response(format!("{{\"result\": \"{}\"}}", json_escape(&format_result(result))), 200)
+                    }
+                    None => json_response("{\"error\": \"Could not read request body\"}".to_string(), 400),
+                }
+            },
+            // Define or set a name in the session's workspace; only the names
+            // downstream of it are recomputed, and every name whose value
+            // changed is returned. A failed update changes nothing:
+            //   {"session": "s1", "name": "total", "expression": "+/ prices"}
+            //   {"session": "s1", "name": "prices", "value": "1 2 3"} -> {"changed": {"prices": "1 2 3", "total": "6"}}
+            (Method::Post, "/j_workspace") => {
+                match read_request_body(&mut request) {
+                    Some(body) => {
+                        state.metrics.increment(COUNTER_EVALUATIONS);
+                        match workspace_request(&state, &body) {
+                            Ok(changed) => json_response(format!("{{\"changed\": {{{}}}}}", changed), 200),
+                            Err(e) => {
+                                state.metrics.increment(COUNTER_EVAL_ERRORS);
+                                json_response(format!("{{\"error\": \"{}\"}}", json_escape(&e.to_string())), 400)
+                            }
+                        }
+                    }
+                    None => json_response("{\"error\": \"Could not read request body\"}".to_string(), 400),
+                }
+            },
             // Original message submission (kept for backward compatibility)
             (Method::Post, "/submit") => {
                 // Read the POST body
@@ -189,6 +419,9 @@ fn main() {
                         while messages.len() > 10 {
                             messages.pop_back();
                         }
+                        
+                        // Re-render while still holding the lock so updates publish in order
+                        state.pages.rebuild(&messages);
                     }
                 }
                 
@@ -198,29 +431,157 @@ fn main() {
                     Err(_) => Response::from_string("Redirect failed").with_status_code(500)
                 }
             },
+            // Cached pages are sent from the shared rendering as they are
             (Method::Get, "/") => {
                 // Default to J REPL interface
-                serve_j_repl_with_messages(&state)
+                send(request, serve_j_repl_with_messages(&state));
+                continue;
             },
             (Method::Get, "/hello_world.html") => {
                 // Original chat interface (kept for backward compatibility)
-                serve_html_with_messages(&state)
+                send(request, serve_html_with_messages(&state));
+                continue;
+            },
+            (Method::Get, "/metrics") => {
+                // Request counters (pool-wide when running under the supervisor)
+                let header = Header::from_bytes("Content-Type", "text/plain").unwrap();
+                Response::from_string(state.metrics.report()).with_header(header)
             },
             _ => {
                 // Serve static files for other requests
+                #[cfg(unix)]
+                {
+                    if let Some(assets) = &state.assets {
+                        if let Some(range) = assets.find(&url) {
+                            send(request, serve_asset(&url, SharedBytes::Asset(Arc::clone(assets), range)));
+                            continue;
+                        }
+                    }
+                    serve_static_file(&url)
+                }
+                #[cfg(not(unix))]
                 serve_static_file(&url)
             }
         };
 
-        // Send the response
-        if let Err(e) = request.respond(response) {
-            println!("Error sending response: {:?}", e);
+        send(request, response);
+    }
+}
+
+// Send the response
+fn send<R: Read>(request: Request, response: Response<R>) {
+    if let Err(e) = request.respond(response) {
+        println!("Error sending response: {:?}", e);
+    }
+}
+
+// A response body shared with the cache it came from: sending it reads the
+// cached bytes in place, so a GET costs an Arc clone rather than a copy
+enum SharedBytes {
+    Page(Arc<Vec<u8>>),
+    Text(&'static str),
+    // A file in the mapped static asset snapshot
+    #[cfg(unix)]
+    Asset(Arc<supervisor::StaticAssets>, std::ops::Range<usize>),
+}
+
+impl AsRef<[u8]> for SharedBytes {
+    fn as_ref(&self) -> &[u8] {
+        match self {
+            SharedBytes::Page(bytes) => bytes,
+            SharedBytes::Text(text) => text.as_bytes(),
+            #[cfg(unix)]
+            SharedBytes::Asset(assets, range) => assets.bytes(range.clone()),
         }
     }
 }
 
+fn shared_response(status: u16, headers: Vec<Header>, body: SharedBytes) -> Response<Cursor<SharedBytes>> {
+    let length = body.as_ref().len();
+    Response::new(StatusCode(status), headers, Cursor::new(body), Some(length), None)
+}
+
 // No longer needed as we've inlined this functionality
 
+// Read the whole POST body as declared by Content-Length
+fn read_request_body(request: &mut Request) -> Option<String> {
+    let content_length = request
+        .headers()
+        .iter()
+        .find(|h| h.field.equiv("Content-Length"))
+        .and_then(|h| h.value.as_str().parse::<usize>().ok())
+        .unwrap_or(0);
+    
+    let mut buffer = vec![0; content_length];
+    request.as_reader().read_exact(&mut buffer).ok()?;
+    Some(String::from_utf8_lossy(&buffer).into_owned())
+}
+
+fn json_response(body: String, status: u16) -> Response<Cursor<Vec<u8>>> {
+    match Header::from_bytes("Content-Type", "application/json") {
+        Ok(header) => Response::from_string(body).with_header(header).with_status_code(status),
+        Err(_) => Response::from_string(body).with_status_code(status)
+    }
+}
+
+fn json_escape(s: &str) -> String {
+    s.replace('\\', "\\\\")
+     .replace('"', "\\\"")
+     .replace('\n', "\\n")
+     .replace('\r', "\\r")
+     .replace('\t', "\\t")
+}
+
+// Bind the request's values to a stored prepared expression and run it
+fn execute_prepared_request(state: &AppState, body: &str) -> Result<j_array::JArray, interpreter::InterpreterError> {
+    use interpreter::InterpreterError;
+    
+    let id = extract_json_field(body, "id")
+        .and_then(|id| id.parse::<u64>().ok())
+        .ok_or_else(|| InterpreterError::BindingError("missing or invalid id".to_string()))?;
+    // Look names up inside the bindings object so they cannot clash with "id"
+    let bindings = json_field_value(body, "bindings").unwrap_or("");
+    
+    let mut store = state.prepared.lock().unwrap();
+    let prepared = store.get_mut(id)
+        .ok_or_else(|| InterpreterError::BindingError(format!("no prepared expression {}", id)))?;
+    
+    for name in prepared.names().to_vec() {
+        let value = extract_json_field(bindings, &name)
+            .ok_or_else(|| InterpreterError::BindingError(format!("'{}' is not bound", name)))?;
+        prepared.bind(&name, parse_binding_value(&value)?)?;
+    }
+    with_request_options(body, || state.j_interpreter.execute_prepared(prepared))
+}
+
+// Apply a workspace update and list the changed names as JSON members
+fn workspace_request(state: &AppState, body: &str) -> Result<String, interpreter::InterpreterError> {
+    use interpreter::InterpreterError;
+    
+    let session = extract_json_field(body, "session")
+        .ok_or_else(|| InterpreterError::BindingError("missing session".to_string()))?;
+    let name = extract_json_field(body, "name")
+        .ok_or_else(|| InterpreterError::BindingError("missing name".to_string()))?;
+    let source = match (extract_json_field(body, "expression"), extract_json_field(body, "value")) {
+        (Some(expression), _) => Source::Expression(expression),
+        (None, Some(value)) => Source::Value(value),
+        (None, None) => return Err(InterpreterError::BindingError("missing expression or value".to_string())),
+    };
+    let changed = state.workspaces.update(&session, &name, source)?;
+    Ok(changed.iter()
+        .map(|(name, value)| format!("\"{}\": \"{}\"", json_escape(name), json_escape(&value.to_string())))
+        .collect::<Vec<_>>()
+        .join(", "))
+}
+
+// Value following a command-line flag, e.g. `--unix-socket <path>`
+fn arg_value(args: &[String], flag: &str) -> Option<String> {
+    args.iter()
+        .position(|arg| arg == flag)
+        .and_then(|i| args.get(i + 1))
+        .cloned()
+}
+
 // Simple URL decoder
 fn url_decode(input: &str) -> String {
     let mut result = String::new();
@@ -270,97 +631,136 @@ fn parse_j_eval_request(body: &str) -> (String, String) {
     }
 }
 
+// Evaluate under the request's options: "reduction": "reproducible" for
+// float sums that do not depend on the thread count, and "seed": "<n>" for
+// rolls and deals that repeat from one request to the next
+fn with_request_options<T>(body: &str, f: impl FnOnce() -> T) -> T {
+    let reduction = match extract_json_field(body, "reduction").as_deref() {
+        Some("reproducible") => verbs::Reduction::Reproducible,
+        _ => verbs::Reduction::Fast,
+    };
+    match extract_json_field(body, "seed").and_then(|seed| seed.parse::<u64>().ok()) {
+        Some(seed) => random::with_seed(seed, || verbs::with_reduction(reduction, f)),
+        None => verbs::with_reduction(reduction, f),
+    }
+}
+
 fn extract_json_field(json: &str, field: &str) -> Option<String> {
+    json_string(json_field_value(json, field)?.strip_prefix('"')?)
+}
+
+// The text after `"field":`, from the start of the field's value
+fn json_field_value<'a>(json: &'a str, field: &str) -> Option<&'a str> {
     let field_pattern = format!(r#""{}""#, field);
-    if let Some(start) = json.find(&field_pattern) {
-        let after_field = &json[start + field_pattern.len()..];
-        if let Some(colon_pos) = after_field.find(':') {
-            let after_colon = after_field[colon_pos + 1..].trim_start();
-            if after_colon.starts_with('"') {
-                let content = &after_colon[1..];
-                if let Some(end_quote) = content.find('"') {
-                    return Some(json_unescape(&content[..end_quote]));
-                }
-            }
+    let start = json.find(&field_pattern)?;
+    let after_field = &json[start + field_pattern.len()..];
+    let colon_pos = after_field.find(':')?;
+    Some(after_field[colon_pos + 1..].trim_start())
+}
+
+// Contents of a JSON string, read up to the first quote that is not escaped
+fn json_string(content: &str) -> Option<String> {
+    let mut result = String::new();
+    let mut chars = content.chars();
+    while let Some(c) = chars.next() {
+        match c {
+            '"' => return Some(result),
+            '\\' => match chars.next()? {
+                'n' => result.push('\n'),
+                'r' => result.push('\r'),
+                't' => result.push('\t'),
+                escaped => result.push(escaped),
+            },
+            c => result.push(c),
         }
     }
     None
 }
 
-fn json_unescape(s: &str) -> String {
-    s.replace("\\\"", "\"")
-     .replace("\\\\", "\\")
-     .replace("\\n", "\n")
-     .replace("\\r", "\r")
-     .replace("\\t", "\t")
-}
-
-// Serve the J REPL page with messages
-fn serve_j_repl_with_messages(state: &Arc<AppState>) -> Response<std::io::Cursor<Vec<u8>>> {
-    match File::open("./static/j_repl.html") {
+// Read an HTML template, mapping failures to the status served in its place
+fn read_template(path: &str) -> Result<String, (u16, &'static str)> {
+    match File::open(path) {
         Ok(mut file) => {
             let mut contents = String::new();
             if file.read_to_string(&mut contents).is_ok() {
-                // Generate HTML for messages
-                let messages = state.messages.lock().unwrap();
-                let messages_html = format!(
-                    "<div class=\"message-container\">{}</div>",
-                    messages
-                        .iter()
-                        .rev() // Reverse the order so most recent is at the bottom
-                        .map(|msg| msg.to_string())
-                        .collect::<Vec<_>>()
-                        .join("\n")
-                );
-                
-                // Replace the placeholder with the messages
-                let contents = contents.replace("$MESSAGES$", &messages_html);
-                
-                let header = Header::from_bytes("Content-Type", "text/html").unwrap();
-                Response::from_string(contents).with_header(header)
+                Ok(contents)
             } else {
-                Response::from_string("Error reading file").with_status_code(500)
+                Err((500, "Error reading file"))
             }
         },
-        Err(_) => Response::from_string("File not found").with_status_code(404),
+        Err(_) => Err((404, "File not found")),
     }
 }
 
-// Serve the original HTML file with messages (for backward compatibility)
-fn serve_html_with_messages(state: &Arc<AppState>) -> Response<std::io::Cursor<Vec<u8>>> {
-    match File::open("./static/hello_world.html") {
-        Ok(mut file) => {
-            let mut contents = String::new();
-            if file.read_to_string(&mut contents).is_ok() {
-                // Generate HTML for messages
-                let messages = state.messages.lock().unwrap();
-                let messages_html = format!(
-                    "<div class=\"message-container\">{}</div>",
-                    messages
-                        .iter()
-                        .rev() // Reverse the order so most recent is at the bottom
-                        .map(|msg| if msg.contains("class=\"message") { 
-                            msg.to_string() 
-                        } else { 
-                            format!("<div class=\"message\">{}</div>", html_escape(msg)) 
-                        })
-                        .collect::<Vec<_>>()
-                        .join("\n")
-                );
-                
-                // Replace the placeholder with the messages
-                let contents = contents.replace("$MESSAGES$", &messages_html);
-                
-                let header = Header::from_bytes("Content-Type", "text/html").unwrap();
-                Response::from_string(contents).with_header(header)
-            } else {
-                Response::from_string("Error reading file").with_status_code(500)
-            }
+// Render both message pages from the current message queue
+fn render_pages(
+    j_repl_template: &Result<String, (u16, &'static str)>,
+    hello_world_template: &Result<String, (u16, &'static str)>,
+    messages: &VecDeque<String>,
+) -> RenderedPages {
+    // J REPL messages are stored pre-escaped
+    let j_repl_messages = format!(
+        "<div class=\"message-container\">{}</div>",
+        messages
+            .iter()
+            .rev() // Reverse the order so most recent is at the bottom
+            .map(|msg| msg.to_string())
+            .collect::<Vec<_>>()
+            .join("\n")
+    );
+    
+    // The original chat page wraps anything not already wrapped
+    let hello_world_messages = format!(
+        "<div class=\"message-container\">{}</div>",
+        messages
+            .iter()
+            .rev()
+            .map(|msg| if msg.contains("class=\"message") { 
+                msg.to_string() 
+            } else { 
+                format!("<div class=\"message\">{}</div>", html_escape(msg)) 
+            })
+            .collect::<Vec<_>>()
+            .join("\n")
+    );
+    
+    RenderedPages {
+        j_repl: render_page(j_repl_template, &j_repl_messages),
+        hello_world: render_page(hello_world_template, &hello_world_messages),
+    }
+}
+
+fn render_page(template: &Result<String, (u16, &'static str)>, messages_html: &str) -> CachedPage {
+    match template {
+        Ok(contents) => CachedPage::Rendered(Arc::new(
+            contents.replace("$MESSAGES$", messages_html).into_bytes()
+        )),
+        Err((status, message)) => CachedPage::Failed(*status, message),
+    }
+}
+
+fn serve_cached_page(page: &CachedPage) -> Response<Cursor<SharedBytes>> {
+    match page {
+        CachedPage::Rendered(bytes) => {
+            let header = Header::from_bytes("Content-Type", "text/html").unwrap();
+            shared_response(200, vec![header], SharedBytes::Page(Arc::clone(bytes)))
+        },
+        CachedPage::Failed(status, message) => {
+            shared_response(*status, Vec::new(), SharedBytes::Text(message))
         },
-        Err(_) => Response::from_string("File not found").with_status_code(404),
     }
 }
 
+// Serve the J REPL page with messages
+fn serve_j_repl_with_messages(state: &Arc<AppState>) -> Response<Cursor<SharedBytes>> {
+    serve_cached_page(&state.pages.snapshot().j_repl)
+}
+
+// Serve the original HTML file with messages (for backward compatibility)
+fn serve_html_with_messages(state: &Arc<AppState>) -> Response<Cursor<SharedBytes>> {
+    serve_cached_page(&state.pages.snapshot().hello_world)
+}
+
 // Escape HTML special characters
 fn html_escape(s: &str) -> String {
     s.replace('&', "&amp;")
@@ -370,8 +770,25 @@ fn html_escape(s: &str) -> String {
      .replace('\'', "&#39;")
 }
 
+// Content type based on file extension
+fn content_type_for(path: &Path) -> &'static str {
+    match path.extension().and_then(|ext| ext.to_str()) {
+        Some("html") => "text/html",
+        Some("css") => "text/css",
+        Some("js") => "application/javascript",
+        _ => "application/octet-stream",
+    }
+}
+
+// Serve a static file from the mapped snapshot
+#[cfg(unix)]
+fn serve_asset(url: &str, contents: SharedBytes) -> Response<Cursor<SharedBytes>> {
+    let header = Header::from_bytes("Content-Type", content_type_for(Path::new(url))).unwrap();
+    shared_response(200, vec![header], contents)
+}
+
 // Serve a static file
-fn serve_static_file(url: &str) -> Response<std::io::Cursor<Vec<u8>>> {
+fn serve_static_file(url: &str) -> Response<Cursor<Vec<u8>>> {
     // Remove the leading slash
     let file_path = if url.starts_with('/') {
         &url[1..]
@@ -391,12 +808,7 @@ fn serve_static_file(url: &str) -> Response<std::io::Cursor<Vec<u8>>> {
                 let mut contents = Vec::new();
                 if file.read_to_end(&mut contents).is_ok() {
                     // Determine content type based on file extension
-                    let content_type = match path.extension().and_then(|ext| ext.to_str()) {
-                        Some("html") => "text/html",
-                        Some("css") => "text/css",
-                        Some("js") => "application/javascript",
-                        _ => "application/octet-stream",
-                    };
+                    let content_type = content_type_for(path);
 
                     let header = match Header::from_bytes("Content-Type", content_type) {
                         Ok(h) => h,
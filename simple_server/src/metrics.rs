@@ -0,0 +1,105 @@
+// Request Metrics Module
+// Per-worker counters, optionally kept in a shared file mapping so that any
+// worker of a supervised pool can report totals for the whole pool
+
+use std::fmt::Write;
+use std::sync::atomic::{AtomicU64, Ordering};
+
+pub const COUNTER_REQUESTS: usize = 0;
+pub const COUNTER_EVALUATIONS: usize = 1;
+pub const COUNTER_EVAL_ERRORS: usize = 2;
+pub const COUNTER_RESTARTS: usize = 3;
+pub const COUNTERS_PER_SLOT: usize = 4;
+
+const COUNTER_NAMES: [&str; COUNTERS_PER_SLOT] =
+    ["requests", "evaluations", "evaluation_errors", "restarts"];
+
+enum Backing {
+    Local(Box<[AtomicU64]>),
+    #[cfg(unix)]
+    Shared(crate::supervisor::MappedRegion),
+}
+
+pub struct Metrics {
+    backing: Backing,
+    slot: usize,
+    slots: usize,
+}
+
+impl Metrics {
+    // Counters for a single-process server
+    pub fn local() -> Self {
+        let counters = (0..COUNTERS_PER_SLOT).map(|_| AtomicU64::new(0)).collect();
+        Metrics { backing: Backing::Local(counters), slot: 0, slots: 1 }
+    }
+
+    // Size (and zero) the file that backs a pool's counters
+    #[cfg(unix)]
+    pub fn create_shared_file(path: &std::path::Path, slots: usize) -> std::io::Result<()> {
+        // create_new fails on anything already at the path, a planted symlink included
+        let file = std::fs::OpenOptions::new().write(true).create_new(true).open(path)?;
+        file.set_len((slots * COUNTERS_PER_SLOT * std::mem::size_of::<u64>()) as u64)
+    }
+
+    // Counters for worker `slot` of a pool of `slots`, in a file made by create_shared_file
+    #[cfg(unix)]
+    pub fn shared(path: &std::path::Path, slot: usize, slots: usize) -> std::io::Result<Self> {
+        let file = std::fs::OpenOptions::new().read(true).write(true).open(path)?;
+        let len = slots * COUNTERS_PER_SLOT * std::mem::size_of::<u64>();
+        if (file.metadata()?.len() as usize) < len {
+            return Err(std::io::Error::new(
+                std::io::ErrorKind::InvalidData,
+                "metrics file is smaller than the worker pool",
+            ));
+        }
+        let region = crate::supervisor::MappedRegion::map(&file, len, true)?;
+        Ok(Metrics { backing: Backing::Shared(region), slot, slots })
+    }
+
+    fn counters(&self) -> &[AtomicU64] {
+        match &self.backing {
+            Backing::Local(counters) => counters,
+            #[cfg(unix)]
+            Backing::Shared(region) => unsafe {
+                // mmap returns page-aligned memory, so the u64 alignment holds
+                std::slice::from_raw_parts(
+                    region.as_ptr() as *const AtomicU64,
+                    region.len() / std::mem::size_of::<u64>(),
+                )
+            },
+        }
+    }
+
+    // Bump one of this worker's counters
+    pub fn increment(&self, counter: usize) {
+        self.add_to_slot(self.slot, counter, 1);
+    }
+
+    pub fn add_to_slot(&self, slot: usize, counter: usize, amount: u64) {
+        self.counters()[slot * COUNTERS_PER_SLOT + counter].fetch_add(amount, Ordering::Relaxed);
+    }
+
+    // Plain-text report: one line per worker plus the pool total
+    pub fn report(&self) -> String {
+        let counters = self.counters();
+        let mut totals = [0u64; COUNTERS_PER_SLOT];
+        let mut report = String::new();
+
+        for slot in 0..self.slots {
+            let _ = write!(report, "worker {}:", slot);
+            for counter in 0..COUNTERS_PER_SLOT {
+                let value = counters[slot * COUNTERS_PER_SLOT + counter].load(Ordering::Relaxed);
+                totals[counter] += value;
+                let _ = write!(report, " {}={}", COUNTER_NAMES[counter], value);
+            }
+            report.push('\n');
+        }
+
+        report.push_str("total:");
+        for counter in 0..COUNTERS_PER_SLOT {
+            let _ = write!(report, " {}={}", COUNTER_NAMES[counter], totals[counter]);
+        }
+        report.push('\n');
+        report
+    }
+}
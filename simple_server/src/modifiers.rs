@@ -0,0 +1,737 @@
+// J Modifier Registry Module
+// Adverbs take a verb and derive a new one; conjunctions take a verb and a
+// noun. As with the verb registry, one descriptor per modifier names its
+// forms and the kernels that implement them; a kernel receives the operand
+// verb phrase (and the noun operand, for conjunctions) along with the
+// arguments.
+
+use crate::evaluator::EvaluationError;
+use crate::j_array::{ArrayShape, JArray, JValue};
+use crate::parser::{JNode, JVerb};
+use crate::verbs::{self, numeric_class, Element, NumericClass, Repeat, FIXED_POINT_LIMIT};
+use std::borrow::Cow;
+
+// Which form of a verb is being called
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub enum Valence {
+    Monadic,
+    Dyadic,
+}
+
+pub type DerivedMonad = fn(&JVerb, &JArray) -> Result<JArray, EvaluationError>;
+pub type DerivedDyad = fn(&JVerb, &JArray, &JArray) -> Result<JArray, EvaluationError>;
+pub type ConjunctionMonad = fn(&JVerb, &JArray, &JArray) -> Result<JArray, EvaluationError>;
+pub type ConjunctionDyad = fn(&JVerb, &JArray, &JArray, &JArray) -> Result<JArray, EvaluationError>;
+
+pub struct AdverbDescriptor {
+    pub symbol: char,
+    pub spelling: &'static str,
+    pub monadic_name: &'static str,
+    pub dyadic_name: &'static str,
+    pub monad: Option<DerivedMonad>,
+    pub dyad: Option<DerivedDyad>,
+    // The form of the operand verb that each derived form calls
+    pub monadic_operand: Valence,
+    pub dyadic_operand: Valence,
+}
+
+// A conjunction whose right operand is a noun (u"n); the noun is evaluated
+// before the kernel runs and handed to it ahead of the arguments
+pub struct ConjunctionDescriptor {
+    pub symbol: char,
+    pub spelling: &'static str,
+    pub monadic_name: &'static str,
+    pub dyadic_name: &'static str,
+    pub monad: Option<ConjunctionMonad>,
+    pub dyad: Option<ConjunctionDyad>,
+    pub monadic_operand: Valence,
+    pub dyadic_operand: Valence,
+}
+
+pub static ADVERBS: &[AdverbDescriptor] = &[
+    AdverbDescriptor {
+        symbol: '/',
+        spelling: "/",
+        monadic_name: "insert",
+        dyadic_name: "table",
+        monad: Some(insert),
+        dyad: Some(table),
+        monadic_operand: Valence::Dyadic,
+        dyadic_operand: Valence::Dyadic,
+    },
+    AdverbDescriptor {
+        symbol: '\\',
+        spelling: "\\",
+        monadic_name: "prefix",
+        dyadic_name: "infix",
+        monad: Some(prefix),
+        dyad: Some(infix),
+        monadic_operand: Valence::Monadic,
+        dyadic_operand: Valence::Monadic,
+    },
+];
+
+pub static CONJUNCTIONS: &[ConjunctionDescriptor] = &[
+    ConjunctionDescriptor {
+        symbol: '"',
+        spelling: "\"",
+        monadic_name: "rank",
+        dyadic_name: "rank",
+        monad: Some(rank_monad),
+        dyad: Some(rank_dyad),
+        monadic_operand: Valence::Monadic,
+        dyadic_operand: Valence::Dyadic,
+    },
+    ConjunctionDescriptor {
+        symbol: '^',
+        spelling: "^:",
+        monadic_name: "power",
+        dyadic_name: "power",
+        monad: Some(power_monad),
+        dyad: Some(power_dyad),
+        monadic_operand: Valence::Monadic,
+        dyadic_operand: Valence::Dyadic,
+    },
+];
+
+pub fn lookup(symbol: char) -> Option<&'static AdverbDescriptor> {
+    ADVERBS.iter().find(|adverb| adverb.symbol == symbol)
+}
+
+pub fn lookup_spelling(spelling: &str) -> Option<&'static AdverbDescriptor> {
+    ADVERBS.iter().find(|adverb| adverb.spelling == spelling)
+}
+
+pub fn lookup_conjunction(symbol: char) -> Option<&'static ConjunctionDescriptor> {
+    CONJUNCTIONS.iter().find(|conjunction| conjunction.symbol == symbol)
+}
+
+pub fn lookup_conjunction_spelling(spelling: &str) -> Option<&'static ConjunctionDescriptor> {
+    CONJUNCTIONS.iter().find(|conjunction| conjunction.spelling == spelling)
+}
+
+pub fn is_spelling(spelling: &str) -> bool {
+    lookup_spelling(spelling).is_some() || lookup_conjunction_spelling(spelling).is_some()
+}
+
+pub fn starts_spelling(c: char) -> bool {
+    ADVERBS.iter().any(|adverb| adverb.spelling.starts_with(c))
+        || CONJUNCTIONS.iter().any(|conjunction| conjunction.spelling.starts_with(c))
+}
+
+// The noun operand of a conjunction, which the evaluator binds to a literal
+// before the phrase is applied
+fn noun_operand(node: &JNode) -> Result<&JArray, EvaluationError> {
+    match node {
+        JNode::Literal(array) => Ok(array),
+        _ => Err(EvaluationError::DomainError("Conjunction operand was not evaluated".to_string())),
+    }
+}
+
+// Apply a verb phrase monadically
+pub fn apply_monad(verb: &JVerb, array: &JArray) -> Result<JArray, EvaluationError> {
+    match verb {
+        JVerb::Primitive(symbol) => match verbs::lookup(*symbol).and_then(|v| v.monad) {
+            Some(kernel) => kernel(array),
+            None => Err(EvaluationError::UnsupportedVerb(*symbol, "Monadic form not implemented".to_string())),
+        },
+        JVerb::Adverb(adverb, operand) => match lookup(*adverb).and_then(|a| a.monad) {
+            Some(kernel) => kernel(operand, array),
+            None => Err(EvaluationError::UnsupportedVerb(*adverb, "Monadic form not implemented".to_string())),
+        },
+        JVerb::Conjunction(conjunction, operand, noun) => match lookup_conjunction(*conjunction).and_then(|c| c.monad) {
+            Some(kernel) => kernel(operand, noun_operand(noun)?, array),
+            None => Err(EvaluationError::UnsupportedVerb(*conjunction, "Monadic form not implemented".to_string())),
+        },
+        JVerb::Explicit(definition) => definition.call(None, array),
+    }
+}
+
+// Apply a verb phrase dyadically
+pub fn apply_dyad(verb: &JVerb, left: &JArray, right: &JArray) -> Result<JArray, EvaluationError> {
+    match verb {
+        JVerb::Primitive(symbol) => match verbs::lookup(*symbol).and_then(|v| v.dyad) {
+            Some(kernel) => kernel(left, right),
+            None => Err(EvaluationError::UnsupportedVerb(*symbol, "Dyadic form not implemented".to_string())),
+        },
+        JVerb::Adverb(adverb, operand) => match lookup(*adverb).and_then(|a| a.dyad) {
+            Some(kernel) => kernel(operand, left, right),
+            None => Err(EvaluationError::UnsupportedVerb(*adverb, "Dyadic form not implemented".to_string())),
+        },
+        JVerb::Conjunction(conjunction, operand, noun) => match lookup_conjunction(*conjunction).and_then(|c| c.dyad) {
+            Some(kernel) => kernel(operand, noun_operand(noun)?, left, right),
+            None => Err(EvaluationError::UnsupportedVerb(*conjunction, "Dyadic form not implemented".to_string())),
+        },
+        JVerb::Explicit(definition) => definition.call(Some(left), right),
+    }
+}
+
+// INSERT
+
+// Insert (u/ y): place the dyad u between the items of y. Primitives with a
+// specialised insert kernel use it; any other verb is folded from the right,
+// as J defines it. An empty y gives u's identity, shaped like an item.
+fn insert(verb: &JVerb, array: &JArray) -> Result<JArray, EvaluationError> {
+    if array.shape.rank() == 0 {
+        return Ok(array.clone());
+    }
+    let primitive = match verb {
+        JVerb::Primitive(symbol) => verbs::lookup(*symbol),
+        _ => None,
+    };
+    let items = array.tally();
+    if items == 0 {
+        let identity = primitive.and_then(|v| v.identity.clone()).ok_or_else(|| {
+            EvaluationError::DomainError(format!("{}/ of an empty array has no identity", verb))
+        })?;
+        let item_shape = ArrayShape { dimensions: array.shape.dimensions[1..].to_vec() };
+        return Ok(JArray::from_data(vec![identity; item_shape.total_elements()], item_shape));
+    }
+    if let Some(kernel) = primitive.and_then(|v| v.insert) {
+        return kernel(array, 0);
+    }
+
+    let mut result = array.item(items - 1);
+    for index in (0..items - 1).rev() {
+        result = apply_dyad(verb, &array.item(index), &result)?;
+    }
+    Ok(result)
+}
+
+// Table (x u/ y): u between each cell of x and the whole of y, the cells
+// being those of u's left rank. Primitives with a table kernel compute
+// every pair of atoms at once.
+fn table(verb: &JVerb, left: &JArray, right: &JArray) -> Result<JArray, EvaluationError> {
+    let primitive = match verb {
+        JVerb::Primitive(symbol) => verbs::lookup(*symbol),
+        _ => None,
+    };
+    if let Some(kernel) = primitive.and_then(|v| v.table) {
+        return kernel(left, right);
+    }
+
+    let cell_rank = primitive.map_or(left.shape.rank(), |v| v.dyadic_rank.0.min(left.shape.rank()));
+    let frame = left.shape.dimensions[..left.shape.rank() - cell_rank].to_vec();
+    let cell_shape = left.shape.dimensions[frame.len()..].to_vec();
+    let cell_count: usize = frame.iter().product();
+    let mut dimensions = vec![cell_count];
+    dimensions.extend_from_slice(&cell_shape);
+    let cells = left.reshape(ArrayShape { dimensions })?;
+
+    let results = (0..cell_count)
+        .map(|index| apply_dyad(verb, &cells.item(index), right))
+        .collect::<Result<Vec<_>, _>>()?;
+    Ok(JArray::from_cells(frame, results)?)
+}
+
+// PREFIX AND INFIX
+
+// Prefix (u\ y): u applied to the first 1, 2, ... items of y
+fn prefix(verb: &JVerb, array: &JArray) -> Result<JArray, EvaluationError> {
+    let windows: Vec<(usize, usize)> = (1..=array.tally()).map(|count| (0, count)).collect();
+    windowed(verb, array, &windows)
+}
+
+// Infix (x u\ y): u applied to each run of x consecutive items of y; a
+// negative x takes non-overlapping runs, the last of which may be short
+fn infix(verb: &JVerb, size: &JArray, array: &JArray) -> Result<JArray, EvaluationError> {
+    let size = match (size.element_count(), size.value(0)) {
+        (1, JValue::Integer(n)) if size.shape.rank() <= 1 => n as i64,
+        _ => return Err(EvaluationError::DomainError("Infix length must be an integer atom".to_string())),
+    };
+    let items = array.tally();
+    let windows: Vec<(usize, usize)> = if size >= 0 {
+        let size = size as usize;
+        (0..(items + 1).saturating_sub(size)).map(|start| (start, size)).collect()
+    } else {
+        let size = size.unsigned_abs() as usize;
+        (0..items).step_by(size).map(|start| (start, size.min(items - start))).collect()
+    };
+    windowed(verb, array, &windows)
+}
+
+// Apply u to each window, given as (first item, item count). Both ends of the
+// windows only ever move forward, so the reductions J programs slide most
+// (+/ <./ >./) are computed incrementally instead of window by window.
+fn windowed(verb: &JVerb, array: &JArray, windows: &[(usize, usize)]) -> Result<JArray, EvaluationError> {
+    if let Some(result) = sliding_reduction(verb, array, windows) {
+        return Ok(result);
+    }
+    if let Some(cells) = running_insert(verb, array, windows) {
+        return Ok(JArray::from_cells(vec![windows.len()], cells?)?);
+    }
+    let cells = map_windows(verb, array, windows)?;
+    Ok(JArray::from_cells(vec![windows.len()], cells)?)
+}
+
+// The general path: one call of u per window, spread over threads by the
+// shared parallel helper when there are enough windows
+fn map_windows(verb: &JVerb, array: &JArray, windows: &[(usize, usize)]) -> Result<Vec<JArray>, EvaluationError> {
+    let threads = verbs::available_threads();
+    let mode = verbs::reduction();
+    let apply = |part: &[(usize, usize)]| {
+        verbs::with_reduction(mode, || {
+            part.iter()
+                .map(|&(start, count)| apply_monad(verb, &array.take_items(start, count)))
+                .collect::<Result<Vec<_>, _>>()
+        })
+    };
+    let mut cells = Vec::with_capacity(windows.len());
+    for part in verbs::in_parallel(windows, windows.len().div_ceil(threads), threads, &apply) {
+        cells.extend(part?);
+    }
+    Ok(cells)
+}
+
+// Sliding kernels for +/ (any item shape) and <./ >./ (lists), or None when
+// u is something else and must be applied window by window
+fn sliding_reduction(verb: &JVerb, array: &JArray, windows: &[(usize, usize)]) -> Option<JArray> {
+    let reduced = match verb {
+        JVerb::Adverb('/', operand) => match operand.as_ref() {
+            JVerb::Primitive(symbol) => *symbol,
+            _ => return None,
+        },
+        _ => return None,
+    };
+    let class = numeric_class(array, "Infix").ok()?;
+    let item_shape = array.shape.dimensions.get(1..).unwrap_or(&[]);
+    let mut dimensions = vec![windows.len()];
+    dimensions.extend_from_slice(item_shape);
+    let shape = ArrayShape { dimensions };
+
+    match (reduced, class) {
+        ('+', NumericClass::Integer) => {
+            let values: Vec<i64> = read_values::<i32>(array).into_iter().map(i64::from).collect();
+            let totals = sliding_sums(&values, item_shape.iter().product(), windows);
+            if totals.iter().all(|&t| i32::try_from(t).is_ok()) {
+                Some(JArray::from_ints(totals.into_iter().map(|t| t as i32).collect(), shape))
+            } else {
+                Some(JArray::from_data(totals.into_iter().map(|t| JValue::Float(t as f64)).collect(), shape))
+            }
+        }
+        ('+', NumericClass::Float) => {
+            let totals = sliding_sums(&read_values::<f64>(array), item_shape.iter().product(), windows);
+            Some(JArray::from_data(totals.into_iter().map(JValue::Float).collect(), shape))
+        }
+        // An empty window would need the float identity; leave that to insert
+        ('⌊' | '⌈', _) if array.shape.rank() == 1 && windows.iter().all(|&(_, count)| count > 0) => {
+            let maximum = reduced == '⌈';
+            match class {
+                NumericClass::Integer => {
+                    let extremes = sliding_extremes(&read_values::<i32>(array), windows, maximum);
+                    Some(JArray::from_ints(extremes, shape))
+                }
+                NumericClass::Float => {
+                    let extremes = sliding_extremes(&read_values::<f64>(array), windows, maximum);
+                    Some(JArray::from_data(extremes.into_iter().map(JValue::Float).collect(), shape))
+                }
+            }
+        }
+        _ => None,
+    }
+}
+
+// Prefixes (u/\ y) of an associative primitive: each is the one before it
+// with u and the next item, which associativity makes equal to inserting u
+// into the whole prefix, so the scan applies u once per item
+fn running_insert(verb: &JVerb, array: &JArray, windows: &[(usize, usize)]) -> Option<Result<Vec<JArray>, EvaluationError>> {
+    let descriptor = match verb {
+        JVerb::Adverb('/', operand) => match operand.as_ref() {
+            JVerb::Primitive(symbol) => verbs::lookup(*symbol)?,
+            _ => return None,
+        },
+        _ => return None,
+    };
+    let prefixes = windows.iter().enumerate().all(|(index, &window)| window == (0, index + 1));
+    let dyad = descriptor.dyad.filter(|_| descriptor.associative && prefixes)?;
+    let mut cells: Vec<JArray> = Vec::with_capacity(windows.len());
+    for index in 0..windows.len() {
+        let item = array.item(index);
+        let cell = match cells.last() {
+            Some(previous) => match dyad(previous, &item) {
+                Ok(cell) => cell,
+                Err(error) => return Some(Err(error)),
+            },
+            None => item,
+        };
+        cells.push(cell);
+    }
+    Some(Ok(cells))
+}
+
+fn read_values<T: Element>(array: &JArray) -> Vec<T> {
+    (0..array.element_count()).map(|i| T::read(&array.value(i))).collect()
+}
+
+// Moving sums of items of `item_size` values: each step adds the items that
+// enter the window and subtracts those that leave, so the pass is O(items)
+// whatever the window length. (Float totals carry the rounding of every
+// addition and subtraction along, as any running sum does.)
+fn sliding_sums<T>(values: &[T], item_size: usize, windows: &[(usize, usize)]) -> Vec<T>
+where
+    T: Copy + Default + std::ops::AddAssign + std::ops::SubAssign,
+{
+    let mut totals = vec![T::default(); item_size];
+    let mut result = Vec::with_capacity(windows.len() * item_size);
+    let (mut low, mut high) = (0, 0);
+    for &(start, count) in windows {
+        for item in high..start + count {
+            for (total, &value) in totals.iter_mut().zip(&values[item * item_size..(item + 1) * item_size]) {
+                *total += value;
+            }
+        }
+        for item in low..start {
+            for (total, &value) in totals.iter_mut().zip(&values[item * item_size..(item + 1) * item_size]) {
+                *total -= value;
+            }
+        }
+        (low, high) = (start, high.max(start + count));
+        result.extend_from_slice(&totals);
+    }
+    result
+}
+
+// Moving minimum or maximum with a monotonic deque: the indices that can
+// still be the extreme of a later window, best first. Every index is pushed
+// and popped at most once.
+fn sliding_extremes<T: Copy + PartialOrd>(values: &[T], windows: &[(usize, usize)], maximum: bool) -> Vec<T> {
+    let outranks = |a: T, b: T| if maximum { a >= b } else { a <= b };
+    let mut candidates = std::collections::VecDeque::new();
+    let mut result = Vec::with_capacity(windows.len());
+    let mut high = 0;
+    for &(start, count) in windows {
+        while high < start + count {
+            while candidates.back().is_some_and(|&i| outranks(values[high], values[i])) {
+                candidates.pop_back();
+            }
+            candidates.push_back(high);
+            high += 1;
+        }
+        while candidates.front().is_some_and(|&i| i < start) {
+            candidates.pop_front();
+        }
+        result.push(values[candidates[0]]);
+    }
+    result
+}
+
+
+// RANK
+
+// Rank (u"n): u applied to the cells of rank n of each argument, the
+// results assembled in the frame around those cells. Built-in verbs that
+// already act cell by cell take the whole argument in one call; anything
+// else gets one call per cell, each cell copied out as it is reached.
+fn rank_monad(verb: &JVerb, ranks: &JArray, array: &JArray) -> Result<JArray, EvaluationError> {
+    let [rank, _, _] = rank_operand(ranks)?;
+    let cells = Cells::new(array, rank);
+    if cells.frame.is_empty() {
+        return apply_monad(verb, array);
+    }
+    if let Some(result) = whole_monad(verb, &cells)? {
+        return Ok(result);
+    }
+    let results = (0..cells.count())
+        .map(|index| apply_monad(verb, &cells.get(index)))
+        .collect::<Result<Vec<_>, _>>()?;
+    Ok(JArray::from_cells(cells.frame, results)?)
+}
+
+// Dyadic rank (x u"n y): cells of x and y are paired up. One frame must be a
+// prefix of the other; each cell of the shorter frame goes with every cell
+// of the longer frame beneath it.
+fn rank_dyad(verb: &JVerb, ranks: &JArray, left: &JArray, right: &JArray) -> Result<JArray, EvaluationError> {
+    let [_, left_rank, right_rank] = rank_operand(ranks)?;
+    let (left, right) = (Cells::new(left, left_rank), Cells::new(right, right_rank));
+    if left.frame.is_empty() && right.frame.is_empty() {
+        return apply_dyad(verb, left.array, right.array);
+    }
+    let frame = if left.frame.len() >= right.frame.len() { &left.frame } else { &right.frame };
+    let shorter = if left.frame.len() < right.frame.len() { &left.frame } else { &right.frame };
+    if !frame.starts_with(shorter) {
+        return Err(EvaluationError::DimensionMismatch(format!(
+            "Rank: frames {:?} and {:?} do not agree", left.frame, right.frame
+        )));
+    }
+    let frame = frame.clone();
+    if let Some(result) = whole_dyad(verb, &left, &right, &frame)? {
+        return Ok(result);
+    }
+    let count: usize = frame.iter().product();
+    let (left_repeat, right_repeat) = (count / left.count().max(1), count / right.count().max(1));
+    let results = (0..count)
+        .map(|index| apply_dyad(verb, &left.get(index / left_repeat), &right.get(index / right_repeat)))
+        .collect::<Result<Vec<_>, _>>()?;
+    Ok(JArray::from_cells(frame, results)?)
+}
+
+// Ranks given as one number for every form, two for (left, right) with the
+// monad taking the right, or three for (monad, left, right). A negative rank
+// counts down from the rank of the argument.
+fn rank_operand(ranks: &JArray) -> Result<[i64; 3], EvaluationError> {
+    let invalid = || EvaluationError::DomainError("Rank must be a list of one to three integers".to_string());
+    if ranks.shape.rank() > 1 {
+        return Err(invalid());
+    }
+    let values = (0..ranks.element_count())
+        .map(|index| match ranks.value(index) {
+            JValue::Integer(rank) => Ok(rank as i64),
+            JValue::Float(rank) if rank == f64::INFINITY => Ok(i64::MAX),
+            _ => Err(invalid()),
+        })
+        .collect::<Result<Vec<_>, _>>()?;
+    match values[..] {
+        [rank] => Ok([rank; 3]),
+        [left, right] => Ok([right, left, right]),
+        [monad, left, right] => Ok([monad, left, right]),
+        _ => Err(invalid()),
+    }
+}
+
+// An argument seen as a frame of cells of some rank
+struct Cells<'a> {
+    array: &'a JArray,
+    frame: Vec<usize>,
+    cell_shape: Vec<usize>,
+}
+
+impl<'a> Cells<'a> {
+    fn new(array: &'a JArray, rank: i64) -> Self {
+        let array_rank = array.shape.rank();
+        let rank = if rank < 0 {
+            array_rank.saturating_sub(rank.unsigned_abs() as usize)
+        } else {
+            (rank as usize).min(array_rank)
+        };
+        let (frame, cell_shape) = array.shape.dimensions.split_at(array_rank - rank);
+        Cells { array, frame: frame.to_vec(), cell_shape: cell_shape.to_vec() }
+    }
+
+    fn count(&self) -> usize {
+        self.frame.iter().product()
+    }
+
+    fn cell_size(&self) -> usize {
+        self.cell_shape.iter().product()
+    }
+
+    fn get(&self, index: usize) -> JArray {
+        let size = self.cell_size();
+        self.array.slice(index * size..(index + 1) * size, ArrayShape { dimensions: self.cell_shape.clone() })
+    }
+}
+
+// u"n y in a single call, for verbs whose result on each cell is known to
+// be their result on the whole argument (or a reshaping of it)
+fn whole_monad(verb: &JVerb, cells: &Cells) -> Result<Option<JArray>, EvaluationError> {
+    match verb {
+        JVerb::Primitive(symbol) => {
+            let descriptor = match verbs::lookup(*symbol) {
+                Some(descriptor) => descriptor,
+                None => return Ok(None),
+            };
+            match (*symbol, descriptor.monad) {
+                // Atom by atom whatever the cells are
+                (_, Some(kernel)) if descriptor.monadic_rank == 0 => kernel(cells.array).map(Some),
+                // Ravel: each cell becomes a list, which is a reshape of the whole
+                (',', _) => {
+                    let mut dimensions = cells.frame.clone();
+                    dimensions.push(cells.cell_size());
+                    Ok(Some(cells.array.reshape(ArrayShape { dimensions })?))
+                }
+                // Tally: every cell has the same number of items
+                ('#', _) => {
+                    let items = cells.cell_shape.first().copied().unwrap_or(1);
+                    let tally = JValue::Integer(items as i32);
+                    Ok(Some(JArray::repeated(vec![tally], ArrayShape { dimensions: cells.frame.clone() })))
+                }
+                _ => Ok(None),
+            }
+        }
+        // u/ on cells is u/ along the first axis of the cells
+        JVerb::Adverb('/', operand) => {
+            let kernel = match operand.as_ref() {
+                JVerb::Primitive(symbol) => verbs::lookup(*symbol).and_then(|v| v.insert),
+                _ => None,
+            };
+            match (kernel, cells.cell_shape.first()) {
+                (_, None) => Ok(Some(cells.array.clone())),
+                (Some(kernel), Some(&items)) if items > 0 => kernel(cells.array, cells.frame.len()).map(Some),
+                _ => Ok(None),
+            }
+        }
+        _ => Ok(None),
+    }
+}
+
+// x u"n y in a single call for scalar dyads: each argument is laid out over
+// the common frame and cell shape, after which u pairs them atom by atom
+fn whole_dyad(verb: &JVerb, left: &Cells, right: &Cells, frame: &[usize]) -> Result<Option<JArray>, EvaluationError> {
+    let kernel = match verb {
+        JVerb::Primitive(symbol) => match verbs::lookup(*symbol) {
+            Some(descriptor) if descriptor.is_scalar_dyad() => descriptor.dyad,
+            _ => None,
+        },
+        _ => None,
+    };
+    let kernel = match kernel {
+        Some(kernel) => kernel,
+        None => return Ok(None),
+    };
+    let cell_shape = if left.cell_shape.len() >= right.cell_shape.len() { &left.cell_shape } else { &right.cell_shape };
+    let shorter = if left.cell_shape.len() < right.cell_shape.len() { &left.cell_shape } else { &right.cell_shape };
+    if !cell_shape.starts_with(shorter) {
+        return Err(EvaluationError::DimensionMismatch(format!(
+            "Rank: cells of shape {:?} and {:?} do not agree", left.cell_shape, right.cell_shape
+        )));
+    }
+    let mut dimensions = frame.to_vec();
+    dimensions.extend_from_slice(cell_shape);
+    let shape = ArrayShape { dimensions };
+    kernel(&spread(left, &shape, frame.len()), &spread(right, &shape, frame.len())).map(Some)
+}
+
+// Lay an argument out over `shape`, the common frame followed by the common
+// cell shape: each cell is repeated across the frame axes it lacks, and each
+// atom across the cell axes it lacks. An argument that already has the shape
+// is borrowed, and a single cell repeated over the frame stays compact.
+fn spread<'a>(cells: &Cells<'a>, shape: &ArrayShape, frame_len: usize) -> Cow<'a, JArray> {
+    if cells.array.shape == *shape {
+        return Cow::Borrowed(cells.array);
+    }
+    if shape.total_elements() == 0 {
+        return Cow::Owned(JArray::from_data(Vec::new(), shape.clone()));
+    }
+    let cell_size = cells.cell_size();
+    let cell_repeat = shape.dimensions[..frame_len].iter().product::<usize>() / cells.count();
+    let atom_repeat = shape.dimensions[frame_len..].iter().product::<usize>() / cell_size;
+    let cell = |index: usize| (index * cell_size..(index + 1) * cell_size).map(|i| cells.array.value(i));
+    if cells.count() == 1 && atom_repeat == 1 {
+        return Cow::Owned(JArray::repeated(cell(0).collect(), shape.clone()));
+    }
+
+    let mut data = Vec::with_capacity(shape.total_elements());
+    for index in 0..cells.count() {
+        for _ in 0..cell_repeat {
+            for value in cell(index) {
+                data.extend(std::iter::repeat(value).take(atom_repeat));
+            }
+        }
+    }
+    Cow::Owned(JArray::from_data(data, shape.clone()))
+}
+
+
+// POWER
+
+// Power (u^:n y): u applied n times; u^:0 is y itself, a negative n applies
+// u's inverse, and an infinite n applies u until the result stops changing.
+// A list of powers gives each result, laid out in the shape of n.
+fn power_monad(verb: &JVerb, powers: &JArray, array: &JArray) -> Result<JArray, EvaluationError> {
+    each_power(powers, |power| match power {
+        Power::Inverse(times) => {
+            let inverse = inverse(verb).ok_or_else(|| {
+                EvaluationError::DomainError(format!("{} has no inverse", verb))
+            })?;
+            repeat(&inverse, None, array, Repeat::Times(times))
+        }
+        Power::Forward(repeat_by) => repeat(verb, None, array, repeat_by),
+    })
+}
+
+// Dyadic power (x u^:n y): x&u applied n times to y, x staying fixed
+fn power_dyad(verb: &JVerb, powers: &JArray, left: &JArray, right: &JArray) -> Result<JArray, EvaluationError> {
+    each_power(powers, |power| match power {
+        Power::Inverse(_) => Err(EvaluationError::DomainError(format!(
+            "x {}^:n y has no inverse for a negative n", verb
+        ))),
+        Power::Forward(repeat_by) => repeat(verb, Some(left), right, repeat_by),
+    })
+}
+
+enum Power {
+    Forward(Repeat),
+    Inverse(usize),
+}
+
+fn each_power(powers: &JArray, apply: impl Fn(Power) -> Result<JArray, EvaluationError>) -> Result<JArray, EvaluationError> {
+    let power = |index: usize| match powers.value(index) {
+        JValue::Integer(n) if n >= 0 => Ok(Power::Forward(Repeat::Times(n as usize))),
+        JValue::Integer(n) => Ok(Power::Inverse(n.unsigned_abs() as usize)),
+        JValue::Float(n) if n == f64::INFINITY => Ok(Power::Forward(Repeat::FixedPoint)),
+        _ => Err(EvaluationError::DomainError("Power must be integers or _ (infinity)".to_string())),
+    };
+    if powers.shape.rank() == 0 {
+        return apply(power(0)?);
+    }
+    let results = (0..powers.element_count())
+        .map(|index| apply(power(index)?))
+        .collect::<Result<Vec<_>, _>>()?;
+    Ok(JArray::from_cells(powers.shape.dimensions.clone(), results)?)
+}
+
+// The verb that undoes u's monad, where one is known
+fn inverse(verb: &JVerb) -> Option<JVerb> {
+    match verb {
+        JVerb::Primitive(symbol) => verbs::lookup(*symbol)?.inverse.map(JVerb::Primitive),
+        _ => None,
+    }
+}
+
+// Apply u (or x&u) repeatedly. Primitives with an iterate kernel run the
+// whole loop themselves; otherwise the kernel is looked up once and called
+// on each result in turn, the previous one being dropped as soon as the
+// next exists.
+fn repeat(verb: &JVerb, left: Option<&JArray>, array: &JArray, repeat_by: Repeat) -> Result<JArray, EvaluationError> {
+    if repeat_by == Repeat::Times(0) {
+        return Ok(array.clone());
+    }
+    let primitive = match verb {
+        JVerb::Primitive(symbol) => verbs::lookup(*symbol),
+        _ => None,
+    };
+    if let Some(kernel) = primitive.and_then(|v| v.iterate) {
+        if let Some(result) = kernel(left, array, repeat_by)? {
+            return Ok(result);
+        }
+    }
+
+    let (monad, dyad) = (primitive.and_then(|v| v.monad), primitive.and_then(|v| v.dyad));
+    let step = |current: &JArray| match (left, monad, dyad) {
+        (None, Some(kernel), _) => kernel(current),
+        (Some(left), _, Some(kernel)) => kernel(left, current),
+        (None, _, _) => apply_monad(verb, current),
+        (Some(left), _, _) => apply_dyad(verb, left, current),
+    };
+    let mut current = array.clone();
+    match repeat_by {
+        Repeat::Times(times) => {
+            for _ in 0..times {
+                current = step(&current)?;
+            }
+            Ok(current)
+        }
+        Repeat::FixedPoint => {
+            for _ in 0..FIXED_POINT_LIMIT {
+                let next = step(&current)?;
+                if same_result(&next, &current) {
+                    return Ok(current);
+                }
+                current = next;
+            }
+            Err(EvaluationError::DomainError(format!(
+                "{}^:_ did not reach a fixed point within {} iterations", verb, FIXED_POINT_LIMIT
+            )))
+        }
+    }
+}
+
+// J's match (-:): equal shapes and tolerantly equal atoms
+fn same_result(a: &JArray, b: &JArray) -> bool {
+    a.shape == b.shape && (0..a.element_count()).all(|index| match (a.value(index), b.value(index)) {
+        (x @ (JValue::Integer(_) | JValue::Float(_)), y @ (JValue::Integer(_) | JValue::Float(_))) => {
+            verbs::tolerantly_equal(f64::read(&x), f64::read(&y))
+        }
+        (x, y) => x == y,
+    })
+}
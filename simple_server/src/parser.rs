@@ -1,18 +1,69 @@
 // J Parser Module
 // Syntactic analysis for J language expressions
 
+use crate::explicit::ExplicitDefinition;
 use crate::j_array::JArray;
 use crate::tokenizer::Token;
+use crate::{modifiers, verbs};
 use std::fmt;
+use std::sync::Arc;
+
+// A verb phrase: a primitive verb, a verb modified by an adverb, a verb
+// joined to a noun by a conjunction, or an explicit definition
+#[derive(Debug, Clone)]
+pub enum JVerb {
+    Primitive(char),
+    Adverb(char, Box<JVerb>),
+    Conjunction(char, Box<JVerb>, Box<JNode>),
+    Explicit(Arc<ExplicitDefinition>),
+}
+
+// J spelling of the phrase, e.g. "+/\"
+impl fmt::Display for JVerb {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        match self {
+            JVerb::Primitive(verb) => match verbs::lookup(*verb) {
+                Some(descriptor) => write!(f, "{}", descriptor.spelling),
+                None => write!(f, "{}", verb),
+            },
+            JVerb::Adverb(adverb, operand) => match modifiers::lookup(*adverb) {
+                Some(descriptor) => write!(f, "{}{}", operand, descriptor.spelling),
+                None => write!(f, "{}{}", operand, adverb),
+            },
+            JVerb::Conjunction(conjunction, operand, noun) => {
+                match modifiers::lookup_conjunction(*conjunction) {
+                    Some(descriptor) => write!(f, "{}{}", operand, descriptor.spelling)?,
+                    None => write!(f, "{}{}", operand, conjunction)?,
+                }
+                match noun.as_ref() {
+                    JNode::Literal(array) => write!(f, "{}", array),
+                    JNode::Name(name) => write!(f, "{}", name),
+                    _ => write!(f, "(...)"),
+                }
+            }
+            JVerb::Explicit(definition) => write!(f, "{}", definition),
+        }
+    }
+}
 
 // AST node structure for representing J expressions
 #[derive(Debug, Clone)]
 pub enum JNode {
     // Final resolved nodes
     Literal(JArray),
+    Name(String),
+    // A name inside an explicit definition, resolved to its slot
+    Local(usize, String),
     MonadicVerb(char, Box<JNode>),
     DyadicVerb(char, Box<JNode>, Box<JNode>),
     
+    // A derived verb applied to its right (and, when dyadic, left) argument
+    DerivedVerb(JVerb, Option<Box<JNode>>, Box<JNode>),
+    
+    // Subtrees that occur more than once, evaluated in order into slots the
+    // body reads as locals (see sharing.rs)
+    Shared(Vec<JNode>, Box<JNode>),
+    
     // Intermediate ambiguous nodes for context resolution
     AmbiguousVerb(char, Option<Box<JNode>>, Option<Box<JNode>>),
 }
@@ -104,9 +155,19 @@ impl JParser {
                 // Literal vector/scalar
                 Ok((JNode::Literal(jarray.clone()), pos + 1))
             }
+            Token::Name(name) => {
+                // Name bound at evaluation time
+                Ok((JNode::Name(name.clone()), pos + 1))
+            }
             Token::LeftParen | Token::RightParen => {
                 Err(ParseError::InvalidExpression("Parentheses not supported in old parser".to_string()))
             }
+            Token::Adverb(_) | Token::Conjunction(_) => {
+                Err(ParseError::InvalidExpression("Modifiers not supported in old parser".to_string()))
+            }
+            Token::Definition(_) | Token::Assign | Token::Control(_) | Token::Newline => {
+                Err(ParseError::InvalidExpression("Explicit definitions not supported in old parser".to_string()))
+            }
         }
     }
 }
\ No newline at end of file
@@ -0,0 +1,240 @@
+// Random Number Module
+// Roll (? y) and deal (x ? y), drawing from a counter-based generator: draw i
+// of a stream is a SplitMix64 hash of the stream's key and i, so any range of
+// draws can be computed on its own. A bulk roll reserves a range of its
+// thread's stream and splits it across threads, getting exactly the values a
+// sequential fill would. Every thread has its own stream; with_seed replaces
+// it for a reproducible evaluation, and ?. always starts from a fixed seed.
+
+use crate::evaluator::EvaluationError;
+use crate::j_array::{check_elements, max_elements, ArrayShape, JArray, JValue, PackedInts};
+use crate::verbs;
+use std::cell::Cell;
+use std::hash::{BuildHasher, Hasher};
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::OnceLock;
+
+// Seed of ?. (J's default seed)
+pub const FIXED_SEED: u64 = 16807;
+
+// Rolls with fewer values than this are filled on the calling thread
+#[cfg(not(target_arch = "wasm32"))]
+const PARALLEL_MIN_DRAWS: usize = 1 << 18;
+
+const GAMMA: u64 = 0x9e37_79b9_7f4a_7c15;
+
+#[derive(Clone, Copy)]
+struct Stream {
+    key: u64,
+    next: u64,
+}
+
+static NEXT_STREAM: AtomicU64 = AtomicU64::new(0);
+
+thread_local! {
+    static STREAM: Cell<Stream> = Cell::new(Stream::fresh());
+}
+
+impl Stream {
+    fn seeded(seed: u64) -> Self {
+        Stream { key: mix(seed), next: 0 }
+    }
+
+    // A new thread's stream: keyed by a per-process seed and the order in
+    // which threads first draw, so no two threads share a key
+    fn fresh() -> Self {
+        static PROCESS_SEED: OnceLock<u64> = OnceLock::new();
+        let process = *PROCESS_SEED.get_or_init(|| std::collections::hash_map::RandomState::new().build_hasher().finish());
+        Stream::seeded(process ^ NEXT_STREAM.fetch_add(1, Ordering::Relaxed).wrapping_mul(GAMMA))
+    }
+
+    // Claim the next `count` draws, returning the first
+    fn reserve(&mut self, count: usize) -> u64 {
+        let start = self.next;
+        self.next = self.next.wrapping_add(count as u64);
+        start
+    }
+}
+
+// Run `f` with this thread drawing from a stream seeded by `seed`, so the
+// same seed gives the same values; the thread's own stream resumes afterwards
+pub fn with_seed<T>(seed: u64, f: impl FnOnce() -> T) -> T {
+    struct Restore(Stream);
+    impl Drop for Restore {
+        fn drop(&mut self) {
+            STREAM.with(|stream| stream.set(self.0));
+        }
+    }
+    let _restore = Restore(STREAM.with(|stream| stream.replace(Stream::seeded(seed))));
+    f()
+}
+
+#[inline]
+fn mix(mut z: u64) -> u64 {
+    z = (z ^ (z >> 30)).wrapping_mul(0xbf58_476d_1ce4_e5b9);
+    z = (z ^ (z >> 27)).wrapping_mul(0x94d0_49bb_1331_11eb);
+    z ^ (z >> 31)
+}
+
+#[inline]
+fn draw(key: u64, counter: u64) -> u64 {
+    mix(key.wrapping_add(counter.wrapping_mul(GAMMA)))
+}
+
+// An integer in [0, bound) from the high bits, by multiply and shift
+#[inline]
+fn below(bits: u64, bound: u64) -> u64 {
+    ((bits >> 32) * bound) >> 32
+}
+
+// A float in the open interval (0, 1)
+#[inline]
+fn unit(bits: u64) -> f64 {
+    ((bits >> 11) as f64 + 0.5) * (1.0 / (1u64 << 53) as f64)
+}
+
+// Roll (?): for each atom n of y, an integer drawn uniformly from i.n, or
+// a float in (0, 1) when n is 0
+pub fn roll(bounds: &JArray) -> Result<JArray, EvaluationError> {
+    roll_from(bounds, reserve_current)
+}
+
+// Roll with a fixed seed (?.): the same arguments always give the same values
+pub fn roll_fixed(bounds: &JArray) -> Result<JArray, EvaluationError> {
+    roll_from(bounds, reserve_fixed)
+}
+
+// Deal (x ? y): x different integers drawn from i.y, in random order
+pub fn deal(count: &JArray, range: &JArray) -> Result<JArray, EvaluationError> {
+    deal_from(count, range, reserve_current)
+}
+
+pub fn deal_fixed(count: &JArray, range: &JArray) -> Result<JArray, EvaluationError> {
+    deal_from(count, range, reserve_fixed)
+}
+
+// The key and first counter of `count` draws from this thread's stream
+fn reserve_current(count: usize) -> (u64, u64) {
+    STREAM.with(|stream| {
+        let mut current = stream.get();
+        let start = current.reserve(count);
+        stream.set(current);
+        (current.key, start)
+    })
+}
+
+fn reserve_fixed(count: usize) -> (u64, u64) {
+    let mut stream = Stream::seeded(FIXED_SEED);
+    (stream.key, stream.reserve(count))
+}
+
+fn bound(value: &JValue, verb: &str) -> Result<u64, EvaluationError> {
+    match value {
+        JValue::Integer(n) if *n >= 0 => Ok(*n as u64),
+        JValue::Float(f) if *f >= 0.0 && f.fract() == 0.0 && *f <= i32::MAX as f64 => Ok(*f as u64),
+        _ => Err(EvaluationError::DomainError(format!("{} requires non-negative integers", verb))),
+    }
+}
+
+fn roll_from(bounds: &JArray, reserve: impl FnOnce(usize) -> (u64, u64)) -> Result<JArray, EvaluationError> {
+    let count = bounds.element_count();
+    let shape = bounds.shape.clone();
+
+    // One bound for the whole array (a scalar, or a reshaped one) is filled
+    // in bulk, straight into the narrowest storage that holds the results
+    if let Some([value]) = bounds.period() {
+        let n = bound(value, "Roll")?;
+        let (key, start) = reserve(count);
+        return Ok(match n {
+            0 => {
+                let mut values = vec![JValue::Float(0.0); count];
+                fill(&mut values, key, start, verbs::available_threads(), |bits| JValue::Float(unit(bits)));
+                JArray::from_data(values, shape)
+            }
+            n if n <= 1 << 7 => JArray::from_packed(PackedInts::I8(filled(count, key, start, |bits| below(bits, n) as i8)), shape),
+            n if n <= 1 << 15 => JArray::from_packed(PackedInts::I16(filled(count, key, start, |bits| below(bits, n) as i16)), shape),
+            n => JArray::from_packed(PackedInts::I32(filled(count, key, start, |bits| below(bits, n) as i32).into()), shape),
+        });
+    }
+
+    let bounds: Vec<u64> = bounds.elements().map(|value| bound(&value, "Roll")).collect::<Result<_, _>>()?;
+    let (key, start) = reserve(count);
+    let draws = (start..).map(|counter| draw(key, counter));
+    if bounds.contains(&0) {
+        // A float anywhere makes the whole result float
+        let values = bounds.iter().zip(draws)
+            .map(|(&n, bits)| JValue::Float(if n == 0 { unit(bits) } else { below(bits, n) as f64 }))
+            .collect();
+        return Ok(JArray::from_data(values, shape));
+    }
+    Ok(JArray::from_ints(bounds.iter().zip(draws).map(|(&n, bits)| below(bits, n) as i32).collect(), shape))
+}
+
+fn deal_from(count: &JArray, range: &JArray, reserve: impl FnOnce(usize) -> (u64, u64)) -> Result<JArray, EvaluationError> {
+    if !count.is_scalar() || !range.is_scalar() {
+        return Err(EvaluationError::RankError("Deal requires scalar arguments".to_string()));
+    }
+    let (k, n) = (bound(&count.element(0), "Deal")?, bound(&range.element(0), "Deal")?);
+    if k > n {
+        return Err(EvaluationError::DomainError(format!("Deal cannot draw {} different values from {}", k, n)));
+    }
+    check_elements(Some(k as usize))?;
+    let (key, start) = reserve(k as usize);
+
+    // Partial Fisher-Yates: position i swaps with a random later position.
+    // Only positions that were swapped are stored when i.n is large, or when
+    // a whole deck would be more than a result may hold.
+    let mut dealt = Vec::with_capacity(k as usize);
+    if n <= 4 * k && n as usize <= max_elements() {
+        let mut deck: Vec<i32> = (0..n as i32).collect();
+        for i in 0..k {
+            let j = i + below(draw(key, start.wrapping_add(i)), n - i);
+            deck.swap(i as usize, j as usize);
+        }
+        dealt.extend_from_slice(&deck[..k as usize]);
+    } else {
+        let mut moved: std::collections::HashMap<u64, u64> = std::collections::HashMap::with_capacity(2 * k as usize);
+        for i in 0..k {
+            let j = i + below(draw(key, start.wrapping_add(i)), n - i);
+            let at_j = moved.get(&j).copied().unwrap_or(j);
+            let at_i = moved.get(&i).copied().unwrap_or(i);
+            moved.insert(j, at_i);
+            dealt.push(at_j as i32);
+        }
+    }
+    Ok(JArray::from_ints(dealt, ArrayShape::vector(k as usize)))
+}
+
+fn filled<T: Copy + Default + Send>(count: usize, key: u64, start: u64, value: impl Fn(u64) -> T + Sync) -> Vec<T> {
+    let mut values = vec![T::default(); count];
+    fill(&mut values, key, start, verbs::available_threads(), value);
+    values
+}
+
+// Write draws start.. of the stream `key` through `value`, splitting the
+// slice across up to `threads` threads when it is long; each part starts at
+// its own offset, so the values do not depend on how the slice was split
+pub fn fill<T: Send>(values: &mut [T], key: u64, start: u64, threads: usize, value: impl Fn(u64) -> T + Sync) {
+    #[cfg(not(target_arch = "wasm32"))]
+    {
+        if threads > 1 && values.len() >= PARALLEL_MIN_DRAWS {
+            let chunk = values.len().div_ceil(threads);
+            let value = &value;
+            std::thread::scope(|scope| {
+                for (k, part) in values.chunks_mut(chunk).enumerate() {
+                    scope.spawn(move || fill_range(part, key, start.wrapping_add((k * chunk) as u64), value));
+                }
+            });
+            return;
+        }
+    }
+    let _ = threads;
+    fill_range(values, key, start, &value)
+}
+
+#[inline]
+fn fill_range<T>(values: &mut [T], key: u64, start: u64, value: &impl Fn(u64) -> T) {
+    for (i, slot) in values.iter_mut().enumerate() {
+        *slot = value(draw(key, start.wrapping_add(i as u64)));
+    }
+}
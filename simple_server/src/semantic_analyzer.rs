@@ -1,8 +1,11 @@
 // J Semantic Analyzer Module - Enhanced for All Operators
 // Context resolution and semantic validation for J expressions
 
-use crate::parser::JNode;
+use crate::parser::{JNode, JVerb};
 use crate::j_array::ArrayError;
+use crate::{modifiers, verbs};
+use crate::modifiers::Valence;
+use crate::sharing;
 use std::fmt;
 
 // Semantic analysis errors
@@ -49,8 +52,15 @@ impl JSemanticAnalyzer {
         JSemanticAnalyzer
     }
 
-    // Analyze and resolve context for the AST
+    // Analyze and resolve context for the AST, then share its repeated
+    // subtrees so each is evaluated once
     pub fn analyze(&self, ast: JNode) -> Result<JNode, SemanticError> {
+        Ok(sharing::share(self.resolve_context(ast)?))
+    }
+
+    // Resolve context only, for sentences whose names become the slots of
+    // an explicit definition
+    pub fn resolve(&self, ast: JNode) -> Result<JNode, SemanticError> {
         self.resolve_context(ast)
     }
 
@@ -90,7 +100,20 @@ impl JSemanticAnalyzer {
                     }
                 }
             }
+            JNode::DerivedVerb(verb, left, right) => {
+                let resolved_left = match left {
+                    Some(left) => Some(Box::new(self.resolve_context(*left)?)),
+                    None => None,
+                };
+                let resolved_right = self.resolve_context(*right)?;
+                let valence = if resolved_left.is_some() { Valence::Dyadic } else { Valence::Monadic };
+                let resolved_verb = self.resolve_phrase(verb, valence)?;
+                Ok(JNode::DerivedVerb(resolved_verb, resolved_left, Box::new(resolved_right)))
+            }
             JNode::Literal(array) => Ok(JNode::Literal(array)),
+            JNode::Name(name) => Ok(JNode::Name(name)),
+            JNode::Local(slot, name) => Ok(JNode::Local(slot, name)),
+            JNode::Shared(common, body) => Ok(JNode::Shared(common, body)),
             JNode::MonadicVerb(verb, arg) => {
                 let resolved_arg = self.resolve_context(*arg)?;
                 self.validate_monadic_verb(verb)?;
@@ -109,19 +132,58 @@ impl JSemanticAnalyzer {
         }
     }
 
+    // Validate a verb phrase used with the given valence, and the forms of
+    // its operand verbs that the modifiers call on; the noun operands of
+    // conjunctions are resolved like any other expression
+    fn resolve_phrase(&self, verb: JVerb, valence: Valence) -> Result<JVerb, SemanticError> {
+        match verb {
+            // Sentences in a definition were analyzed when it was compiled
+            JVerb::Explicit(definition) => Ok(JVerb::Explicit(definition)),
+            JVerb::Primitive(symbol) => {
+                match valence {
+                    Valence::Monadic => self.validate_monadic_verb(symbol)?,
+                    Valence::Dyadic => self.validate_dyadic_verb(symbol)?,
+                }
+                Ok(JVerb::Primitive(symbol))
+            }
+            JVerb::Adverb(adverb, operand) => {
+                let descriptor = modifiers::lookup(adverb).ok_or_else(|| {
+                    SemanticError::InvalidVerbUsage(adverb, "Unknown adverb".to_string())
+                })?;
+                let (form, name, operand_valence) = match valence {
+                    Valence::Monadic => (descriptor.monad.is_some(), descriptor.monadic_name, descriptor.monadic_operand),
+                    Valence::Dyadic => (descriptor.dyad.is_some(), descriptor.dyadic_name, descriptor.dyadic_operand),
+                };
+                check_modifier_form(adverb, valence, form, name)?;
+                Ok(JVerb::Adverb(adverb, Box::new(self.resolve_phrase(*operand, operand_valence)?)))
+            }
+            JVerb::Conjunction(conjunction, operand, noun) => {
+                let descriptor = modifiers::lookup_conjunction(conjunction).ok_or_else(|| {
+                    SemanticError::InvalidVerbUsage(conjunction, "Unknown conjunction".to_string())
+                })?;
+                let (form, name, operand_valence) = match valence {
+                    Valence::Monadic => (descriptor.monad.is_some(), descriptor.monadic_name, descriptor.monadic_operand),
+                    Valence::Dyadic => (descriptor.dyad.is_some(), descriptor.dyadic_name, descriptor.dyadic_operand),
+                };
+                check_modifier_form(conjunction, valence, form, name)?;
+                Ok(JVerb::Conjunction(
+                    conjunction,
+                    Box::new(self.resolve_phrase(*operand, operand_valence)?),
+                    Box::new(self.resolve_context(*noun)?),
+                ))
+            }
+        }
+    }
+
     // Validate that a verb can be used monadically
     fn validate_monadic_verb(&self, verb: char) -> Result<(), SemanticError> {
-        match verb {
-            '+' => Ok(()), // Identity
-            '~' => Ok(()), // Iota
-            '#' => Ok(()), // Tally
-            ',' => Ok(()), // Ravel
-            '<' => Ok(()), // Box
-            '{' => Err(SemanticError::InvalidVerbUsage(
-                '{', 
-                "Monadic { (catalog) not supported in this implementation".to_string()
+        match verbs::lookup(verb) {
+            Some(descriptor) if descriptor.monad.is_some() => Ok(()),
+            Some(descriptor) => Err(SemanticError::InvalidVerbUsage(
+                verb, 
+                unsupported_form_message("Monadic", verb, descriptor.monadic_name)
             )),
-            _ => Err(SemanticError::InvalidVerbUsage(
+            None => Err(SemanticError::InvalidVerbUsage(
                 verb, 
                 "Unknown monadic verb".to_string()
             )),
@@ -130,20 +192,34 @@ impl JSemanticAnalyzer {
 
     // Validate that a verb can be used dyadically
     fn validate_dyadic_verb(&self, verb: char) -> Result<(), SemanticError> {
-        match verb {
-            '+' => Ok(()), // Plus
-            '#' => Ok(()), // Reshape
-            '{' => Ok(()), // From/Index
-            ',' => Ok(()), // Concatenate
-            '<' => Ok(()), // Less than
-            '~' => Err(SemanticError::InvalidVerbUsage(
-                '~', 
-                "Dyadic ~ not supported in this implementation".to_string()
+        match verbs::lookup(verb) {
+            Some(descriptor) if descriptor.dyad.is_some() => Ok(()),
+            Some(descriptor) => Err(SemanticError::InvalidVerbUsage(
+                verb, 
+                unsupported_form_message("Dyadic", verb, descriptor.dyadic_name)
             )),
-            _ => Err(SemanticError::InvalidVerbUsage(
+            None => Err(SemanticError::InvalidVerbUsage(
                 verb, 
                 "Unknown dyadic verb".to_string()
             )),
         }
     }
-}
\ No newline at end of file
+}
+
+// e.g. "Monadic { (catalog) not supported in this implementation"
+fn unsupported_form_message(valence: &str, verb: char, name: &str) -> String {
+    if name.is_empty() {
+        format!("{} {} not supported in this implementation", valence, verb)
+    } else {
+        format!("{} {} ({}) not supported in this implementation", valence, verb, name)
+    }
+}
+
+// Error unless the modifier has the form a phrase is called with
+fn check_modifier_form(symbol: char, valence: Valence, form: bool, name: &str) -> Result<(), SemanticError> {
+    if form {
+        return Ok(());
+    }
+    let valence_name = if valence == Valence::Monadic { "Monadic" } else { "Dyadic" };
+    Err(SemanticError::InvalidVerbUsage(symbol, unsupported_form_message(valence_name, symbol, name)))
+}
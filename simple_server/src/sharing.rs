@@ -0,0 +1,244 @@
+// Common Subexpression Module
+// Hash-conses an analyzed tree into a DAG: structurally identical subtrees
+// get the same id, and a subtree reached more than once is evaluated once
+// into a slot that every occurrence reads by reference; the arguments of a
+// commutative dyad count in either order. Verbs have no side
+// effects, so any repeated subtree can be shared - except one that rolls or
+// deals, which draws new values each time it is evaluated.
+
+use crate::parser::{JNode, JVerb};
+use crate::verbs;
+use std::collections::HashMap;
+use std::fmt::Write;
+use std::sync::Arc;
+
+// A node's structure, with its children given by their ids
+#[derive(PartialEq, Eq, Hash)]
+enum Key {
+    Literal(String),
+    Name(String),
+    Local(usize),
+    Monadic(char, usize),
+    Dyadic(char, usize, usize),
+    Derived(String, Option<usize>, usize),
+    Other,
+}
+
+#[derive(Default)]
+struct Sharing {
+    keys: HashMap<Key, usize>,
+    // Ids by node address; children sit in boxes, so their addresses hold
+    // while the tree is taken apart
+    ids: HashMap<*const JNode, usize>,
+    reached: Vec<usize>,
+    slots: HashMap<usize, usize>,
+    common: Vec<JNode>,
+}
+
+// Share the repeated subtrees of `ast`, returning it unchanged when none are
+// repeated and as a JNode::Shared otherwise
+pub fn share(ast: JNode) -> JNode {
+    let mut sharing = Sharing::default();
+    sharing.intern(&ast);
+    sharing.reach(&ast);
+    if !sharing.reached.iter().any(|&count| count > 1) {
+        return ast;
+    }
+    let body = sharing.rewrite_children(ast);
+    if sharing.common.is_empty() {
+        return body;
+    }
+    JNode::Shared(sharing.common, Box::new(body))
+}
+
+// True when evaluating `node` draws random values anywhere inside it
+pub fn draws_random(node: &JNode) -> bool {
+    draws_here(node) || match node {
+        JNode::Literal(_) | JNode::Name(_) | JNode::Local(_, _) => false,
+        JNode::MonadicVerb(_, arg) => draws_random(arg),
+        JNode::DyadicVerb(_, left, right) => draws_random(left) || draws_random(right),
+        JNode::DerivedVerb(_, left, right) => left.as_deref().is_some_and(draws_random) || draws_random(right),
+        JNode::AmbiguousVerb(_, left, right) => left.iter().chain(right.iter()).any(|child| draws_random(child)),
+        JNode::Shared(common, body) => common.iter().any(draws_random) || draws_random(body),
+    }
+}
+
+// True when `node` itself draws: its verb is roll or deal, or a phrase using
+// them (nouns of conjunctions are nodes of their own)
+fn draws_here(node: &JNode) -> bool {
+    match node {
+        JNode::MonadicVerb(verb, _) | JNode::DyadicVerb(verb, _, _) => *verb == '?',
+        JNode::DerivedVerb(verb, _, _) => phrase_draws(verb),
+        _ => false,
+    }
+}
+
+fn phrase_draws(verb: &JVerb) -> bool {
+    match verb {
+        JVerb::Primitive(symbol) => *symbol == '?',
+        JVerb::Adverb(_, operand) => phrase_draws(operand),
+        JVerb::Conjunction(_, operand, noun) => phrase_draws(operand) || draws_random(noun),
+        JVerb::Explicit(definition) => definition.draws_random(),
+    }
+}
+
+// Leaves are already read in place, so sharing them gains nothing
+fn is_leaf(node: &JNode) -> bool {
+    matches!(node, JNode::Literal(_) | JNode::Name(_) | JNode::Local(_, _))
+}
+
+impl Sharing {
+    // Give every node in the tree an id, equal ids for equal structure
+    fn intern(&mut self, node: &JNode) -> usize {
+        let key = match node {
+            JNode::Literal(array) => {
+                let mut text = format!("{:?}", array.shape.dimensions);
+                for value in array.elements() {
+                    let _ = write!(text, " {:?}", value);
+                }
+                Key::Literal(text)
+            }
+            JNode::Name(name) => Key::Name(name.clone()),
+            JNode::Local(slot, _) => Key::Local(*slot),
+            JNode::MonadicVerb(verb, arg) => Key::Monadic(*verb, self.intern(arg)),
+            JNode::DyadicVerb(verb, left, right) => {
+                let (left, right) = (self.intern(left), self.intern(right));
+                // x f y and y f x are the same value when f commutes
+                match verbs::lookup(*verb) {
+                    Some(descriptor) if descriptor.commutative => Key::Dyadic(*verb, left.min(right), left.max(right)),
+                    _ => Key::Dyadic(*verb, left, right),
+                }
+            }
+            JNode::DerivedVerb(verb, left, right) => {
+                let mut phrase = String::new();
+                self.intern_phrase(verb, &mut phrase);
+                let left = left.as_deref().map(|left| self.intern(left));
+                Key::Derived(phrase, left, self.intern(right))
+            }
+            JNode::Shared(_, _) | JNode::AmbiguousVerb(_, _, _) => Key::Other,
+        };
+        // A draw equals nothing else, so neither does anything containing it
+        let key = if draws_here(node) { Key::Other } else { key };
+        let next = self.reached.len();
+        let id = match key {
+            Key::Other => next,
+            key => *self.keys.entry(key).or_insert(next),
+        };
+        if id == next {
+            self.reached.push(0);
+        }
+        self.ids.insert(node as *const JNode, id);
+        id
+    }
+
+    // Spell a verb phrase for its key, with conjunction nouns by id
+    fn intern_phrase(&mut self, verb: &JVerb, phrase: &mut String) {
+        match verb {
+            JVerb::Primitive(symbol) => phrase.push(*symbol),
+            JVerb::Adverb(adverb, operand) => {
+                self.intern_phrase(operand, phrase);
+                phrase.push(*adverb);
+            }
+            JVerb::Conjunction(conjunction, operand, noun) => {
+                self.intern_phrase(operand, phrase);
+                let _ = write!(phrase, "{}#{}", conjunction, self.intern(noun));
+            }
+            // Definitions are compared by identity
+            JVerb::Explicit(definition) => {
+                let _ = write!(phrase, "{{{:p}}}", Arc::as_ptr(definition));
+            }
+        }
+    }
+
+    // Count how often each id is reached, not descending into a subtree that
+    // was reached before: it will be shared, so its insides are evaluated once
+    fn reach(&mut self, node: &JNode) {
+        let id = self.ids[&(node as *const JNode)];
+        self.reached[id] += 1;
+        if self.reached[id] > 1 {
+            return;
+        }
+        match node {
+            JNode::Literal(_) | JNode::Name(_) | JNode::Local(_, _) | JNode::Shared(_, _) => {}
+            JNode::MonadicVerb(_, arg) => self.reach(arg),
+            JNode::DyadicVerb(_, left, right) => {
+                self.reach(left);
+                self.reach(right);
+            }
+            JNode::DerivedVerb(verb, left, right) => {
+                self.reach_phrase(verb);
+                if let Some(left) = left {
+                    self.reach(left);
+                }
+                self.reach(right);
+            }
+            JNode::AmbiguousVerb(_, left, right) => {
+                for child in left.iter().chain(right.iter()) {
+                    self.reach(child);
+                }
+            }
+        }
+    }
+
+    fn reach_phrase(&mut self, verb: &JVerb) {
+        match verb {
+            JVerb::Primitive(_) | JVerb::Explicit(_) => {}
+            JVerb::Adverb(_, operand) => self.reach_phrase(operand),
+            JVerb::Conjunction(_, operand, noun) => {
+                self.reach_phrase(operand);
+                self.reach(noun);
+            }
+        }
+    }
+
+    // Replace a shared subtree by a read of its slot, evaluating it into the
+    // slot at its first occurrence. Slots are numbered in the order they are
+    // filled, so a common subtree only reads slots before its own.
+    fn rewrite(&mut self, node: Box<JNode>) -> Box<JNode> {
+        let id = self.ids[&(&*node as *const JNode)];
+        if self.reached[id] < 2 || is_leaf(&node) {
+            return Box::new(self.rewrite_children(*node));
+        }
+        let slot = match self.slots.get(&id) {
+            Some(&slot) => slot,
+            None => {
+                let common = self.rewrite_children(*node);
+                self.common.push(common);
+                self.slots.insert(id, self.common.len() - 1);
+                self.common.len() - 1
+            }
+        };
+        Box::new(JNode::Local(slot, format!("common {}", slot)))
+    }
+
+    fn rewrite_children(&mut self, node: JNode) -> JNode {
+        match node {
+            JNode::Literal(_) | JNode::Name(_) | JNode::Local(_, _) | JNode::Shared(_, _) => node,
+            JNode::MonadicVerb(verb, arg) => JNode::MonadicVerb(verb, self.rewrite(arg)),
+            JNode::DyadicVerb(verb, left, right) => {
+                let left = self.rewrite(left);
+                JNode::DyadicVerb(verb, left, self.rewrite(right))
+            }
+            JNode::DerivedVerb(verb, left, right) => {
+                let verb = self.rewrite_phrase(verb);
+                let left = left.map(|left| self.rewrite(left));
+                JNode::DerivedVerb(verb, left, self.rewrite(right))
+            }
+            JNode::AmbiguousVerb(verb, left, right) => {
+                let left = left.map(|left| self.rewrite(left));
+                JNode::AmbiguousVerb(verb, left, right.map(|right| self.rewrite(right)))
+            }
+        }
+    }
+
+    fn rewrite_phrase(&mut self, verb: JVerb) -> JVerb {
+        match verb {
+            JVerb::Primitive(_) | JVerb::Explicit(_) => verb,
+            JVerb::Adverb(adverb, operand) => JVerb::Adverb(adverb, Box::new(self.rewrite_phrase(*operand))),
+            JVerb::Conjunction(conjunction, operand, noun) => {
+                let operand = self.rewrite_phrase(*operand);
+                JVerb::Conjunction(conjunction, Box::new(operand), self.rewrite(noun))
+            }
+        }
+    }
+}
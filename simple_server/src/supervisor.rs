@@ -0,0 +1,424 @@
+// Multi-Process Supervisor Module
+// Runs N worker processes that share the HTTP port through SO_REUSEPORT
+//
+// `simple_server --workers N` starts a supervisor that re-executes the binary
+// N times with `--worker-index i`. Each worker binds its own listening socket
+// with SO_REUSEPORT so the kernel spreads connections across them, serves
+// static files from a snapshot that every worker maps read-only, and records
+// its counters in a slot of a shared metrics file. Workspace sessions are
+// kept in a directory the workers share. All three live in a private
+// directory the supervisor makes with mkdtemp. The supervisor restarts any worker that exits,
+// so a crash during one evaluation only drops that worker's in-flight requests.
+// On SIGTERM or SIGINT, or when it fails, the supervisor stops and reaps its
+// workers and removes the private directory.
+
+use crate::metrics::{Metrics, COUNTER_RESTARTS};
+use std::collections::HashMap;
+use std::fs::{self, File, OpenOptions};
+use std::io::{self, Write};
+use std::ops::Range;
+use std::ffi::{CString, OsString};
+use std::net::{SocketAddr, TcpListener};
+use std::os::unix::ffi::{OsStrExt, OsStringExt};
+use std::os::unix::io::{AsRawFd, FromRawFd};
+use std::path::{Path, PathBuf};
+use std::process::{Child, Command};
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::thread;
+use std::time::{Duration, Instant};
+
+// Worker flags added by the supervisor; not meant to be passed by hand
+pub const WORKER_INDEX_FLAG: &str = "--worker-index";
+pub const WORKER_COUNT_FLAG: &str = "--worker-count";
+pub const METRICS_FILE_FLAG: &str = "--metrics-file";
+pub const WORKSPACE_DIR_FLAG: &str = "--workspace-dir";
+pub const ASSETS_FILE_FLAG: &str = "--assets-file";
+
+// Directory whose files are snapshotted for the workers to serve
+pub const STATIC_DIR: &str = "./static";
+
+// Workers that die sooner than this after starting are restarted this long later
+const CRASH_LOOP_WINDOW: Duration = Duration::from_secs(1);
+const POLL_INTERVAL: Duration = Duration::from_millis(250);
+
+// Workers still running this long after SIGTERM are killed
+const SHUTDOWN_GRACE: Duration = Duration::from_secs(5);
+
+// Set by the SIGTERM/SIGINT handler; the supervision loop checks it
+static SHUTDOWN: AtomicBool = AtomicBool::new(false);
+
+extern "C" fn request_shutdown(_signal: libc::c_int) {
+    SHUTDOWN.store(true, Ordering::SeqCst);
+}
+
+// Identity of a worker process, parsed from the flags the supervisor passes
+pub struct WorkerConfig {
+    pub index: usize,
+    pub count: usize,
+    pub metrics_file: PathBuf,
+    pub workspace_dir: PathBuf,
+    // Absent when the static files could not be snapshotted
+    pub assets_file: Option<PathBuf>,
+}
+
+impl WorkerConfig {
+    pub fn from_args(args: &[String]) -> Option<Self> {
+        let value = |flag: &str| {
+            args.iter()
+                .position(|arg| arg == flag)
+                .and_then(|i| args.get(i + 1))
+        };
+        Some(WorkerConfig {
+            index: value(WORKER_INDEX_FLAG)?.parse().ok()?,
+            count: value(WORKER_COUNT_FLAG)?.parse().ok()?,
+            metrics_file: PathBuf::from(value(METRICS_FILE_FLAG)?),
+            workspace_dir: PathBuf::from(value(WORKSPACE_DIR_FLAG)?),
+            assets_file: value(ASSETS_FILE_FLAG).map(PathBuf::from),
+        })
+    }
+}
+
+// Start `workers` copies of this binary and keep them running until a
+// SIGTERM or SIGINT arrives.
+// `worker_args` are forwarded to every worker, `first_worker_args` only to
+// worker 0 (for listeners that cannot be shared, such as the Unix socket).
+pub fn run(workers: usize, worker_args: Vec<String>, first_worker_args: Vec<String>) -> io::Result<()> {
+    let exe = std::env::current_exe()?;
+    let private_dir = make_private_dir()?;
+    let result = prepare_and_supervise(&exe, workers, &worker_args, &first_worker_args, &private_dir);
+    // Workers are gone by now (Pool stops them on drop)
+    let _ = fs::remove_dir_all(&private_dir);
+    result
+}
+
+fn prepare_and_supervise(
+    exe: &Path,
+    workers: usize,
+    worker_args: &[String],
+    first_worker_args: &[String],
+    private_dir: &Path,
+) -> io::Result<()> {
+    let metrics_file = private_dir.join("metrics");
+    Metrics::create_shared_file(&metrics_file, workers)?;
+    let workspace_dir = private_dir.join("workspaces");
+    fs::create_dir(&workspace_dir)?;
+    let assets_file = private_dir.join("assets");
+    let assets_file = match StaticAssets::snapshot(Path::new(STATIC_DIR), &assets_file) {
+        Ok(()) => Some(assets_file),
+        Err(e) => {
+            println!("Static assets not snapshotted, workers will read from disk: {}", e);
+            None
+        }
+    };
+    unsafe {
+        libc::signal(libc::SIGTERM, request_shutdown as libc::sighandler_t);
+        libc::signal(libc::SIGINT, request_shutdown as libc::sighandler_t);
+    }
+    supervise(exe, workers, worker_args, first_worker_args, &metrics_file, &workspace_dir, assets_file.as_deref())
+}
+
+// A new directory under the temp dir that only this user can enter. mkdtemp
+// picks an unused name and creates it atomically, so nothing planted in
+// /tmp beforehand (a symlink, a directory of the same name) is reused.
+fn make_private_dir() -> io::Result<PathBuf> {
+    let template = std::env::temp_dir().join("j_interpreter_XXXXXX");
+    let mut template = CString::new(template.as_os_str().as_bytes())?.into_bytes_with_nul();
+    let made = unsafe { libc::mkdtemp(template.as_mut_ptr() as *mut libc::c_char) };
+    if made.is_null() {
+        return Err(io::Error::last_os_error());
+    }
+    template.pop();
+    Ok(PathBuf::from(OsString::from_vec(template)))
+}
+
+fn supervise(
+    exe: &Path,
+    workers: usize,
+    worker_args: &[String],
+    first_worker_args: &[String],
+    metrics_file: &Path,
+    workspace_dir: &Path,
+    assets_file: Option<&Path>,
+) -> io::Result<()> {
+    let metrics = Metrics::shared(metrics_file, 0, workers)?;
+    let spawn_worker = |index: usize| -> io::Result<Child> {
+        let mut command = Command::new(exe);
+        command.args(worker_args);
+        if index == 0 {
+            command.args(first_worker_args);
+        }
+        command
+            .arg(WORKER_INDEX_FLAG).arg(index.to_string())
+            .arg(WORKER_COUNT_FLAG).arg(workers.to_string())
+            .arg(METRICS_FILE_FLAG).arg(metrics_file)
+            .arg(WORKSPACE_DIR_FLAG).arg(workspace_dir);
+        if let Some(assets_file) = assets_file {
+            command.arg(ASSETS_FILE_FLAG).arg(assets_file);
+        }
+        command.spawn()
+    };
+
+    let mut pool = Pool(Vec::with_capacity(workers));
+    for index in 0..workers {
+        pool.0.push(Worker { child: spawn_worker(index)?, started: Instant::now(), restart_at: None });
+    }
+    println!("Supervisor started {} workers (metrics in {})", workers, metrics_file.display());
+
+    while !SHUTDOWN.load(Ordering::SeqCst) {
+        for (index, worker) in pool.0.iter_mut().enumerate() {
+            if SHUTDOWN.load(Ordering::SeqCst) {
+                break;
+            }
+            match worker.restart_at {
+                Some(restart_at) if Instant::now() < restart_at => continue,
+                Some(_) => {}
+                None => match worker.child.try_wait()? {
+                    None => continue,
+                    Some(status) => {
+                        println!("Worker {} (pid {}) exited with {}; restarting", index, worker.child.id(), status);
+                        metrics.add_to_slot(index, COUNTER_RESTARTS, 1);
+                        // A worker that dies straight after starting waits out the
+                        // window before its restart, while the loop goes on
+                        // watching the others
+                        if worker.started.elapsed() < CRASH_LOOP_WINDOW {
+                            worker.restart_at = Some(Instant::now() + CRASH_LOOP_WINDOW);
+                            continue;
+                        }
+                    }
+                },
+            }
+            worker.child = spawn_worker(index)?;
+            worker.started = Instant::now();
+            worker.restart_at = None;
+        }
+        thread::sleep(POLL_INTERVAL);
+    }
+    println!("Supervisor stopping {} workers", pool.0.len());
+    Ok(())
+}
+
+// A worker process and when it started. A worker that exited too soon keeps
+// its reaped process until `restart_at`, when it is started again.
+struct Worker {
+    child: Child,
+    started: Instant,
+    restart_at: Option<Instant>,
+}
+
+// The running workers. Dropping the pool (on shutdown or on any error while
+// supervising) sends each a SIGTERM, kills those that outlive SHUTDOWN_GRACE,
+// and reaps them all.
+struct Pool(Vec<Worker>);
+
+impl Drop for Pool {
+    fn drop(&mut self) {
+        // Workers waiting to restart were reaped already; their pids may
+        // belong to other processes by now
+        for worker in self.0.iter().filter(|worker| worker.restart_at.is_none()) {
+            unsafe {
+                libc::kill(worker.child.id() as libc::pid_t, libc::SIGTERM);
+            }
+        }
+        let deadline = Instant::now() + SHUTDOWN_GRACE;
+        for worker in self.0.iter_mut().filter(|worker| worker.restart_at.is_none()) {
+            while matches!(worker.child.try_wait(), Ok(None)) && Instant::now() < deadline {
+                thread::sleep(Duration::from_millis(20));
+            }
+            let _ = worker.child.kill();
+            let _ = worker.child.wait();
+        }
+    }
+}
+
+// Bind a TCP listener with SO_REUSEADDR and SO_REUSEPORT set before bind(2),
+// so every worker can listen on the same address
+pub fn reuseport_listener(addr: &str) -> io::Result<TcpListener> {
+    let addr: SocketAddr = addr.parse()
+        .map_err(|e| io::Error::new(io::ErrorKind::InvalidInput, format!("{}", e)))?;
+
+    unsafe {
+        let domain = if addr.is_ipv4() { libc::AF_INET } else { libc::AF_INET6 };
+        let fd = libc::socket(domain, libc::SOCK_STREAM, 0);
+        if fd < 0 {
+            return Err(io::Error::last_os_error());
+        }
+        // Owning the fd right away closes it on every error path below
+        let listener = TcpListener::from_raw_fd(fd);
+
+        let enable: libc::c_int = 1;
+        for option in [libc::SO_REUSEADDR, libc::SO_REUSEPORT] {
+            let rc = libc::setsockopt(
+                fd,
+                libc::SOL_SOCKET,
+                option,
+                &enable as *const libc::c_int as *const libc::c_void,
+                std::mem::size_of::<libc::c_int>() as libc::socklen_t,
+            );
+            if rc != 0 {
+                return Err(io::Error::last_os_error());
+            }
+        }
+
+        let rc = match addr {
+            SocketAddr::V4(v4) => {
+                let mut sin: libc::sockaddr_in = std::mem::zeroed();
+                sin.sin_family = libc::AF_INET as libc::sa_family_t;
+                sin.sin_port = v4.port().to_be();
+                sin.sin_addr = libc::in_addr { s_addr: u32::from_ne_bytes(v4.ip().octets()) };
+                libc::bind(
+                    fd,
+                    &sin as *const libc::sockaddr_in as *const libc::sockaddr,
+                    std::mem::size_of::<libc::sockaddr_in>() as libc::socklen_t,
+                )
+            }
+            SocketAddr::V6(v6) => {
+                let mut sin6: libc::sockaddr_in6 = std::mem::zeroed();
+                sin6.sin6_family = libc::AF_INET6 as libc::sa_family_t;
+                sin6.sin6_port = v6.port().to_be();
+                sin6.sin6_addr = libc::in6_addr { s6_addr: v6.ip().octets() };
+                libc::bind(
+                    fd,
+                    &sin6 as *const libc::sockaddr_in6 as *const libc::sockaddr,
+                    std::mem::size_of::<libc::sockaddr_in6>() as libc::socklen_t,
+                )
+            }
+        };
+        if rc != 0 {
+            return Err(io::Error::last_os_error());
+        }
+        if libc::listen(listener.as_raw_fd(), 128) != 0 {
+            return Err(io::Error::last_os_error());
+        }
+        Ok(listener)
+    }
+}
+
+// A MAP_SHARED mapping of a file, unmapped on drop
+pub struct MappedRegion {
+    ptr: *mut u8,
+    len: usize,
+}
+
+// The mapping is plain memory; synchronisation is up to the users of the bytes
+unsafe impl Send for MappedRegion {}
+unsafe impl Sync for MappedRegion {}
+
+impl MappedRegion {
+    pub fn map(file: &File, len: usize, writable: bool) -> io::Result<Self> {
+        if len == 0 {
+            return Ok(MappedRegion { ptr: std::ptr::null_mut(), len: 0 });
+        }
+        let prot = if writable { libc::PROT_READ | libc::PROT_WRITE } else { libc::PROT_READ };
+        let ptr = unsafe {
+            libc::mmap(std::ptr::null_mut(), len, prot, libc::MAP_SHARED, file.as_raw_fd(), 0)
+        };
+        if ptr == libc::MAP_FAILED {
+            return Err(io::Error::last_os_error());
+        }
+        Ok(MappedRegion { ptr: ptr as *mut u8, len })
+    }
+
+    pub fn as_ptr(&self) -> *mut u8 {
+        self.ptr
+    }
+
+    pub fn len(&self) -> usize {
+        self.len
+    }
+
+    pub fn as_slice(&self) -> &[u8] {
+        if self.len == 0 {
+            &[]
+        } else {
+            unsafe { std::slice::from_raw_parts(self.ptr, self.len) }
+        }
+    }
+}
+
+impl Drop for MappedRegion {
+    fn drop(&mut self) {
+        if self.len != 0 {
+            unsafe {
+                libc::munmap(self.ptr as *mut libc::c_void, self.len);
+            }
+        }
+    }
+}
+
+// Static assets served from one snapshot file that every worker maps
+// read-only (MAP_SHARED), so the pool holds a single copy in the page cache.
+// The supervisor writes the snapshot into its private directory before
+// starting any worker and never changes it, so unlike a mapping of the files
+// under ./static it cannot be truncated underneath a reader.
+//
+// Snapshot layout: for each file, [u32 url length][url][u64 length][bytes],
+// little-endian.
+pub struct StaticAssets {
+    region: MappedRegion,
+    files: HashMap<String, Range<usize>>,
+}
+
+impl StaticAssets {
+    // Write every file under `root` into a new snapshot at `path`
+    pub fn snapshot(root: &Path, path: &Path) -> io::Result<()> {
+        let mut files = Vec::new();
+        Self::collect(root, root, &mut files)?;
+        let file = OpenOptions::new().write(true).create_new(true).open(path)?;
+        let mut out = io::BufWriter::new(file);
+        for (url, source) in files {
+            let contents = fs::read(&source)?;
+            out.write_all(&(url.len() as u32).to_le_bytes())?;
+            out.write_all(url.as_bytes())?;
+            out.write_all(&(contents.len() as u64).to_le_bytes())?;
+            out.write_all(&contents)?;
+        }
+        out.flush()
+    }
+
+    fn collect(root: &Path, dir: &Path, files: &mut Vec<(String, PathBuf)>) -> io::Result<()> {
+        for entry in fs::read_dir(dir)? {
+            let path = entry?.path();
+            if path.is_dir() {
+                Self::collect(root, &path, files)?;
+            } else if path.is_file() {
+                let relative = path.strip_prefix(root).unwrap_or(&path);
+                files.push((format!("/{}", relative.to_string_lossy().replace('\\', "/")), path));
+            }
+        }
+        Ok(())
+    }
+
+    // Map a snapshot written by `snapshot` and index its files
+    pub fn map(path: &Path) -> io::Result<Self> {
+        let file = File::open(path)?;
+        let region = MappedRegion::map(&file, file.metadata()?.len() as usize, false)?;
+        let bytes = region.as_slice();
+        let mut files = HashMap::new();
+        let mut at = 0;
+        while at < bytes.len() {
+            let url_len = u32::from_le_bytes(bytes[Self::take(bytes, &mut at, 4)?].try_into().unwrap()) as usize;
+            let url = String::from_utf8_lossy(&bytes[Self::take(bytes, &mut at, url_len)?]).into_owned();
+            let len = u64::from_le_bytes(bytes[Self::take(bytes, &mut at, 8)?].try_into().unwrap()) as usize;
+            files.insert(url, Self::take(bytes, &mut at, len)?);
+        }
+        Ok(StaticAssets { region, files })
+    }
+
+    // The next `count` bytes of the snapshot from `at`, moving past them
+    fn take(bytes: &[u8], at: &mut usize, count: usize) -> io::Result<Range<usize>> {
+        let end = at.checked_add(count).filter(|&end| end <= bytes.len())
+            .ok_or_else(|| io::Error::new(io::ErrorKind::InvalidData, "truncated static asset snapshot"))?;
+        let range = *at..end;
+        *at = end;
+        Ok(range)
+    }
+
+    // Position of a request path such as "/http-adapter.js" in the snapshot
+    pub fn find(&self, url: &str) -> Option<Range<usize>> {
+        self.files.get(url).cloned()
+    }
+
+    pub fn bytes(&self, range: Range<usize>) -> &[u8] {
+        &self.region.as_slice()[range]
+    }
+}
@@ -7,6 +7,7 @@ mod tests {
     use crate::semantic_analyzer::JSemanticAnalyzer;
     use crate::evaluator::JEvaluator;
     use crate::parser::JNode;
+    use std::borrow::Cow;
 
     // Phase 1 Tests: Multi-Dimensional Array Support
     #[test]
@@ -70,20 +71,40 @@ mod tests {
     // Phase 3 Tests: Error Handling System
     #[test]
     fn test_reshape_errors() {
-        let array = JArray::vector(vec![1, 2, 3, 4]);
-        let invalid_shape = ArrayShape::vector(5); // Wrong number of elements
+        let array = JArray::vector(vec![]);
+        let invalid_shape = ArrayShape::vector(5); // Nothing to cycle through
         
         let result = array.reshape(invalid_shape);
         assert!(result.is_err());
         
         if let Err(ArrayError::InvalidReshape { from_shape, to_shape }) = result {
-            assert_eq!(from_shape.total_elements(), 4);
+            assert_eq!(from_shape.total_elements(), 0);
             assert_eq!(to_shape.total_elements(), 5);
         } else {
             panic!("Expected InvalidReshape error");
         }
     }
 
+    #[test]
+    fn test_result_size_limit() {
+        use crate::interpreter::JInterpreter;
+        let interpreter = JInterpreter::new();
+        let limit_error = |expression: &str| {
+            let error = interpreter.prepare(expression).and_then(|p| interpreter.execute_prepared(&p)).unwrap_err();
+            assert!(error.to_string().contains("Limit error"), "{}: {}", expression, error);
+        };
+
+        // Too many elements to count, and more than the limit
+        limit_error("100000 100000 100000 100000 $ 1");
+        limit_error("100000 100000 100000 $ 1");
+        limit_error("2000000000 # ~3");
+        limit_error("(3 $ 2000000000) # ~3");
+        limit_error("(~100000) +/ ~100000");
+        limit_error("300000000 ? 300000000");
+        assert!(matches!(JArray::scalar(1).reshape(ArrayShape::vector(usize::MAX)), Err(ArrayError::TooLarge(_))));
+        assert_eq!(ArrayShape { dimensions: vec![usize::MAX, 2] }.checked_elements(), None);
+    }
+
     #[test]
     fn test_index_bounds_errors() {
         let array = JArray::vector(vec![1, 2, 3]);
@@ -215,7 +236,7 @@ mod tests {
         
         let shape = JNode::Literal(JArray::vector(vec![2, 3]));
         let data = JNode::Literal(JArray::vector(vec![1, 2, 3, 4, 5, 6]));
-        let reshape_node = JNode::DyadicVerb('#', Box::new(shape), Box::new(data));
+        let reshape_node = JNode::DyadicVerb('$', Box::new(shape), Box::new(data));
         
         let result = evaluator.evaluate(&reshape_node).unwrap();
         assert!(result.is_matrix());
@@ -339,4 +360,1070 @@ mod tests {
         // ~3 is [0,1,2], #~4 is 4, so result should be [4,5,6]
         assert_eq!(result.get_data(), vec![4, 5, 6]);
     }
-}
\ No newline at end of file
+
+    // Verb Registry Tests
+    #[test]
+    fn test_verb_registry() {
+        use crate::verbs::{self, scalar_dyad, Plus};
+
+        let plus = verbs::lookup('+').unwrap();
+        assert!(plus.commutative && plus.associative && plus.is_scalar_dyad());
+        assert_eq!(plus.identity, Some(JValue::Integer(0)));
+        assert!(verbs::lookup('~').unwrap().dyad.is_none());
+        assert!(verbs::lookup('!').is_none());
+
+        // Integer pairs stay integer; mixed pairs and overflow promote to float
+        let ints = scalar_dyad::<Plus>(&JArray::scalar(1), &JArray::vector(vec![1, 2])).unwrap();
+        assert_eq!(ints.data, vec![JValue::Integer(2), JValue::Integer(3)]);
+        let mixed = JArray::from_data(vec![JValue::Float(0.5)], ArrayShape::scalar());
+        let floats = scalar_dyad::<Plus>(&mixed, &JArray::vector(vec![1, 2])).unwrap();
+        assert_eq!(floats.data, vec![JValue::Float(1.5), JValue::Float(2.5)]);
+        let overflow = scalar_dyad::<Plus>(&JArray::scalar(i32::MAX), &JArray::scalar(1)).unwrap();
+        assert_eq!(overflow.data, vec![JValue::Float(2147483648.0)]);
+
+        // Prefix agreement: each atom on the left pairs with a row on the right
+        let rows = scalar_dyad::<Plus>(&JArray::vector(vec![10, 20]), &JArray::matrix(vec![1, 2, 3, 4], 2, 2)).unwrap();
+        assert_eq!(rows.shape.dimensions, vec![2, 2]);
+        assert_eq!(rows.get_data(), vec![11, 12, 23, 24]);
+    }
+
+    // Cyclic Reshape Tests
+    #[test]
+    fn test_cyclic_reshape() {
+        // Small results cycle the source and stay dense
+        let cycled = JArray::vector(vec![1, 2, 3]).reshape(ArrayShape::matrix(2, 4)).unwrap();
+        assert!(cycled.is_dense());
+        assert_eq!(cycled.get_data(), vec![1, 2, 3, 1, 2, 3, 1, 2]);
+
+        // Large periodic results keep only the pattern
+        let big = JArray::vector(vec![1, 2, 3]).reshape(ArrayShape::matrix(1000, 1000)).unwrap();
+        assert!(!big.is_dense() && big.data.is_empty());
+        assert_eq!(*big.element(999_999), JValue::Integer(1));
+        assert_eq!(big.get_at_index(&[1, 0]).as_deref(), Some(&JValue::Integer(2)));
+
+        // Scalar dyads on repeated arrays compute one period
+        let evaluator = JEvaluator::new();
+        let zeros = JNode::DyadicVerb('$', Box::new(JNode::Literal(JArray::scalar(1_000_000))),
+            Box::new(JNode::Literal(JArray::scalar(0))));
+        let sum = evaluator.evaluate(&JNode::DyadicVerb('+', Box::new(JNode::Literal(JArray::scalar(7))), Box::new(zeros))).unwrap();
+        assert_eq!(*sum.stored(), [JValue::Integer(7)]);
+        assert_eq!(sum.shape.dimensions, vec![1_000_000]);
+        let doubled = scalar_dyad_plus(&big, &big);
+        assert_eq!(doubled.stored().len(), 3);
+        assert_eq!(doubled.clone().materialize(), scalar_dyad_plus(&big.to_dense(), &big.to_dense()));
+
+        // Compact and dense arrays compare by their elements
+        let small = JArray::vector(vec![5]).reshape(ArrayShape::vector(2048)).unwrap();
+        assert_eq!(small, JArray::vector(vec![5; 2048]));
+        assert_eq!(small.select_from(&JArray::vector(vec![0, 2047])).unwrap().get_data(), vec![5, 5]);
+    }
+
+    #[test]
+    fn test_append_leading_axis() {
+        // Items of matching shape are joined along the first axis
+        let top = JArray::matrix(vec![1, 2, 3, 4], 2, 2);
+        let joined = top.concatenate(&JArray::matrix(vec![5, 6], 1, 2)).unwrap();
+        assert_eq!(joined.shape.dimensions, vec![3, 2]);
+        assert_eq!(joined.get_data(), vec![1, 2, 3, 4, 5, 6]);
+        let row = top.concatenate(&JArray::vector(vec![7, 8])).unwrap();
+        assert_eq!(row.shape.dimensions, vec![3, 2]);
+        let filled = top.concatenate(&JArray::scalar(0)).unwrap();
+        assert_eq!(filled.get_data(), vec![1, 2, 3, 4, 0, 0]);
+        assert!(top.concatenate(&JArray::vector(vec![1, 2, 3])).is_err());
+
+        // Repeated appends extend a rope instead of copying the prefix
+        let mut built = JArray::vector(vec![]);
+        for i in 0..20_000 {
+            built = built.concatenate(&JArray::vector(vec![i])).unwrap();
+        }
+        assert!(matches!(built.layout, crate::j_array::Layout::Rope(_)));
+        assert_eq!(built.shape.dimensions, vec![20_000]);
+        assert_eq!(*built.element(12_345), JValue::Integer(12_345));
+        assert_eq!(built.get_data(), (0..20_000).collect::<Vec<i32>>());
+
+        // Reading every step flattens only the rope being read; the chain of
+        // pieces it shares with later appends stays as it was
+        let mut built = JArray::vector(vec![]);
+        for i in 0..3_000 {
+            built = built.concatenate(&JArray::vector(vec![i])).unwrap();
+            assert_eq!(*built.element(i as usize), JValue::Integer(i));
+        }
+        assert_eq!(built.get_data(), (0..3_000).collect::<Vec<i32>>());
+    }
+
+    #[test]
+    fn test_packed_integers() {
+        // Large integer arrays take the narrowest width that fits
+        let small = JArray::vector((0..2000).map(|i| i % 100).collect());
+        assert_eq!(small.packed().map(|p| p.width()), Some(1));
+        let medium = JArray::vector((0..30_000).collect());
+        assert_eq!(medium.packed().map(|p| (p.width(), p.min, p.max)), Some((2, 0, 29_999)));
+        assert!(JArray::vector(vec![1, 2, 3]).packed().is_none());
+
+        // Elements are read out of the packed words; nothing unpacked is kept
+        assert!(matches!(medium.element(12_345), Cow::Owned(JValue::Integer(12_345))));
+        assert!(medium.contiguous().is_none() && medium.data.is_empty());
+
+        // Kernels read packed widths directly and widen when results grow
+        let shifted = scalar_dyad_plus(&medium, &JArray::scalar(100_000));
+        assert_eq!(shifted.packed().map(|p| p.width()), Some(4));
+        assert_eq!(*shifted.element(29_999), JValue::Integer(129_999));
+        let narrowed = scalar_dyad_plus(&small, &small);
+        assert_eq!(narrowed.packed().map(|p| p.width()), Some(2));
+        assert_eq!(narrowed.value(1999), JValue::Integer(198));
+
+        // Integer overflow still promotes to float
+        let big = JArray::vector(vec![i32::MAX; 2000]);
+        let promoted = scalar_dyad_plus(&big, &JArray::scalar(1));
+        assert!(promoted.packed().is_none());
+        assert_eq!(*promoted.element(0), JValue::Float(2147483648.0));
+
+        let picked = medium.select_from(&JArray::vector((0..1500).map(|i| i % 7).collect())).unwrap();
+        assert_eq!(picked.packed().map(|p| p.width()), Some(1));
+    }
+
+    #[test]
+    fn test_run_length_arrays() {
+        // Mostly-constant integer data is encoded as runs on creation
+        let mut codes = vec![0; 4000];
+        codes[1000..3000].iter_mut().for_each(|v| *v = 2);
+        let mask = JArray::vector(codes);
+        let runs = mask.runs().expect("long runs should be encoded");
+        assert_eq!(runs.run_count(), 3);
+        assert_eq!(*mask.element(2500), JValue::Integer(2));
+        assert_eq!(mask.tally(), 4000);
+
+        // Scalar ops and comparisons work run by run and re-merge runs
+        let shifted = scalar_dyad_plus(&mask, &JArray::scalar(5));
+        assert_eq!(shifted.runs().unwrap().values, vec![JValue::Integer(5), JValue::Integer(7), JValue::Integer(5)]);
+        let flags = crate::verbs::scalar_dyad::<crate::verbs::LessThan>(&JArray::scalar(1), &mask).unwrap();
+        assert_eq!(flags.runs().unwrap().run_count(), 3);
+        let doubled = scalar_dyad_plus(&mask, &mask);
+        assert_eq!(doubled.runs().unwrap().ends, vec![1000, 3000, 4000]);
+        assert_eq!(doubled, scalar_dyad_plus(&mask.to_dense(), &mask.to_dense()));
+
+        // Dense boundaries expand on demand
+        let explicit = JArray::vector(vec![1, 1, 2]).run_length_encode();
+        assert_eq!(explicit.runs().unwrap().run_count(), 2);
+        assert_eq!(explicit.to_dense().data, vec![JValue::Integer(1), JValue::Integer(1), JValue::Integer(2)]);
+    }
+
+    #[test]
+    fn test_sparse_arrays() {
+        use crate::verbs::{self, LessThan};
+        use crate::j_array::Sparse;
+
+        // A 100x100 matrix with three nonzeros is stored sparse on creation
+        let mut values = vec![0; 10_000];
+        values[5] = 3;
+        values[1_203] = 4;
+        values[9_999] = 5;
+        let matrix = JArray::matrix(values, 100, 100);
+        assert_eq!(matrix.sparse().map(|s| s.nonzero_count()), Some(3));
+        assert_eq!(matrix.get_at_index(&[12, 3]).as_deref(), Some(&JValue::Integer(4)));
+        assert_eq!(matrix.get_at_index(&[50, 50]).as_deref(), Some(&JValue::Integer(0)));
+
+        // Elementwise ops touch the entries; the fill follows the operation
+        let doubled = scalar_dyad_plus(&matrix, &matrix);
+        assert_eq!(doubled.sparse().unwrap().values, vec![JValue::Integer(6), JValue::Integer(8), JValue::Integer(10)]);
+        let shifted = scalar_dyad_plus(&matrix, &JArray::scalar(1));
+        assert_eq!(shifted.sparse().unwrap().fill, JValue::Integer(1));
+        assert_eq!(*shifted.element(5), JValue::Integer(4));
+        let positive = verbs::scalar_dyad::<LessThan>(&JArray::scalar(0), &matrix).unwrap();
+        assert_eq!(positive.sparse().unwrap().nonzero_count(), 3);
+
+        // Column sums along the leading axis account for the fill
+        let sum = verbs::lookup('+').unwrap().insert.unwrap();
+        let columns = sum(&shifted, 0).unwrap();
+        assert_eq!(columns.shape.dimensions, vec![100]);
+        assert_eq!(*columns.element(3), JValue::Integer(104));
+        assert_eq!(*columns.element(99), JValue::Integer(105));
+        assert_eq!(sum(&JArray::vector(vec![1, 2, 3]), 0).unwrap(), JArray::scalar(6));
+
+        // A total past i64 carries on in floats rather than saturating
+        let len = 1usize << 40;
+        let wide = JArray::from_sparse(
+            Sparse::from_entries(vec![0], vec![JValue::Integer(1)], JValue::Integer(i32::MAX), len),
+            ArrayShape::vector(len),
+        );
+        let total = sum(&wide, 0).unwrap();
+        assert_eq!(*total.element(0), JValue::Float(i32::MAX as f64 * (len - 1) as f64 + 1.0));
+    }
+
+    #[test]
+    fn test_comparison_verbs() {
+        use crate::tokenizer::{JTokenizer, Token};
+        use crate::verbs::{self, scalar_dyad, Equal, LessOrEqual, Minimum, COMPARISON_TOLERANCE};
+
+        // Inflected spellings tokenize to their own verbs
+        let tokens = JTokenizer::new().tokenize("1 <: 2 ~: 3 >. 4").unwrap();
+        let spellings: Vec<&str> = tokens.iter().filter_map(|t| match t {
+            Token::Verb(symbol) => verbs::lookup(*symbol).map(|v| v.spelling),
+            _ => None,
+        }).collect();
+        assert_eq!(spellings, vec!["<:", "~:", ">."]);
+
+        // Floats compare with J's tolerance; integers exactly
+        let one = JArray::from_data(vec![JValue::Float(1.0)], ArrayShape::scalar());
+        let nearly = JArray::from_data(vec![JValue::Float(1.0 + COMPARISON_TOLERANCE / 2.0)], ArrayShape::scalar());
+        assert_eq!(scalar_dyad::<Equal>(&one, &nearly).unwrap(), JArray::scalar(1));
+        assert_eq!(scalar_dyad::<LessOrEqual>(&nearly, &one).unwrap(), JArray::scalar(1));
+        assert_eq!(scalar_dyad::<Minimum>(&JArray::vector(vec![3, 1]), &JArray::scalar(2)).unwrap().get_data(), vec![2, 1]);
+
+        // Large comparisons produce packed flags
+        let codes = JArray::vector((0..5000).map(|i| (i * 7) % 13).collect());
+        let flags = scalar_dyad::<Equal>(&codes, &JArray::scalar(4)).unwrap();
+        assert_eq!(flags.packed().map(|p| p.width()), Some(1));
+
+        // Sorted input against an atom becomes runs from two binary searches
+        let sorted = JArray::vector((0..100_000).collect());
+        assert!(sorted.packed().unwrap().sorted);
+        let below = scalar_dyad::<LessOrEqual>(&sorted, &JArray::scalar(40_000)).unwrap();
+        assert_eq!(below.runs().unwrap().ends, vec![40_001, 100_000]);
+        let hit = scalar_dyad::<Equal>(&JArray::scalar(7), &sorted).unwrap();
+        assert_eq!(hit.runs().unwrap().values, vec![JValue::Integer(0), JValue::Integer(1), JValue::Integer(0)]);
+        assert_eq!(hit, scalar_dyad::<Equal>(&JArray::scalar(7), &sorted.to_dense()).unwrap());
+    }
+
+    #[test]
+    fn test_copy_verb() {
+        use crate::evaluator::EvaluationError;
+        let copy = crate::verbs::lookup('#').and_then(|v| v.dyad).unwrap();
+        let shape_of = crate::verbs::lookup('$').and_then(|v| v.monad).unwrap();
+
+        // A boolean mask compresses; integers repeat each item
+        assert_eq!(copy(&JArray::vector(vec![1, 0, 1]), &JArray::vector(vec![4, 5, 6])).unwrap().get_data(), vec![4, 6]);
+        assert_eq!(copy(&JArray::vector(vec![2, 0, 1]), &JArray::vector(vec![4, 5, 6])).unwrap().get_data(), vec![4, 4, 6]);
+        assert_eq!(copy(&JArray::scalar(2), &JArray::vector(vec![1, 2])).unwrap().get_data(), vec![1, 1, 2, 2]);
+
+        // Counts select rows of a matrix
+        let matrix = JArray::from_data((1..=6).map(JValue::Integer).collect(), ArrayShape { dimensions: vec![3, 2] });
+        let rows = copy(&JArray::vector(vec![0, 1, 1]), &matrix).unwrap();
+        assert_eq!(shape_of(&rows).unwrap().get_data(), vec![2, 2]);
+        assert_eq!(rows.get_data(), vec![3, 4, 5, 6]);
+
+        assert!(matches!(copy(&JArray::vector(vec![1, 0]), &JArray::vector(vec![4, 5, 6])), Err(EvaluationError::DimensionMismatch(_))));
+        assert!(matches!(copy(&JArray::vector(vec![1, -1, 0]), &JArray::vector(vec![4, 5, 6])), Err(EvaluationError::DomainError(_))));
+
+        // Packed and run-length masks filter packed data without widening it
+        let values = JArray::vector((0..4000).map(|i| i % 100).collect());
+        let mask = JArray::vector((0..4000).map(|i| (i % 3 == 0) as i32).collect());
+        assert!(mask.packed().is_some());
+        let kept = copy(&mask, &values).unwrap();
+        assert_eq!(kept.packed().map(|p| p.width()), Some(1));
+        assert_eq!(kept.element_count(), 1334);
+        assert_eq!(kept.value(1), JValue::Integer(3));
+        let halves = JArray::vector((0..4000).map(|i| (i < 1000) as i32).collect());
+        assert!(halves.runs().is_some());
+        assert_eq!(copy(&halves, &values).unwrap(), JArray::vector((0..1000).map(|i| i % 100).collect()));
+    }
+
+    #[test]
+    fn test_infix_adverb() {
+        use crate::interpreter::JInterpreter;
+        let interpreter = JInterpreter::new();
+        let run = |expression: &str| {
+            interpreter.execute_prepared(&interpreter.prepare(expression).unwrap()).unwrap()
+        };
+
+        assert_eq!(run("+/ ~5"), JArray::scalar(10));
+        assert_eq!(run("3 +/\\ ~6").get_data(), vec![3, 6, 9, 12]);
+        assert_eq!(run("+/\\ ~5").get_data(), vec![0, 1, 3, 6, 10]);
+        assert_eq!(run("0 +/\\ 1 2 3").get_data(), vec![0, 0, 0, 0]);
+        assert_eq!(run("2 +/\\ (3 2 $ ~6)"), JArray::matrix(vec![2, 4, 6, 8], 2, 2));
+        assert_eq!(run("2 <./\\ 3 1 4 1 5 9 2 6").get_data(), vec![1, 1, 1, 1, 5, 2, 2]);
+        assert_eq!(run(">./\\ 3 1 4 1 5").get_data(), vec![3, 3, 4, 4, 5]);
+
+        // Prefixes of an associative verb extend the previous prefix
+        assert_eq!(run("*/\\ 1 2 3 4").get_data(), vec![1, 2, 6, 24]);
+        assert_eq!(run("*/\\ (3 2 $ 1 2 3 4 5 6)"), JArray::matrix(vec![1, 2, 3, 8, 15, 48], 3, 2));
+
+        // Verbs without a sliding kernel are applied window by window
+        assert_eq!(run("2 ,/\\ ~4"), JArray::matrix(vec![0, 1, 1, 2, 2, 3], 3, 2));
+        assert_eq!(format!("{}", run("3 <\\ ~5")), "<0 1 2> <1 2 3> <2 3 4>");
+        let failing = interpreter.prepare("2 ~\\ 1 2").unwrap();
+        assert!(interpreter.execute_prepared(&failing).is_err());
+        assert!(interpreter.prepare("2 {\\ 1 2").is_err()); // { has no monad
+        // Enough windows to go to threads; a failing window is an error, not a panic
+        let threaded = interpreter.prepare("2 {{ (1 2 3) # y }}\\ ~70000").unwrap();
+        assert!(interpreter.execute_prepared(&threaded).unwrap_err().to_string().contains("Length error"));
+        assert_eq!(run("2 {{ +/ y }}\\ ~70000").value(69_998), JValue::Integer(139_997));
+
+        // Sliding kernels agree with reducing every window separately
+        let mut prepared = interpreter.prepare("n <./\\ y").unwrap();
+        let values = JArray::vector((0..5000).map(|i| (i * 7919) % 1009).collect());
+        prepared.bind("y", values.clone()).unwrap();
+        prepared.bind("n", JArray::scalar(37)).unwrap();
+        let minima = interpreter.execute_prepared(&prepared).unwrap();
+        assert_eq!(minima.element_count(), 5000 - 36);
+        for start in [0, 1, 2500, 5000 - 37] {
+            let window = values.take_items(start, 37).get_data();
+            assert_eq!(minima.value(start), JValue::Integer(*window.iter().min().unwrap()));
+        }
+    }
+
+    #[test]
+    fn test_table_adverb() {
+        use crate::interpreter::{JInterpreter, parse_binding_value};
+        let interpreter = JInterpreter::new();
+        let run = |expression: &str| {
+            interpreter.execute_prepared(&interpreter.prepare(expression).unwrap()).unwrap()
+        };
+
+        assert_eq!(run("1 2 3 +/ 10 20"), JArray::matrix(vec![11, 21, 12, 22, 13, 23], 3, 2));
+        assert_eq!(run("(~3) </ ~3"), JArray::matrix(vec![0, 1, 1, 0, 0, 1, 0, 0, 0], 3, 3));
+        assert_eq!(run("(2 3 $ ~6) >./ ~4").shape.dimensions, vec![2, 3, 4]);
+        assert_eq!(run("(1 2) ,/ (3 4)").get_data(), vec![1, 2, 3, 4]); // , has infinite rank
+
+        // Large tables are written at the width their range needs
+        let sums = run("(~300) +/ ~300");
+        assert_eq!(sums.packed().map(|p| p.width()), Some(2));
+        assert_eq!((sums.value(0), sums.value(299 * 300 + 299)), (JValue::Integer(0), JValue::Integer(598)));
+        let flags = run("(~300) =/ ~300");
+        assert_eq!(flags.packed().map(|p| p.width()), Some(1));
+        assert_eq!(sum_of(&flags), 300);
+
+        // Overflowing and float tables
+        let mut prepared = interpreter.prepare("x +/ y").unwrap();
+        prepared.bind("x", parse_binding_value("2000000000 1").unwrap()).unwrap();
+        prepared.bind("y", parse_binding_value("2000000000 0.5").unwrap()).unwrap();
+        let mixed = interpreter.execute_prepared(&prepared).unwrap();
+        assert_eq!(mixed.value(0), JValue::Float(4e9));
+        assert_eq!(mixed.value(3), JValue::Float(1.5));
+    }
+
+    #[test]
+    fn test_rank_conjunction() {
+        use crate::interpreter::{JInterpreter, parse_binding_value};
+        let interpreter = JInterpreter::new();
+        let run = |expression: &str| {
+            interpreter.execute_prepared(&interpreter.prepare(expression).unwrap()).unwrap()
+        };
+
+        // Row-wise forms of built-ins, each a single kernel call
+        assert_eq!(run("+/\"1 (2 3 $ ~6)").get_data(), vec![3, 12]);
+        assert_eq!(run("+/\"2 (2 3 $ ~6)").get_data(), vec![3, 5, 7]);
+        assert_eq!(run(">./\"1 (2 3 $ ~6)").get_data(), vec![2, 5]);
+        assert_eq!(run("#\"1 (2 3 $ ~6)").get_data(), vec![3, 3]);
+        assert_eq!(run(",\"2 (2 3 4 $ ~24)").shape.dimensions, vec![2, 12]);
+        assert_eq!(run("(2 3 $ ~6) +\"1 (10 20 30)"), JArray::matrix(vec![10, 21, 32, 13, 24, 35], 2, 3));
+        assert_eq!(run("(10 20) +\"0 1 (2 3 $ ~6)"), JArray::matrix(vec![10, 11, 12, 23, 24, 25], 2, 3));
+
+        // Anything else runs cell by cell
+        assert_eq!(run("+/\\\"1 (2 3 $ ~6)"), JArray::matrix(vec![0, 1, 3, 3, 7, 12], 2, 3));
+        assert_eq!(run("~\"0 (3)").get_data(), vec![0, 1, 2]);
+        assert_eq!(run("(2 3) $\"1 (~2)").shape.dimensions, vec![2, 3]);
+
+        // 10^6 rows
+        let rows = run("+/\"1 (1000000 3 $ ~6)");
+        assert_eq!(rows.shape.dimensions, vec![1_000_000]);
+        assert_eq!((rows.value(0), rows.value(1)), (JValue::Integer(3), JValue::Integer(12)));
+
+        // The rank operand may be a name; a negative rank counts down
+        let mut prepared = interpreter.prepare("+/\"r m").unwrap();
+        prepared.bind("r", parse_binding_value("-1").unwrap()).unwrap();
+        prepared.bind("m", parse_binding_value("1 2 3").unwrap()).unwrap();
+        assert!(prepared.names().contains(&"r".to_string()));
+        assert_eq!(interpreter.execute_prepared(&prepared).unwrap().get_data(), vec![1, 2, 3]);
+
+        // Frames that do not agree
+        assert!(interpreter.execute_prepared(&interpreter.prepare("(1 2) +\"0 (1 2 3)").unwrap()).is_err());
+    }
+
+    #[test]
+    fn test_power_conjunction() {
+        use crate::interpreter::{JInterpreter, parse_binding_value};
+        let interpreter = JInterpreter::new();
+        let try_run = |expression: &str| interpreter.execute_prepared(&interpreter.prepare(expression).unwrap());
+        let run = |expression: &str| try_run(expression).unwrap();
+
+        assert_eq!(run(">:^:3 (1 2)").get_data(), vec![4, 5]);
+        assert_eq!(run("<:^:0 (1 2)").get_data(), vec![1, 2]);
+        assert_eq!(run("2 +^:(0 1 2) (1 2)"), JArray::matrix(vec![1, 2, 3, 4, 5, 6], 3, 2));
+        assert_eq!(run("1 ,^:2 (2)").get_data(), vec![1, 1, 2]); // no kernel: the general loop
+        assert_eq!(run("<^:2 (1)").to_string(), "<<1>>");
+
+        // Negative powers apply the inverse
+        assert_eq!(run("<:^:_2 (5)").get_data(), vec![7]);
+        assert_eq!(run("<^:_1 (<1 2)").get_data(), vec![1, 2]);
+        assert!(try_run(",^:_1 (1 2)").is_err());
+
+        // Fixed points, tolerantly
+        assert_eq!(run("0 >.^:_ (_3 4 _5)").get_data(), vec![0, 4, 0]);
+        assert_eq!(run("<.^:_ (7)").get_data(), vec![7]);
+        assert!(try_run("1 +^:_ (1)").is_err());
+
+        // Integer overflow carries on in floats from the last exact step
+        let mut prepared = interpreter.prepare("x +^:n y").unwrap();
+        prepared.bind("x", parse_binding_value("2000000000").unwrap()).unwrap();
+        prepared.bind("n", parse_binding_value("2").unwrap()).unwrap();
+        prepared.bind("y", parse_binding_value("1 0.5").unwrap()).unwrap();
+        let sums = interpreter.execute_prepared(&prepared).unwrap();
+        assert_eq!((sums.value(0), sums.value(1)), (JValue::Float(4000000001.0), JValue::Float(4000000000.5)));
+
+        // Thousands of iterations over a large array
+        let stepped = run(">:^:5000 (~100000)");
+        assert_eq!((stepped.value(0), stepped.value(99_999)), (JValue::Integer(5000), JValue::Integer(104_999)));
+    }
+
+    #[test]
+    fn test_explicit_definition() {
+        use crate::interpreter::JInterpreter;
+        let interpreter = JInterpreter::new();
+        let try_run = |expression: &str| interpreter.prepare(expression).and_then(|p| interpreter.execute_prepared(&p));
+        let run = |expression: &str| try_run(expression).unwrap();
+
+        assert_eq!(run("{{ y + 1 }} (1 2 3)").get_data(), vec![2, 3, 4]);
+        assert_eq!(run("3 {{ x + y }} (4)").get_data(), vec![7]);
+        assert_eq!(run("{{ s =. 0\nfor_i. y do. s =. s + i end.\ns }} (1 2 3 4)").get_data(), vec![10]);
+        assert_eq!(run("{{ if. y > 2 do. 1 elseif. y > 0 do. 2 else. 3 end. }} (1)").get_data(), vec![2]);
+        assert_eq!(run("{{ n =. y while. n > 1 do. n =. <: n end. n }} (5)").get_data(), vec![1]);
+        assert_eq!(run("{{ r =. 0 for_i. y do. if. i = 3 do. break. end. r =. r + i end. r }} (1 2 3 4)").get_data(), vec![3]);
+        assert_eq!(run("{{ for_r. y do. r end. }} (2 3 $ 1 2 3 4 5 6)").get_data(), vec![4, 5, 6]);
+        assert_eq!(run("{{ r =. 0 for_i. y do. r =. r + i_index end. }} (7 8 9)").get_data(), vec![3]);
+        assert_eq!(run("{{ if. 1 do. 5 return. end. 6 }} (0)").get_data(), vec![5]);
+
+        // Names are resolved when the definition is compiled
+        assert!(try_run("{{ z + 1 }} (1)").is_err());
+        assert!(try_run("{{ if. y do. 1 }} (1)").is_err());
+        assert!(try_run("{{ break. }} (1)").is_err());
+
+        // A loop over many items reuses the item buffer
+        assert_eq!(run("{{ s =. 0 for_r. y do. s =. s + +/ r end. }} (1000 3 $ 1)").get_data(), vec![3000]);
+    }
+
+    #[test]
+    fn test_workspace_recomputes_downstream() {
+        use crate::workspace::Workspace;
+        let mut workspace = Workspace::new();
+        workspace.set("a", JArray::vector(vec![1, 2])).unwrap();
+        workspace.set("b", JArray::vector(vec![10, 20])).unwrap();
+        assert_eq!(workspace.define("c", "a + b").unwrap(), vec!["c"]);
+        workspace.define("d", "+/ c").unwrap();
+        workspace.define("e", "b + b").unwrap();
+        workspace.define("f", "0 <. a").unwrap();
+        workspace.define("g", "f + d").unwrap();
+        assert_eq!(workspace.get("g").unwrap().get_data(), vec![33, 33]);
+
+        // Only what reads a changes; f comes out the same, so g is recomputed
+        // because of d alone
+        let changed = workspace.set("a", JArray::vector(vec![3, 4])).unwrap();
+        assert_eq!(changed, vec!["a", "c", "d", "g"]);
+        assert_eq!(workspace.get("g").unwrap().get_data(), vec![37, 37]);
+        assert_eq!(workspace.set("a", JArray::vector(vec![3, 4])).unwrap(), Vec::<String>::new());
+
+        // Redefining replaces the old edges
+        workspace.define("c", "b").unwrap();
+        assert!(workspace.set("a", JArray::vector(vec![5, 6])).unwrap().iter().all(|n| n != "c"));
+
+        assert!(workspace.define("b", "d").is_err()); // cycle
+        assert!(workspace.define("h", "z + 1").is_err()); // undefined name
+
+        // Names settled in one wave come back in name order
+        for name in ["w3", "w1", "w2"] {
+            workspace.define(name, "a + 1").unwrap();
+        }
+        assert_eq!(workspace.set("a", JArray::vector(vec![7, 8])).unwrap(), ["a", "w1", "w2", "w3"]);
+
+        // An update that fails part way leaves every value as it was
+        workspace.define("v", "a + 1 2").unwrap();
+        let before: Vec<_> = ["a", "w1", "v", "g"].iter().map(|n| workspace.get(n).cloned()).collect();
+        assert!(workspace.set("a", JArray::vector(vec![1, 2, 3])).is_err());
+        assert!(workspace.define("a", "1 2 3").is_err());
+        let after: Vec<_> = ["a", "w1", "v", "g"].iter().map(|n| workspace.get(n).cloned()).collect();
+        assert_eq!(before, after);
+        assert_eq!(workspace.set("a", JArray::vector(vec![0, 0])).unwrap(), ["a", "v", "w1", "w2", "w3"]);
+    }
+
+    #[test]
+    fn test_workspace_sessions() {
+        use crate::workspace::{Source, WorkspaceStore, MAX_NAMES};
+        let value = |text: &str| Source::Value(text.to_string());
+        let expression = |text: &str| Source::Expression(text.to_string());
+
+        // Sessions do not see each other's names
+        let store = WorkspaceStore::new(None);
+        store.update("one", "a", value("1 2")).unwrap();
+        assert!(store.update("two", "b", expression("a + 1")).is_err());
+        assert!(store.update("../x", "a", value("1")).is_err());
+        for i in 1..MAX_NAMES {
+            store.update("one", &format!("n{}", i), value("1")).unwrap();
+        }
+        assert!(store.update("one", "full", value("1")).is_err());
+
+        // Threads update their own sessions through one shared store
+        std::thread::scope(|scope| {
+            for t in 0..4 {
+                let store = &store;
+                scope.spawn(move || {
+                    let session = format!("thread{}", t);
+                    store.update(&session, "x", value(&t.to_string())).unwrap();
+                    let changed = store.update(&session, "y", expression("x + 1")).unwrap();
+                    assert_eq!(changed[0].1, JArray::scalar(t + 1));
+                });
+            }
+        });
+
+        // Two stores on one directory, as two workers: each picks up the
+        // other's updates from the session file
+        let directory = std::env::temp_dir().join(format!("j_workspace_test_{}", std::process::id()));
+        std::fs::create_dir_all(&directory).unwrap();
+        let first = WorkspaceStore::new(Some(directory.clone()));
+        let second = WorkspaceStore::new(Some(directory.clone()));
+        first.update("s", "a", value("1 2")).unwrap();
+        first.update("s", "b", expression("a + 10")).unwrap();
+        let changed = second.update("s", "c", expression("b + a")).unwrap();
+        assert_eq!(changed, vec![("c".to_string(), JArray::vector(vec![12, 14]))]);
+        let changed = first.update("s", "a", value("0 0")).unwrap();
+        assert_eq!(changed.iter().map(|(name, _)| name.as_str()).collect::<Vec<_>>(), ["a", "b", "c"]);
+        assert_eq!(changed[2].1, JArray::vector(vec![10, 10]));
+        assert!(second.update("s", "b", expression("a + 1 2 3")).is_err());
+        let changed = second.update("s", "d", expression("c")).unwrap();
+        assert_eq!(changed[0].1, JArray::vector(vec![10, 10]));
+        std::fs::remove_dir_all(&directory).unwrap();
+    }
+
+    #[test]
+    fn test_common_subexpressions_are_shared() {
+        use crate::custom_parser::CustomParser;
+        use crate::interpreter::JInterpreter;
+        use crate::tokenizer::JTokenizer;
+        let analyze = |expression: &str| {
+            let tokens = JTokenizer::new().tokenize(expression).unwrap();
+            JSemanticAnalyzer::new().analyze(CustomParser::new().parse(tokens).unwrap()).unwrap()
+        };
+        let common_count = |node: &JNode| match node {
+            JNode::Shared(common, _) => common.len(),
+            _ => 0,
+        };
+
+        assert_eq!(common_count(&analyze("(~1000) , (~1000)")), 1);
+        assert_eq!(common_count(&analyze("(~1000) , (~100)")), 0);
+        // The inner ~3 is only evaluated inside the shared +/ ~3
+        assert_eq!(common_count(&analyze("(+/ ~3) , (+/ ~3)")), 1);
+        // Nouns of conjunctions take part too; ~2 is also the left argument
+        assert_eq!(common_count(&analyze("(~2) +^:(+/ ~2) (+/ ~2)")), 2);
+        // Arguments of a commutative dyad match in either order
+        assert_eq!(common_count(&analyze("(x + y) , (y + x)")), 1);
+        assert_eq!(common_count(&analyze("(x , y) , (y , x)")), 0);
+
+        let interpreter = JInterpreter::new();
+        let run = |expression: &str| interpreter.execute_prepared(&interpreter.prepare(expression).unwrap()).unwrap();
+        assert_eq!(run("(+/ ~4) + (+/ ~4) , (+/ ~4)").get_data(), vec![12, 12]);
+        assert_eq!(run("(~2) +^:(+/ ~2) (+/ ~2)").get_data(), vec![1, 2]);
+        let mut prepared = interpreter.prepare("(x , x) , (x , x)").unwrap();
+        prepared.bind("x", JArray::vector(vec![7])).unwrap();
+        assert_eq!(interpreter.execute_prepared(&prepared).unwrap().get_data(), vec![7, 7, 7, 7]);
+    }
+
+    #[test]
+    fn test_small_cell_kernels() {
+        use crate::interpreter::{JInterpreter, parse_binding_value};
+        let interpreter = JInterpreter::new();
+        let run = |expression: &str| interpreter.execute_prepared(&interpreter.prepare(expression).unwrap()).unwrap();
+
+        // Batches large enough to be packed, and small ones that stay dense
+        let rows = run("+/\"1 (100000 3 $ ~300000)");
+        assert_eq!(rows.shape.dimensions, vec![100000]);
+        assert_eq!((rows.value(0), rows.value(99_999)), (JValue::Integer(3), JValue::Integer(899_994)));
+        assert_eq!(run("+/\"1 (2 4 $ ~8)").get_data(), vec![6, 22]);
+        assert_eq!(run("+/\"2 (2 2 2 $ ~8)"), JArray::matrix(vec![2, 4, 10, 12], 2, 2));
+        assert_eq!(run("+/\"2 (1 3 3 $ ~9)"), JArray::matrix(vec![9, 12, 15], 1, 3));
+
+        let moved = run("(100000 3 $ ~300000) +\"1 (10 20 30)");
+        assert_eq!((moved.value(3), moved.value(4), moved.value(5)), (JValue::Integer(13), JValue::Integer(24), JValue::Integer(35)));
+        assert_eq!(run("(1 2) <\"1 (3 2 $ ~6)"), JArray::matrix(vec![0, 0, 1, 1, 1, 1], 3, 2));
+        assert_eq!(run("(4 4 $ ~16) >.\"2 (4 4 $ 9)").get_data()[..10], [9, 9, 9, 9, 9, 9, 9, 9, 9, 9]);
+
+        // Overflow still promotes to floats, and float batches take the same path
+        let promoted = run("(2 3 $ 2000000000) +\"1 (2000000000 1 1)");
+        assert_eq!((promoted.value(0), promoted.value(1)), (JValue::Float(4e9), JValue::Float(2000000001.0)));
+        let mut prepared = interpreter.prepare("(x +\"1 y) , +/\"1 x").unwrap();
+        prepared.bind("x", parse_binding_value("2 2$0.5 1 2 3").unwrap()).unwrap();
+        prepared.bind("y", parse_binding_value("1 2").unwrap()).unwrap();
+        let floats = interpreter.execute_prepared(&prepared).unwrap();
+        assert_eq!(floats.value(0), JValue::Float(1.5));
+        assert_eq!((floats.value(4), floats.value(5)), (JValue::Float(1.5), JValue::Float(5.0)));
+    }
+
+    #[test]
+    fn test_reproducible_float_sums() {
+        use crate::interpreter::JInterpreter;
+        use crate::verbs::{sum_floats, with_reduction, Reduction, REDUCTION_BLOCK};
+
+        // Magnitudes far apart, so the grouping of the additions shows in the bits
+        let values: Vec<f64> = (0..200_003).map(|i| if i % 7 == 0 { 1e12 / (i + 1) as f64 } else { 0.1 * i as f64 }).collect();
+        let reproducible = sum_floats(&values, |&v| v, Reduction::Reproducible, 1);
+        for threads in [2, 3, 8, 64] {
+            assert_eq!(sum_floats(&values, |&v| v, Reduction::Reproducible, threads).to_bits(), reproducible.to_bits());
+        }
+        let fast = sum_floats(&values, |&v| v, Reduction::Fast, 3);
+        assert!((fast - reproducible).abs() <= 1e-9 * reproducible.abs());
+        // One block is a plain left-to-right sum
+        let short = &values[..REDUCTION_BLOCK];
+        assert_eq!(sum_floats(short, |&v| v, Reduction::Reproducible, 4), short.iter().fold(0.0, |t, v| t + v));
+
+        // The mode applies to +/ for the evaluation it wraps, whatever the layout
+        let interpreter = JInterpreter::new();
+        let mut prepared = interpreter.prepare("+/ x").unwrap();
+        let floats = JArray::from_data(values.iter().map(|&v| JValue::Float(v)).collect(), ArrayShape::vector(values.len()));
+        prepared.bind("x", floats).unwrap();
+        let total = with_reduction(Reduction::Reproducible, || interpreter.execute_prepared(&prepared).unwrap());
+        assert_eq!(total, JArray::from_data(vec![JValue::Float(reproducible)], ArrayShape::scalar()));
+        let mut repeated = interpreter.prepare("+/ (200003 $ x)").unwrap();
+        repeated.bind("x", JArray::from_data(values[..7].iter().map(|&v| JValue::Float(v)).collect(), ArrayShape::vector(7))).unwrap();
+        let cycled: Vec<f64> = (0..values.len()).map(|i| values[i % 7]).collect();
+        let total = with_reduction(Reduction::Reproducible, || interpreter.execute_prepared(&repeated).unwrap());
+        assert_eq!(total.value(0), JValue::Float(sum_floats(&cycled, |&v| v, Reduction::Reproducible, 1)));
+        assert_eq!(crate::verbs::reduction(), Reduction::Fast);
+    }
+
+    #[test]
+    fn test_roll_and_deal() {
+        use crate::interpreter::JInterpreter;
+        use crate::random::{fill, with_seed};
+        let interpreter = JInterpreter::new();
+        let run = |expression: &str| interpreter.execute_prepared(&interpreter.prepare(expression).unwrap()).unwrap();
+
+        // Bulk rolls land in range, in the narrowest packed storage
+        let dice = run("? (1000000 $ 6)");
+        assert_eq!(dice.shape.dimensions, vec![1_000_000]);
+        assert_eq!(dice.packed().map(|packed| packed.width()), Some(1));
+        let mut counts = [0usize; 6];
+        for i in 0..dice.element_count() {
+            counts[dice.value(i).to_integer().unwrap() as usize] += 1;
+        }
+        assert!(counts.iter().all(|&count| count.abs_diff(1_000_000 / 6) < 2_000));
+        let floats = run("? (1000 $ 0)");
+        assert!((0..1000).all(|i| matches!(floats.value(i), JValue::Float(f) if f > 0.0 && f < 1.0)));
+        let mixed = run("? 3 0 5");
+        assert!(matches!(mixed.value(1), JValue::Float(f) if f > 0.0 && f < 1.0));
+
+        // A seed repeats the draws, and two identical rolls are drawn
+        // separately rather than shared
+        let seeded = || with_seed(42, || run("(? (1000 $ 100)) , ? (1000 $ 100)"));
+        let first = seeded();
+        assert_eq!(seeded(), first);
+        assert_ne!(first.take_items(0, 1000), first.take_items(1000, 1000));
+        assert_eq!(run("?. (10 $ 1000)"), run("?. (10 $ 1000)"));
+
+        // Splitting a fill across threads does not change its draws, so a
+        // seeded bulk roll matches the same stream drawn in short pieces
+        let drawn = |threads: usize| {
+            let mut values = vec![0u64; 300_001];
+            fill(&mut values, 42, 7, threads, |bits| bits);
+            values
+        };
+        let sequential = drawn(1);
+        for threads in [2, 3, 8] {
+            assert_eq!(drawn(threads), sequential);
+        }
+        let whole = with_seed(42, || run("? (300000 $ 100)"));
+        let pieces = with_seed(42, || {
+            let (a, b, c) = (run("? (100000 $ 100)"), run("? (100000 $ 100)"), run("? (100000 $ 100)"));
+            a.concatenate(&b).unwrap().concatenate(&c).unwrap()
+        });
+        assert_eq!(whole, pieces);
+
+        // Deal: distinct values from the range, dense or sparse
+        for expression in ["5 ? 8", "1000 ? 1000000000"] {
+            let dealt = run(expression);
+            let mut values: Vec<i32> = dealt.get_data();
+            let range = if expression.starts_with('5') { 8 } else { 1_000_000_000 };
+            assert!(values.iter().all(|&v| (0..range).contains(&v)));
+            values.sort();
+            values.dedup();
+            assert_eq!(values.len(), dealt.element_count());
+        }
+        assert!(interpreter.prepare("9 ? 8").and_then(|p| interpreter.execute_prepared(&p)).is_err());
+    }
+
+    #[test]
+    fn test_bincount_and_histogram() {
+        use crate::interpreter::{JInterpreter, parse_binding_value};
+        let interpreter = JInterpreter::new();
+        let run = |expression: &str| interpreter.execute_prepared(&interpreter.prepare(expression).unwrap()).unwrap();
+
+        assert_eq!(run("#:: 1 3 1 0 1").get_data(), vec![1, 3, 0, 1]);
+        assert_eq!(run("4 #:: 1 3 1 7 1").get_data(), vec![0, 3, 0, 1]);
+
+        // Packed keys long enough to be counted on several threads
+        let keys = run("? (300000 $ 10)");
+        let counts = crate::histogram::bincount(&keys).unwrap();
+        let mut expected = vec![0; 10];
+        for i in 0..keys.element_count() {
+            expected[keys.value(i).to_integer().unwrap() as usize] += 1;
+        }
+        assert_eq!(counts.get_data(), expected);
+        assert_eq!(run("#:: (200000 $ 3 100000)").get_data()[..4], [0, 0, 0, 100000]);
+
+        // A few keys over a wide range give a sparse result
+        let sparse = run("#:: 5 1000000000 5");
+        assert!(sparse.sparse().is_some());
+        assert_eq!(sparse.element_count(), 1_000_000_001);
+        assert_eq!((sparse.value(5), sparse.value(1_000_000_000), sparse.value(6)), (JValue::Integer(2), JValue::Integer(1), JValue::Integer(0)));
+
+        // Edges: values outside are dropped, the last edge is inclusive
+        let mut prepared = interpreter.prepare("e #:: v").unwrap();
+        prepared.bind("e", parse_binding_value("0 0.5 1 2").unwrap()).unwrap();
+        prepared.bind("v", parse_binding_value("0.25 0.5 0.75 1 2 3 0.1").unwrap()).unwrap();
+        assert_eq!(interpreter.execute_prepared(&prepared).unwrap().get_data(), vec![2, 2, 2]);
+
+        // A bin count far above the number of keys counts sparsely; the
+        // keys past it are not counted
+        let wide = run("1000000000 #:: 1 2 3 2000000000");
+        assert!(wide.sparse().is_some());
+        assert_eq!((wide.element_count(), wide.value(2), wide.value(4)), (1_000_000_000, JValue::Integer(1), JValue::Integer(0)));
+        assert!(wide.to_string().ends_with("0 0 ... (1000000000 elements)"));
+
+        // #. and #: are left for J's base and antibase
+        assert!(interpreter.prepare("#. 1 2").is_err());
+
+        for failing in ["#:: 1 _1", "2 1 #:: 1 2"] {
+            assert!(interpreter.prepare(failing).and_then(|p| interpreter.execute_prepared(&p)).is_err(), "{}", failing);
+        }
+    }
+
+    #[test]
+    fn test_complex_arrays() {
+        use crate::interpreter::{JInterpreter, parse_binding_value};
+        let interpreter = JInterpreter::new();
+        let run = |expression: &str| interpreter.execute_prepared(&interpreter.prepare(expression).unwrap()).unwrap();
+        let parts = |array: &JArray| {
+            let parts = array.complex().expect("complex layout");
+            parts.re.iter().copied().zip(parts.im.iter().copied()).collect::<Vec<_>>()
+        };
+
+        // Literals are stored as separate real and imaginary buffers
+        let literal = run("1j2 3j_4");
+        assert_eq!(parts(&literal), vec![(1.0, 2.0), (3.0, -4.0)]);
+        assert!(literal.data.is_empty());
+        assert_eq!(literal.to_string(), "1j2 3j-4");
+
+        assert_eq!(parts(&run("1j2 * 3j4")), vec![(-5.0, 10.0)]);
+        assert_eq!(parts(&run("1j2 + 1 2")), vec![(2.0, 2.0), (3.0, 2.0)]);
+        assert_eq!(parts(&run("1j1 2j2 - (2 3 $ 1)")), vec![(0.0, 1.0); 3].into_iter().chain(vec![(1.0, 2.0); 3]).collect::<Vec<_>>());
+        assert_eq!(parts(&run("- 1j2 5")), vec![(-1.0, -2.0), (-5.0, 0.0)]);
+        assert_eq!(parts(&run("+ 1j2")), vec![(1.0, -2.0)]);
+        assert_eq!(parts(&run("* 3j4 0")), vec![(0.6, 0.8), (0.0, 0.0)]);
+        assert_eq!(parts(&run("+/ 1j2 3j_4 0")), vec![(4.0, -2.0)]);
+        assert_eq!(run("1j2 = 1j2 1 2").get_data(), vec![1, 0, 0]);
+        assert_eq!(parts(&run("*/ 1j2 3j4")), vec![(-5.0, 10.0)]);
+        assert_eq!(parts(&run("*/ (2 2 $ 1j1 2 3 0j1)")), vec![(3.0, 3.0), (0.0, 2.0)]);
+
+        // Structural verbs keep the complex layout
+        assert_eq!(parts(&run("5 $ 1j2 3")), vec![(1.0, 2.0), (3.0, 0.0), (1.0, 2.0), (3.0, 0.0), (1.0, 2.0)]);
+        assert_eq!(parts(&run("1j2 , 3 4")), vec![(1.0, 2.0), (3.0, 0.0), (4.0, 0.0)]);
+        assert_eq!(parts(&run("(2 2 $ 1j1) , 5")), vec![(1.0, 1.0), (1.0, 1.0), (1.0, 1.0), (1.0, 1.0), (5.0, 0.0), (5.0, 0.0)]);
+        assert_eq!(parts(&run("1 0 2 # 1j2 3j4 5j6")), vec![(1.0, 2.0), (5.0, 6.0), (5.0, 6.0)]);
+        assert_eq!(parts(&run("2 0 { 1j2 3j4 5j6")), vec![(5.0, 6.0), (1.0, 2.0)]);
+        assert_eq!(run("2 2 $ 1j2 3").to_string(), "1j2 3j0\n  1j2 3j0");
+        // A complex atom lives out of line, so the other values stay small
+        assert_eq!(std::mem::size_of::<JValue>(), 16);
+
+        // Float arguments are promoted too
+        let mut prepared = interpreter.prepare("x * y").unwrap();
+        prepared.bind("x", parse_binding_value("0.5 2").unwrap()).unwrap();
+        prepared.bind("y", parse_binding_value("2j_1").unwrap()).unwrap();
+        assert_eq!(parts(&interpreter.execute_prepared(&prepared).unwrap()), vec![(1.0, -0.5), (4.0, -2.0)]);
+
+        // Reals keep their own kernels
+        assert_eq!(run("3 - 5 * 2").get_data(), vec![-4]);
+        assert_eq!(run("*/ 1 2 3 4").get_data(), vec![24]);
+
+        for failing in ["1j2 < 3", "1j2 >. 3"] {
+            assert!(interpreter.prepare(failing).and_then(|p| interpreter.execute_prepared(&p)).is_err(), "{}", failing);
+        }
+    }
+
+    #[test]
+    fn test_c_abi() {
+        use crate::ffi::*;
+        use std::ffi::{CStr, CString};
+        use std::ptr;
+
+        unsafe {
+            let handle = j_interpreter_new();
+            let last_error = || CStr::from_ptr(j_last_error(handle)).to_string_lossy().into_owned();
+
+            // Compile, bind a caller-owned buffer, execute and read the result
+            let mut compiled = ptr::null_mut();
+            let expression = CString::new("x + 10").unwrap();
+            assert_eq!(j_compile(handle, expression.as_ptr(), &mut compiled), J_OK);
+            let (name, values, shape) = (CString::new("x").unwrap(), [1i32, 2, 3, 4, 5, 6], [2usize, 3]);
+            assert_eq!(j_bind(handle, compiled, name.as_ptr(), J_TYPE_INT32, values.as_ptr().cast(), 2, shape.as_ptr()), J_OK);
+            let mut result = ptr::null_mut();
+            assert_eq!(j_execute(handle, compiled, &mut result), J_OK);
+            assert_eq!((j_result_type(result), j_result_rank(result), j_result_count(result)), (J_TYPE_INT32, 2, 6));
+            assert_eq!(std::slice::from_raw_parts(j_result_shape(result), 2), &[2, 3]);
+            assert_eq!(std::slice::from_raw_parts(j_result_data(result) as *const i32, 6), &[11, 12, 13, 14, 15, 16]);
+            j_result_free(result);
+
+            // Rebinding to floats gives a float result from the same compiled expression
+            let floats = [0.5f64, 1.5];
+            assert_eq!(j_bind(handle, compiled, name.as_ptr(), J_TYPE_FLOAT64, floats.as_ptr().cast(), 1, [2usize].as_ptr()), J_OK);
+            let mut result = ptr::null_mut();
+            assert_eq!(j_execute(handle, compiled, &mut result), J_OK);
+            assert_eq!(j_result_type(result), J_TYPE_FLOAT64);
+            assert_eq!(std::slice::from_raw_parts(j_result_data(result) as *const f64, 2), &[10.5, 11.5]);
+            j_result_free(result);
+
+            // Failures return a status and leave a message on the handle
+            let unknown = CString::new("y").unwrap();
+            assert_eq!(j_bind(handle, compiled, unknown.as_ptr(), J_TYPE_INT32, values.as_ptr().cast(), 0, ptr::null()), J_ERR_ARGUMENT);
+            assert!(last_error().contains("'y'"));
+            j_compiled_free(compiled);
+
+            let mut compiled = ptr::null_mut();
+            let mismatched = CString::new("1 2 + 1 2 3").unwrap();
+            assert_eq!(j_compile(handle, mismatched.as_ptr(), &mut compiled), J_OK);
+            let mut result = ptr::null_mut();
+            assert_eq!(j_execute(handle, compiled, &mut result), J_ERR_EVALUATION);
+            assert!(result.is_null() && !last_error().is_empty());
+            j_compiled_free(compiled);
+
+            let mut compiled = ptr::null_mut();
+            let bad = CString::new("1 @ 2").unwrap();
+            assert_ne!(j_compile(handle, bad.as_ptr(), &mut compiled), J_OK);
+            assert!(compiled.is_null() && !last_error().is_empty());
+            assert_eq!(j_compile(ptr::null_mut(), bad.as_ptr(), &mut compiled), J_ERR_ARGUMENT);
+
+            // Packed results are handed out at their own width; a result that
+            // is the caller's buffer itself comes back as a copy
+            let mut compiled = ptr::null_mut();
+            let doubled = CString::new("x * 2").unwrap();
+            assert_eq!(j_compile(handle, doubled.as_ptr(), &mut compiled), J_OK);
+            let large: Vec<i32> = (0..2000).collect();
+            assert_eq!(j_bind(handle, compiled, name.as_ptr(), J_TYPE_INT32, large.as_ptr().cast(), 1, [2000usize].as_ptr()), J_OK);
+            let mut result = ptr::null_mut();
+            assert_eq!(j_execute(handle, compiled, &mut result), J_OK);
+            assert_eq!((j_result_type(result), j_result_count(result)), (J_TYPE_INT16, 2000));
+            assert_eq!(*(j_result_data(result) as *const i16).add(1999), 3998);
+            j_result_free(result);
+            j_compiled_free(compiled);
+
+            let mut compiled = ptr::null_mut();
+            assert_eq!(j_compile(handle, name.as_ptr(), &mut compiled), J_OK);
+            assert_eq!(j_bind(handle, compiled, name.as_ptr(), J_TYPE_INT32, large.as_ptr().cast(), 1, [2000usize].as_ptr()), J_OK);
+            let mut result = ptr::null_mut();
+            assert_eq!(j_execute(handle, compiled, &mut result), J_OK);
+            assert_eq!(j_result_type(result), J_TYPE_INT32);
+            assert_ne!(j_result_data(result), large.as_ptr().cast());
+            assert_eq!(std::slice::from_raw_parts(j_result_data(result) as *const i32, 2000), &large[..]);
+            j_result_free(result);
+
+            // Shapes whose element count overflows or passes the limit are refused
+            let huge = [usize::MAX, 2];
+            assert_eq!(j_bind(handle, compiled, name.as_ptr(), J_TYPE_INT32, large.as_ptr().cast(), 2, huge.as_ptr()), J_ERR_ARGUMENT);
+            assert!(last_error().contains("Limit error"));
+            let wide = [crate::j_array::max_elements() + 1];
+            assert_eq!(j_bind(handle, compiled, name.as_ptr(), J_TYPE_INT32, large.as_ptr().cast(), 1, wide.as_ptr()), J_ERR_ARGUMENT);
+            j_compiled_free(compiled);
+
+            // A panic stops at the boundary as a status code
+            assert_eq!(guarded(handle, || panic!("boom")), J_ERR_INTERNAL);
+            assert!(last_error().contains("boom"));
+
+            j_interpreter_free(handle);
+        }
+    }
+
+    fn sum_of(array: &JArray) -> i32 {
+        (0..array.element_count()).filter_map(|i| array.value(i).to_integer()).sum()
+    }
+
+    fn scalar_dyad_plus(left: &JArray, right: &JArray) -> JArray {
+        crate::verbs::scalar_dyad::<crate::verbs::Plus>(left, right).unwrap()
+    }
+
+    // Name Binding Tests
+    #[test]
+    fn test_name_binding() {
+        use crate::evaluator::{Bindings, EvaluationError};
+        let evaluator = JEvaluator::new();
+
+        // x + ~3
+        let x = JNode::Name("x".to_string());
+        let iota_three = JNode::MonadicVerb('~', Box::new(JNode::Literal(JArray::scalar(3))));
+        let expr = JNode::DyadicVerb('+', Box::new(x), Box::new(iota_three));
+
+        let mut bindings = Bindings::new();
+        bindings.insert("x".to_string(), JArray::scalar(10));
+        let result = evaluator.evaluate_with(&expr, &bindings).unwrap();
+        assert_eq!(result.get_data(), vec![10, 11, 12]);
+
+        match evaluator.evaluate(&expr) {
+            Err(EvaluationError::UnboundName(name)) => assert_eq!(name, "x"),
+            other => panic!("Expected UnboundName error, got {:?}", other),
+        }
+    }
+
+    #[test]
+    fn test_prepared_expression() {
+        use crate::interpreter::{JInterpreter, parse_binding_value};
+        let interpreter = JInterpreter::new();
+
+        let mut prepared = interpreter.prepare("x + ~y").unwrap();
+        assert_eq!(prepared.names(), &["x".to_string(), "y".to_string()]);
+        assert!(interpreter.execute_prepared(&prepared).is_err()); // nothing bound yet
+        assert!(prepared.bind("z", JArray::scalar(1)).is_err());
+
+        // Same compiled expression, different data per call
+        prepared.bind("y", parse_binding_value("3").unwrap()).unwrap();
+        for (x, expected) in [(10, vec![10, 11, 12]), (100, vec![100, 101, 102])] {
+            prepared.bind("x", JArray::scalar(x)).unwrap();
+            assert_eq!(interpreter.execute_prepared(&prepared).unwrap().get_data(), expected);
+        }
+
+        let matrix = parse_binding_value("2 3$1 2 3 4 5 6").unwrap();
+        assert_eq!(matrix.shape.dimensions, vec![2, 3]);
+        assert!(parse_binding_value("2 2$1 2 3").is_err());
+    }
+
+    // Unix Socket Protocol Tests
+    #[cfg(unix)]
+    fn unix_request(mode: u8, expression: &str) -> Vec<u8> {
+        unix_request_with(mode, 0, None, expression)
+    }
+
+    #[cfg(unix)]
+    fn unix_request_with(mode: u8, options: u8, seed: Option<u64>, expression: &str) -> Vec<u8> {
+        let seed = seed.map(u64::to_le_bytes);
+        let body_len = 2 + seed.map_or(0, |seed| seed.len()) + expression.len();
+        let mut frame = (body_len as u32).to_be_bytes().to_vec();
+        frame.extend_from_slice(&[mode, options]);
+        frame.extend_from_slice(seed.as_ref().map_or(&[][..], |seed| &seed[..]));
+        frame.extend_from_slice(expression.as_bytes());
+        frame
+    }
+
+    #[cfg(unix)]
+    fn unix_read_response(stream: &mut std::os::unix::net::UnixStream) -> (u8, Vec<u8>) {
+        use std::io::Read;
+        let mut len = [0u8; 4];
+        stream.read_exact(&mut len).unwrap();
+        let mut body = vec![0u8; u32::from_be_bytes(len) as usize];
+        stream.read_exact(&mut body).unwrap();
+        (body[0], body[1..].to_vec())
+    }
+
+    #[cfg(unix)]
+    #[test]
+    fn test_unix_socket_pipelined_requests() {
+        use crate::unix_server::{self, MODE_TEXT, MODE_BINARY, STATUS_TEXT, STATUS_BINARY, STATUS_ERROR};
+        use std::io::Write;
+        use std::os::unix::net::UnixStream;
+
+        let (mut client, server) = UnixStream::pair().unwrap();
+        let handle = std::thread::spawn(move || unix_server::serve_connection(server));
+
+        // Three requests written back to back before reading any response
+        let mut batch = unix_request(MODE_TEXT, "2 3$~6");
+        batch.extend(unix_request(MODE_BINARY, "1+~3"));
+        batch.extend(unix_request(MODE_TEXT, "1+"));
+        client.write_all(&batch).unwrap();
+
+        let (status, payload) = unix_read_response(&mut client);
+        assert_eq!(status, STATUS_TEXT);
+        assert_eq!(String::from_utf8(payload).unwrap(), format!("{}", JArray::matrix(vec![0, 1, 2, 3, 4, 5], 2, 3)));
+
+        let (status, payload) = unix_read_response(&mut client);
+        assert_eq!(status, STATUS_BINARY);
+        let mut expected = vec![unix_server::TYPE_INTEGER];
+        expected.extend_from_slice(&1u32.to_le_bytes());
+        expected.extend_from_slice(&3u64.to_le_bytes());
+        for v in [1i64, 2, 3] {
+            expected.extend_from_slice(&v.to_le_bytes());
+        }
+        assert_eq!(payload, expected);
+
+        let (status, _) = unix_read_response(&mut client);
+        assert_eq!(status, STATUS_ERROR);
+
+        drop(client);
+        handle.join().unwrap().unwrap();
+    }
+
+    #[cfg(unix)]
+    #[test]
+    fn test_unix_socket_options_and_partial_frames() {
+        use crate::unix_server::{self, MODE_TEXT, OPTION_SEED, OPTION_REPRODUCIBLE, STATUS_TEXT, STATUS_ERROR};
+        use std::io::Write;
+        use std::os::unix::net::UnixStream;
+
+        let (mut client, server) = UnixStream::pair().unwrap();
+        client.set_read_timeout(Some(std::time::Duration::from_secs(10))).unwrap();
+        let handle = std::thread::spawn(move || unix_server::serve_connection(server));
+
+        // A reply is flushed even while the start of the next request sits
+        // in the server's buffer
+        let seeded = unix_request_with(MODE_TEXT, OPTION_SEED | OPTION_REPRODUCIBLE, Some(42), "5 ? 100");
+        let mut batch = seeded.clone();
+        batch.extend_from_slice(&seeded[..3]);
+        client.write_all(&batch).unwrap();
+        let (status, first) = unix_read_response(&mut client);
+        assert_eq!(status, STATUS_TEXT);
+
+        // The same seed draws the same values
+        client.write_all(&seeded[3..]).unwrap();
+        assert_eq!(unix_read_response(&mut client), (STATUS_TEXT, first));
+
+        client.write_all(&unix_request_with(MODE_TEXT, OPTION_SEED, None, "1")).unwrap();
+        assert_eq!(unix_read_response(&mut client).0, STATUS_ERROR);
+        client.write_all(&unix_request_with(MODE_TEXT, 0x80, None, "1")).unwrap();
+        assert_eq!(unix_read_response(&mut client).0, STATUS_ERROR);
+
+        drop(client);
+        handle.join().unwrap().unwrap();
+    }
+
+    // Supervisor Tests
+    #[cfg(unix)]
+    #[test]
+    fn test_reuseport_listeners_and_shared_metrics() {
+        use crate::supervisor;
+        use crate::metrics::{Metrics, COUNTER_REQUESTS};
+
+        // Two workers can listen on the same address
+        let first = supervisor::reuseport_listener("127.0.0.1:0").unwrap();
+        let addr = first.local_addr().unwrap().to_string();
+        let second = supervisor::reuseport_listener(&addr).unwrap();
+        assert_eq!(second.local_addr().unwrap().to_string(), addr);
+
+        // Counters written by one worker are visible to the other
+        let path = std::env::temp_dir().join(format!("j_metrics_test_{}", std::process::id()));
+        Metrics::create_shared_file(&path, 2).unwrap();
+        let worker0 = Metrics::shared(&path, 0, 2).unwrap();
+        let worker1 = Metrics::shared(&path, 1, 2).unwrap();
+        worker0.increment(COUNTER_REQUESTS);
+        worker1.increment(COUNTER_REQUESTS);
+        worker1.increment(COUNTER_REQUESTS);
+        assert!(worker0.report().contains("total: requests=3"));
+        std::fs::remove_file(&path).unwrap();
+    }
+
+    #[cfg(unix)]
+    #[test]
+    fn test_static_asset_snapshot() {
+        use crate::supervisor::StaticAssets;
+
+        let dir = std::env::temp_dir().join(format!("j_assets_test_{}", std::process::id()));
+        std::fs::create_dir_all(dir.join("css")).unwrap();
+        std::fs::write(dir.join("app.js"), b"console.log(1);").unwrap();
+        std::fs::write(dir.join("css").join("site.css"), b"body {}").unwrap();
+        let snapshot = dir.with_extension("snapshot");
+        StaticAssets::snapshot(&dir, &snapshot).unwrap();
+
+        // Later edits to the source tree do not reach the snapshot
+        std::fs::write(dir.join("app.js"), b"changed").unwrap();
+        let assets = StaticAssets::map(&snapshot).unwrap();
+        assert_eq!(assets.bytes(assets.find("/app.js").unwrap()), b"console.log(1);");
+        assert_eq!(assets.bytes(assets.find("/css/site.css").unwrap()), b"body {}");
+        assert!(assets.find("/missing.js").is_none());
+
+        // The snapshot is never overwritten in place
+        assert!(StaticAssets::snapshot(&dir, &snapshot).is_err());
+        std::fs::remove_dir_all(&dir).unwrap();
+        std::fs::remove_file(&snapshot).unwrap();
+    }
+}
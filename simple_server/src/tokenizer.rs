@@ -1,16 +1,29 @@
 // J Tokenizer Module
 // Lexical analysis for J language expressions
 
-use crate::j_array::JArray;
+use crate::j_array::{ArrayShape, JArray, JValue};
+use crate::{modifiers, verbs};
 use std::fmt;
+use std::iter::Peekable;
+use std::str::Chars;
 
 // Token types for parsing
 #[derive(Debug, Clone, PartialEq)]
 pub enum Token {
     Vector(JArray),
+    Name(String),
     Verb(char),
+    Adverb(char),
+    Conjunction(char),
     LeftParen,
     RightParen,
+    // Body of a direct definition, {{ ... }}, compiled by the parser
+    Definition(String),
+    // Copula, =. or =: (an explicit definition's names are all local)
+    Assign,
+    // Control word such as if. or for_i. (without the dot)
+    Control(String),
+    Newline,
 }
 
 // Tokenization errors
@@ -19,6 +32,7 @@ pub enum TokenError {
     InvalidNumber(String),
     UnknownCharacter(char),
     InvalidVector(String),
+    UnterminatedDefinition,
 }
 
 impl fmt::Display for TokenError {
@@ -27,6 +41,7 @@ impl fmt::Display for TokenError {
             TokenError::InvalidNumber(s) => write!(f, "Invalid number: {}", s),
             TokenError::UnknownCharacter(c) => write!(f, "Unknown character: {}", c),
             TokenError::InvalidVector(s) => write!(f, "Invalid vector: {}", s),
+            TokenError::UnterminatedDefinition => write!(f, "Definition has no closing }}}}"),
         }
     }
 }
@@ -46,77 +61,111 @@ impl JTokenizer {
         
         while let Some(&c) = chars.peek() {
             match c {
-                '0'..='9' => {
-                    // Parse a vector (space-separated numbers)
-                    let mut numbers = Vec::new();
+                '0'..='9' | '_' => {
+                    // A vector of space-separated numbers
+                    let mut numbers = vec![read_number(&mut chars)?];
+                    loop {
+                        let mut lookahead = chars.clone();
+                        while lookahead.next_if_eq(&' ').is_some() {}
+                        match lookahead.peek() {
+                            Some(&c) if c.is_ascii_digit() || c == '_' => {
+                                chars = lookahead;
+                                numbers.push(read_number(&mut chars)?);
+                            }
+                            _ => break,
+                        }
+                    }
                     
-                    // Parse the first number
-                    let mut number = String::new();
-                    while let Some(&c) = chars.peek() {
-                        if c.is_digit(10) {
-                            number.push(c);
+                    // Create JArray token
+                    let integers: Option<Vec<i64>> = numbers.iter()
+                        .map(|n| match n {
+                            JValue::Integer(n) => Some(i64::from(*n)),
+                            _ => None,
+                        })
+                        .collect();
+                    let complex = numbers.iter().any(|n| matches!(n, JValue::Complex(_)));
+                    let jarray = match integers {
+                        _ if complex => {
+                            let shape = if numbers.len() == 1 { ArrayShape::scalar() } else { ArrayShape::vector(numbers.len()) };
+                            JArray::from_values(numbers, shape)
+                        }
+                        Some(integers) if integers.len() == 1 => JArray::new_scalar(integers[0]),
+                        Some(integers) => JArray::new_integer(1, vec![integers.len()], integers),
+                        None if numbers.len() == 1 => JArray::from_data(numbers, ArrayShape::scalar()),
+                        None => {
+                            let shape = ArrayShape { dimensions: vec![numbers.len()] };
+                            JArray::from_data(numbers, shape)
+                        }
+                    };
+                    tokens.push(Token::Vector(jarray));
+                },
+                '{' if input_at(&chars, "{{") => {
+                    chars.next();
+                    chars.next();
+                    tokens.push(Token::Definition(read_definition(&mut chars)?));
+                },
+                '=' if input_at(&chars, "=.") || input_at(&chars, "=:") => {
+                    chars.next();
+                    chars.next();
+                    tokens.push(Token::Assign);
+                },
+                c if verbs::starts_spelling(c) => {
+                    chars.next();
+                    // Trailing '.'s and ':'s inflect the primitive into another
+                    // verb, as in #::; the longest spelling that is a verb wins
+                    let mut spelling = c.to_string();
+                    let (mut inflected, mut ahead) = (spelling.clone(), chars.clone());
+                    while let Some(inflection @ ('.' | ':')) = ahead.next() {
+                        inflected.push(inflection);
+                        if verbs::lookup_spelling(&inflected).is_some() {
+                            spelling.clone_from(&inflected);
+                            chars = ahead.clone();
+                        }
+                    }
+                    match verbs::lookup_spelling(&spelling) {
+                        Some(verb) => tokens.push(Token::Verb(verb.symbol)),
+                        None => return Err(TokenError::UnknownCharacter(c)),
+                    }
+                },
+                c if modifiers::starts_spelling(c) => {
+                    chars.next();
+                    // Modifiers are inflected the same way, as in ^:
+                    let mut spelling = c.to_string();
+                    if let Some(&inflection @ ('.' | ':')) = chars.peek() {
+                        spelling.push(inflection);
+                        if modifiers::is_spelling(&spelling) {
                             chars.next();
                         } else {
-                            break;
+                            spelling.pop();
                         }
                     }
-                    match number.parse::<i64>() {
-                        Ok(n) => numbers.push(n),
-                        Err(_) => return Err(TokenError::InvalidNumber(number)),
+                    if let Some(adverb) = modifiers::lookup_spelling(&spelling) {
+                        tokens.push(Token::Adverb(adverb.symbol));
+                    } else if let Some(conjunction) = modifiers::lookup_conjunction_spelling(&spelling) {
+                        tokens.push(Token::Conjunction(conjunction.symbol));
+                    } else {
+                        return Err(TokenError::UnknownCharacter(c));
                     }
-                    
-                    // Look for more space-separated numbers
-                    while let Some(&next_char) = chars.peek() {
-                        if next_char == ' ' {
-                            chars.next(); // consume the space
-                            
-                            // Skip any additional spaces
-                            while let Some(&c) = chars.peek() {
-                                if c == ' ' {
-                                    chars.next();
-                                } else {
-                                    break;
-                                }
-                            }
-                            
-                            // Check if the next character starts a number
-                            if let Some(&c) = chars.peek() {
-                                if c.is_digit(10) {
-                                    let mut number = String::new();
-                                    while let Some(&c) = chars.peek() {
-                                        if c.is_digit(10) {
-                                            number.push(c);
-                                            chars.next();
-                                        } else {
-                                            break;
-                                        }
-                                    }
-                                    match number.parse::<i64>() {
-                                        Ok(n) => numbers.push(n),
-                                        Err(_) => return Err(TokenError::InvalidNumber(number)),
-                                    }
-                                } else {
-                                    break; // Not a number, end of vector
-                                }
-                            } else {
-                                break; // End of input
-                            }
+                },
+                'a'..='z' | 'A'..='Z' => {
+                    // Parse a name (letters, digits and underscores)
+                    let mut name = String::new();
+                    while let Some(&c) = chars.peek() {
+                        if c.is_ascii_alphanumeric() || c == '_' {
+                            name.push(c);
+                            chars.next();
                         } else {
-                            break; // Not a space, end of vector
+                            break;
                         }
                     }
-                    
-                    // Create JArray token
-                    let jarray = if numbers.len() == 1 {
-                        JArray::new_scalar(numbers[0])
+                    if name == "NB" && chars.next_if_eq(&'.').is_some() {
+                        // Comment to the end of the line
+                        while chars.next_if(|&c| c != '\n').is_some() {}
+                    } else if is_control_word(&name) && chars.next_if_eq(&'.').is_some() {
+                        tokens.push(Token::Control(name));
                     } else {
-                        JArray::new_integer(1, vec![numbers.len()], numbers)
-                    };
-                    tokens.push(Token::Vector(jarray));
-                },
-                '+' | '~' | '#' | '<' | '{' | ',' => {
-                    tokens.push(Token::Verb(c));
-                    chars.next();
+                        tokens.push(Token::Name(name));
+                    }
                 },
                 '(' => {
                     tokens.push(Token::LeftParen);
@@ -126,7 +175,11 @@ impl JTokenizer {
                     tokens.push(Token::RightParen);
                     chars.next();
                 },
-                ' ' => {
+                '\n' => {
+                    tokens.push(Token::Newline);
+                    chars.next();
+                },
+                ' ' | '\t' | '\r' => {
                     // Skip standalone spaces (they're handled in number parsing)
                     chars.next();
                 },
@@ -138,4 +191,78 @@ impl JTokenizer {
         
         Ok(tokens)
     }
-}
\ No newline at end of file
+}
+
+fn input_at(chars: &Peekable<Chars>, text: &str) -> bool {
+    chars.clone().take(text.len()).eq(text.chars())
+}
+
+// Words that end in '.' to form a control structure inside a definition;
+// for_name. iterates with name bound to each item
+pub fn is_control_word(name: &str) -> bool {
+    matches!(
+        name,
+        "if" | "do" | "else" | "elseif" | "end" | "while" | "for" | "break" | "continue" | "return"
+    ) || name.strip_prefix("for_").map_or(false, |n| !n.is_empty())
+}
+
+// The raw body of a {{ ... }} definition, after its opening braces. Nested
+// definitions are kept whole so the compiler can tokenize them again.
+fn read_definition(chars: &mut Peekable<Chars>) -> Result<String, TokenError> {
+    let mut body = String::new();
+    let mut depth = 0;
+    loop {
+        if input_at(chars, "}}") {
+            chars.next();
+            chars.next();
+            if depth == 0 {
+                return Ok(body);
+            }
+            depth -= 1;
+            body.push_str("}}");
+        } else if input_at(chars, "{{") {
+            chars.next();
+            chars.next();
+            depth += 1;
+            body.push_str("{{");
+        } else {
+            body.push(chars.next().ok_or(TokenError::UnterminatedDefinition)?);
+        }
+    }
+}
+
+// One number of a vector: a real, or a complex number written as two reals
+// joined by 'j' (3j4, _1j_2)
+fn read_number(chars: &mut Peekable<Chars>) -> Result<JValue, TokenError> {
+    let real = read_real(chars)?;
+    if chars.next_if_eq(&'j').is_none() {
+        return Ok(real);
+    }
+    match chars.peek() {
+        Some(&c) if c.is_ascii_digit() || c == '_' => {
+            let imaginary = read_real(chars)?;
+            Ok(JValue::Complex(Box::new((real.to_float().unwrap_or(0.0), imaginary.to_float().unwrap_or(0.0)))))
+        }
+        _ => Err(TokenError::InvalidNumber(format!("{}j", real))),
+    }
+}
+
+// Digits, with a leading '_' for a negative number. '_' alone is infinity
+// and '__' negative infinity; integers too large for 32 bits become floats.
+fn read_real(chars: &mut Peekable<Chars>) -> Result<JValue, TokenError> {
+    let negative = chars.next_if_eq(&'_').is_some();
+    let mut digits = String::new();
+    while let Some(c) = chars.next_if(|c| c.is_ascii_digit()) {
+        digits.push(c);
+    }
+    if digits.is_empty() {
+        let infinity = if chars.next_if_eq(&'_').is_some() { f64::NEG_INFINITY } else { f64::INFINITY };
+        return Ok(JValue::Float(infinity));
+    }
+    let magnitude: i64 = digits.parse().map_err(|_| TokenError::InvalidNumber(digits.clone()))?;
+    let n = if negative { -magnitude } else { magnitude };
+    Ok(match i32::try_from(n) {
+        Ok(n) => JValue::Integer(n),
+        Err(_) => JValue::Float(n as f64),
+    })
+}
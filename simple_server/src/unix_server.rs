@@ -0,0 +1,259 @@
+// Unix Domain Socket Server Module
+// Length-prefixed framed protocol for low-overhead local clients
+//
+// Request frame:  [u32 BE length][u8 mode][u8 options][u64 LE seed]?[expression bytes]
+//   mode b'T' -> text result (same formatting as the REPL)
+//   mode b'B' -> binary result (see encode_binary)
+//   options: OPTION_SEED -> the seed follows, for repeatable random draws
+//            OPTION_REPRODUCIBLE -> float sums that do not depend on the thread count
+// Response frame: [u32 BE length][u8 status][payload]
+//   status 0 -> text result, 1 -> binary result, 2 -> error text
+//
+// The length counts everything after the length field itself. Clients may
+// pipeline any number of requests on one connection; responses come back in
+// request order and are flushed once no further complete request is buffered.
+
+use crate::j_array::{JArray, JValue, Layout};
+use crate::tokenizer::JTokenizer;
+use crate::custom_parser::CustomParser;
+use crate::semantic_analyzer::JSemanticAnalyzer;
+use crate::evaluator::JEvaluator;
+use crate::random;
+use crate::verbs::{self, Reduction};
+use std::borrow::Cow;
+use std::io::{self, BufReader, BufWriter, Read, Write};
+use std::os::unix::net::{UnixListener, UnixStream};
+use std::path::Path;
+use std::thread;
+
+pub const MODE_TEXT: u8 = b'T';
+pub const MODE_BINARY: u8 = b'B';
+
+pub const OPTION_SEED: u8 = 1;
+pub const OPTION_REPRODUCIBLE: u8 = 2;
+
+pub const STATUS_TEXT: u8 = 0;
+pub const STATUS_BINARY: u8 = 1;
+pub const STATUS_ERROR: u8 = 2;
+
+// Binary element type tags
+pub const TYPE_INTEGER: u8 = 0;
+pub const TYPE_FLOAT: u8 = 1;
+
+// Frames larger than this are treated as a protocol error and close the connection
+const MAX_FRAME_LEN: usize = 16 * 1024 * 1024;
+
+// Bind the socket (replacing a stale one) and serve each connection on its own thread
+pub fn spawn(path: &str) -> io::Result<thread::JoinHandle<()>> {
+    if Path::new(path).exists() {
+        std::fs::remove_file(path)?;
+    }
+    let listener = UnixListener::bind(path)?;
+    println!("Unix socket listening at {}", path);
+
+    Ok(thread::spawn(move || {
+        for stream in listener.incoming() {
+            match stream {
+                Ok(stream) => {
+                    thread::spawn(move || {
+                        if let Err(e) = serve_connection(stream) {
+                            println!("Unix socket connection error: {}", e);
+                        }
+                    });
+                }
+                Err(e) => println!("Unix socket accept error: {}", e),
+            }
+        }
+    }))
+}
+
+pub fn serve_connection(stream: UnixStream) -> io::Result<()> {
+    let mut reader = BufReader::new(stream.try_clone()?);
+    let mut writer = BufWriter::new(stream);
+
+    // Reuse the pipeline and buffers across every request on this connection
+    let tokenizer = JTokenizer::new();
+    let mut parser = CustomParser::new();
+    let semantic_analyzer = JSemanticAnalyzer::new();
+    let evaluator = JEvaluator::new();
+    let mut frame = Vec::new();
+    let mut payload = Vec::new();
+
+    loop {
+        let mut len_bytes = [0u8; 4];
+        match reader.read_exact(&mut len_bytes) {
+            Ok(()) => {}
+            Err(e) if e.kind() == io::ErrorKind::UnexpectedEof => break,
+            Err(e) => return Err(e),
+        }
+
+        let len = u32::from_be_bytes(len_bytes) as usize;
+        if len == 0 || len > MAX_FRAME_LEN {
+            write_frame(&mut writer, STATUS_ERROR, b"Protocol Error: invalid frame length")?;
+            writer.flush()?;
+            return Ok(());
+        }
+
+        frame.resize(len, 0);
+        reader.read_exact(&mut frame)?;
+        let mode = frame[0];
+
+        payload.clear();
+        let request = match read_options(&frame) {
+            Ok((options, expression)) => std::str::from_utf8(expression)
+                .map(|expression| (options, expression))
+                .map_err(|_| "Protocol Error: expression is not valid UTF-8"),
+            Err(message) => Err(message),
+        };
+        let status = match request {
+            Ok((options, expression)) => {
+                match options.run(|| evaluate(&tokenizer, &mut parser, &semantic_analyzer, &evaluator, expression)) {
+                    Ok(result) => match mode {
+                        MODE_BINARY => match encode_binary(&result, &mut payload) {
+                            Ok(()) => STATUS_BINARY,
+                            Err(msg) => {
+                                payload.clear();
+                                payload.extend_from_slice(msg.as_bytes());
+                                STATUS_ERROR
+                            }
+                        },
+                        MODE_TEXT => {
+                            write!(payload, "{}", result)?;
+                            STATUS_TEXT
+                        }
+                        _ => {
+                            payload.extend_from_slice(b"Protocol Error: unknown mode");
+                            STATUS_ERROR
+                        }
+                    },
+                    Err(error_text) => {
+                        payload.extend_from_slice(error_text.as_bytes());
+                        STATUS_ERROR
+                    }
+                }
+            }
+            Err(message) => {
+                payload.extend_from_slice(message.as_bytes());
+                STATUS_ERROR
+            }
+        };
+
+        write_frame(&mut writer, status, &payload)?;
+
+        // Hold the reply back only while the next request can be answered
+        // without waiting on the client, so pipelined requests share writes
+        // and a client never waits on a reply behind a partly sent request
+        if !frame_buffered(reader.buffer()) {
+            writer.flush()?;
+        }
+    }
+
+    writer.flush()
+}
+
+// Whether `buffered` starts with a whole frame
+fn frame_buffered(buffered: &[u8]) -> bool {
+    match buffered.get(..4) {
+        Some(len_bytes) => buffered.len() - 4 >= u32::from_be_bytes(len_bytes.try_into().unwrap()) as usize,
+        None => false,
+    }
+}
+
+// The evaluation settings a request frame carries, as the HTTP endpoints
+// take them from their "seed" and "reduction" fields
+struct RequestOptions {
+    seed: Option<u64>,
+    reduction: Reduction,
+}
+
+impl RequestOptions {
+    fn run<T>(&self, f: impl FnOnce() -> T) -> T {
+        match self.seed {
+            Some(seed) => random::with_seed(seed, || verbs::with_reduction(self.reduction, f)),
+            None => verbs::with_reduction(self.reduction, f),
+        }
+    }
+}
+
+// Split a frame after its mode byte into its options and expression bytes
+fn read_options(frame: &[u8]) -> Result<(RequestOptions, &[u8]), &'static str> {
+    let (&flags, rest) = frame[1..].split_first().ok_or("Protocol Error: missing options")?;
+    if flags & !(OPTION_SEED | OPTION_REPRODUCIBLE) != 0 {
+        return Err("Protocol Error: unknown options");
+    }
+    let reduction = if flags & OPTION_REPRODUCIBLE != 0 { Reduction::Reproducible } else { Reduction::Fast };
+    if flags & OPTION_SEED == 0 {
+        return Ok((RequestOptions { seed: None, reduction }, rest));
+    }
+    let (seed, rest) = rest.split_first_chunk::<8>().ok_or("Protocol Error: missing seed")?;
+    Ok((RequestOptions { seed: Some(u64::from_le_bytes(*seed)), reduction }, rest))
+}
+
+fn write_frame<W: Write>(writer: &mut W, status: u8, payload: &[u8]) -> io::Result<()> {
+    let len = (payload.len() + 1) as u32;
+    writer.write_all(&len.to_be_bytes())?;
+    writer.write_all(&[status])?;
+    writer.write_all(payload)
+}
+
+// Run the custom-parser pipeline, reporting errors the same way as /j_eval
+fn evaluate(
+    tokenizer: &JTokenizer,
+    parser: &mut CustomParser,
+    semantic_analyzer: &JSemanticAnalyzer,
+    evaluator: &JEvaluator,
+    expression: &str,
+) -> Result<JArray, String> {
+    let tokens = tokenizer.tokenize(expression)
+        .map_err(|e| format!("Token Error: {}", e))?;
+    let ast = parser.parse(tokens)
+        .map_err(|e| format!("Custom Parse Error: {}", e))?;
+    let resolved_ast = semantic_analyzer.analyze(ast)
+        .map_err(|e| format!("Semantic Error: {}", e))?;
+    evaluator.evaluate(&resolved_ast)
+        .map_err(|e| format!("Evaluation Error: {}", e))
+}
+
+// Binary result layout (little-endian):
+//   [u8 type][u32 rank][u64 dim]*rank [element]*
+// with i64 elements for TYPE_INTEGER and f64 elements for TYPE_FLOAT.
+// Arrays holding any float are sent as floats; boxes and characters are
+// not representable and are reported as errors.
+pub fn encode_binary(array: &JArray, out: &mut Vec<u8>) -> Result<(), String> {
+    let mut has_float = false;
+    // Compact layouts are checked by their distinct values, without expanding
+    // them: packed arrays hold only integers and float buffers only floats
+    let stored: Cow<'_, [JValue]> = match &array.layout {
+        Layout::Packed(_) => Cow::Borrowed(&[]),
+        Layout::Floats(_) => Cow::Owned(vec![JValue::Float(0.0)]),
+        Layout::Runs(runs) => Cow::Borrowed(&runs.values),
+        Layout::Sparse(sparse) => Cow::Owned(sparse.values.iter().chain([&sparse.fill]).cloned().collect()),
+        _ => array.stored(),
+    };
+    for value in stored.iter() {
+        match value {
+            JValue::Integer(_) => {}
+            JValue::Float(_) => has_float = true,
+            other => {
+                return Err(format!(
+                    "Binary Error: {} elements have no binary encoding", other.type_name()
+                ));
+            }
+        }
+    }
+
+    out.reserve(5 + array.shape.rank() * 8 + array.element_count() * 8);
+    out.push(if has_float { TYPE_FLOAT } else { TYPE_INTEGER });
+    out.extend_from_slice(&(array.shape.rank() as u32).to_le_bytes());
+    for &dim in &array.shape.dimensions {
+        out.extend_from_slice(&(dim as u64).to_le_bytes());
+    }
+    for value in array.elements() {
+        if has_float {
+            out.extend_from_slice(&value.to_float().unwrap_or(0.0).to_le_bytes());
+        } else {
+            out.extend_from_slice(&(value.to_integer().unwrap_or(0) as i64).to_le_bytes());
+        }
+    }
+    Ok(())
+}
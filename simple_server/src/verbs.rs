@@ -0,0 +1,2144 @@
+// J Verb Registry Module
+// One table describing every primitive verb: valence, ranks, algebraic
+// properties and the kernels that implement each form.
+//
+// The tokenizer, parser, semantic analyzer and evaluator all consult this
+// table, so adding a verb means adding one descriptor and its kernels.
+
+use crate::j_array::{check_elements, ArrayError, JArray, JValue, ArrayShape, ComplexParts, Layout, Packed, PackedElement, PackedInts, Runs, Sparse, REPEAT_MIN_FACTOR};
+use std::borrow::Cow;
+use crate::evaluator::EvaluationError;
+use crate::histogram;
+use crate::random;
+
+// Rank of a verb that applies to its whole argument
+pub const RANK_INFINITE: usize = usize::MAX;
+
+pub type MonadKernel = fn(&JArray) -> Result<JArray, EvaluationError>;
+pub type DyadKernel = fn(&JArray, &JArray) -> Result<JArray, EvaluationError>;
+// Combines the items along the given axis, so f/"r can hand over a whole argument
+pub type InsertKernel = fn(&JArray, usize) -> Result<JArray, EvaluationError>;
+// Repeats the monad (no left argument) or x&dyad on the right argument;
+// None when the arguments need the general loop
+pub type IterateKernel = fn(Option<&JArray>, &JArray, Repeat) -> Result<Option<JArray>, EvaluationError>;
+
+// How often f^:n applies f: a number of times, or until the result stops
+// changing (giving up after FIXED_POINT_LIMIT applications)
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub enum Repeat {
+    Times(usize),
+    FixedPoint,
+}
+
+pub const FIXED_POINT_LIMIT: usize = 100_000;
+
+pub struct VerbDescriptor {
+    // Internal symbol used in tokens and AST nodes
+    pub symbol: char,
+    // J spelling; primitives inflected with '.' or ':' get their own symbol
+    pub spelling: &'static str,
+    pub monadic_name: &'static str,
+    pub dyadic_name: &'static str,
+    pub monad: Option<MonadKernel>,
+    pub dyad: Option<DyadKernel>,
+    pub monadic_rank: usize,
+    pub dyadic_rank: (usize, usize),
+    // Specialised kernel for inserting the dyad between items (f/ y)
+    pub insert: Option<InsertKernel>,
+    // Specialised kernel for the table of every pair of atoms (x f/ y)
+    pub table: Option<DyadKernel>,
+    // Specialised kernel for repeated application (f^:n y and x f^:n y)
+    pub iterate: Option<IterateKernel>,
+    // Verb whose monad undoes this one's monad, for negative powers
+    pub inverse: Option<char>,
+    // Identity element of the dyad, used when reducing empty arguments
+    pub identity: Option<JValue>,
+    // x f y is y f x: common subexpressions match in either order
+    pub commutative: bool,
+    // (x f y) f z is x f (y f z): prefix scans (f/\) extend the previous prefix
+    pub associative: bool,
+}
+
+impl VerbDescriptor {
+    // True when the dyad applies independently to each pair of atoms
+    pub fn is_scalar_dyad(&self) -> bool {
+        self.dyadic_rank == (0, 0)
+    }
+}
+
+pub static VERBS: &[VerbDescriptor] = &[
+    VerbDescriptor {
+        symbol: '+',
+        spelling: "+",
+        monadic_name: "conjugate",
+        dyadic_name: "plus",
+        monad: Some(conjugate),
+        dyad: Some(plus),
+        monadic_rank: 0,
+        dyadic_rank: (0, 0),
+        insert: Some(sum),
+        table: Some(table::<Plus>),
+        iterate: Some(plus_iterate),
+        inverse: Some('+'),
+        identity: Some(JValue::Integer(0)),
+        commutative: true,
+        associative: true,
+    },
+    VerbDescriptor {
+        symbol: '-',
+        spelling: "-",
+        monadic_name: "negate",
+        dyadic_name: "minus",
+        monad: Some(negate),
+        dyad: Some(minus),
+        monadic_rank: 0,
+        dyadic_rank: (0, 0),
+        insert: None,
+        table: Some(table::<Minus>),
+        iterate: None,
+        inverse: Some('-'),
+        identity: None,
+        commutative: false,
+        associative: false,
+    },
+    VerbDescriptor {
+        symbol: '*',
+        spelling: "*",
+        monadic_name: "signum",
+        dyadic_name: "times",
+        monad: Some(signum),
+        dyad: Some(times),
+        monadic_rank: 0,
+        dyadic_rank: (0, 0),
+        insert: Some(product),
+        table: Some(table::<Times>),
+        iterate: None,
+        inverse: None,
+        identity: Some(JValue::Integer(1)),
+        commutative: true,
+        associative: true,
+    },
+    VerbDescriptor {
+        symbol: '~',
+        spelling: "~",
+        monadic_name: "iota",
+        dyadic_name: "",
+        monad: Some(iota),
+        dyad: None,
+        monadic_rank: 1,
+        dyadic_rank: (RANK_INFINITE, RANK_INFINITE),
+        insert: None,
+        table: None,
+        iterate: None,
+        inverse: None,
+        identity: None,
+        commutative: false,
+        associative: false,
+    },
+    VerbDescriptor {
+        symbol: '#',
+        spelling: "#",
+        monadic_name: "tally",
+        dyadic_name: "copy",
+        monad: Some(tally),
+        dyad: Some(copy),
+        monadic_rank: RANK_INFINITE,
+        dyadic_rank: (1, RANK_INFINITE),
+        insert: None,
+        table: None,
+        iterate: None,
+        inverse: None,
+        identity: None,
+        commutative: false,
+        associative: false,
+    },
+    VerbDescriptor {
+        symbol: '$',
+        spelling: "$",
+        monadic_name: "shape of",
+        dyadic_name: "reshape",
+        monad: Some(shape_of),
+        dyad: Some(reshape),
+        monadic_rank: RANK_INFINITE,
+        dyadic_rank: (1, RANK_INFINITE),
+        insert: None,
+        table: None,
+        iterate: None,
+        inverse: None,
+        identity: None,
+        commutative: false,
+        associative: false,
+    },
+    VerbDescriptor {
+        symbol: ',',
+        spelling: ",",
+        monadic_name: "ravel",
+        dyadic_name: "append",
+        monad: Some(ravel),
+        dyad: Some(append),
+        monadic_rank: RANK_INFINITE,
+        dyadic_rank: (RANK_INFINITE, RANK_INFINITE),
+        insert: Some(join_items),
+        table: None,
+        iterate: None,
+        inverse: None,
+        identity: None,
+        commutative: false,
+        associative: true,
+    },
+    VerbDescriptor {
+        symbol: '<',
+        spelling: "<",
+        monadic_name: "box",
+        dyadic_name: "less than",
+        monad: Some(box_verb),
+        dyad: Some(less_than),
+        monadic_rank: RANK_INFINITE,
+        dyadic_rank: (0, 0),
+        insert: None,
+        table: Some(table::<LessThan>),
+        iterate: Some(iterate::<LessThan>),
+        inverse: Some('>'),
+        identity: None,
+        commutative: false,
+        associative: false,
+    },
+    VerbDescriptor {
+        symbol: '=',
+        spelling: "=",
+        monadic_name: "self-classify",
+        dyadic_name: "equal",
+        monad: None,
+        dyad: Some(equal),
+        monadic_rank: RANK_INFINITE,
+        dyadic_rank: (0, 0),
+        insert: None,
+        table: Some(table::<Equal>),
+        iterate: Some(iterate::<Equal>),
+        inverse: None,
+        identity: None,
+        commutative: true,
+        associative: false,
+    },
+    VerbDescriptor {
+        symbol: '≠',
+        spelling: "~:",
+        monadic_name: "nub sieve",
+        dyadic_name: "not-equal",
+        monad: None,
+        dyad: Some(not_equal),
+        monadic_rank: RANK_INFINITE,
+        dyadic_rank: (0, 0),
+        insert: None,
+        table: Some(table::<NotEqual>),
+        iterate: Some(iterate::<NotEqual>),
+        inverse: None,
+        identity: None,
+        commutative: true,
+        associative: false,
+    },
+    VerbDescriptor {
+        symbol: '≤',
+        spelling: "<:",
+        monadic_name: "decrement",
+        dyadic_name: "less or equal",
+        monad: Some(decrement),
+        dyad: Some(less_or_equal),
+        monadic_rank: 0,
+        dyadic_rank: (0, 0),
+        insert: None,
+        table: Some(table::<LessOrEqual>),
+        iterate: Some(less_or_equal_iterate),
+        inverse: Some('≥'),
+        identity: None,
+        commutative: false,
+        associative: false,
+    },
+    VerbDescriptor {
+        symbol: '>',
+        spelling: ">",
+        monadic_name: "open",
+        dyadic_name: "greater than",
+        monad: Some(open),
+        dyad: Some(greater_than),
+        monadic_rank: 0,
+        dyadic_rank: (0, 0),
+        insert: None,
+        table: Some(table::<GreaterThan>),
+        iterate: Some(iterate::<GreaterThan>),
+        inverse: Some('<'),
+        identity: None,
+        commutative: false,
+        associative: false,
+    },
+    VerbDescriptor {
+        symbol: '≥',
+        spelling: ">:",
+        monadic_name: "increment",
+        dyadic_name: "greater or equal",
+        monad: Some(increment),
+        dyad: Some(greater_or_equal),
+        monadic_rank: 0,
+        dyadic_rank: (0, 0),
+        insert: None,
+        table: Some(table::<GreaterOrEqual>),
+        iterate: Some(greater_or_equal_iterate),
+        inverse: Some('≤'),
+        identity: None,
+        commutative: false,
+        associative: false,
+    },
+    VerbDescriptor {
+        symbol: '⌊',
+        spelling: "<.",
+        monadic_name: "floor",
+        dyadic_name: "minimum",
+        monad: Some(floor),
+        dyad: Some(minimum),
+        monadic_rank: 0,
+        dyadic_rank: (0, 0),
+        insert: Some(minimum_insert),
+        table: Some(table::<Minimum>),
+        iterate: Some(minimum_iterate),
+        inverse: None,
+        identity: Some(JValue::Float(f64::INFINITY)),
+        commutative: true,
+        associative: true,
+    },
+    VerbDescriptor {
+        symbol: '⌈',
+        spelling: ">.",
+        monadic_name: "ceiling",
+        dyadic_name: "maximum",
+        monad: Some(ceiling),
+        dyad: Some(maximum),
+        monadic_rank: 0,
+        dyadic_rank: (0, 0),
+        insert: Some(maximum_insert),
+        table: Some(table::<Maximum>),
+        iterate: Some(maximum_iterate),
+        inverse: None,
+        identity: Some(JValue::Float(f64::NEG_INFINITY)),
+        commutative: true,
+        associative: true,
+    },
+    VerbDescriptor {
+        symbol: '{',
+        spelling: "{",
+        monadic_name: "catalog",
+        dyadic_name: "from",
+        monad: None,
+        dyad: Some(from),
+        monadic_rank: 1,
+        dyadic_rank: (0, RANK_INFINITE),
+        insert: None,
+        table: None,
+        iterate: None,
+        inverse: None,
+        identity: None,
+        commutative: false,
+        associative: false,
+    },
+    VerbDescriptor {
+        symbol: '⌗',
+        spelling: "#::",
+        monadic_name: "bincount",
+        dyadic_name: "histogram",
+        monad: Some(histogram::bincount),
+        dyad: Some(histogram::histogram),
+        monadic_rank: RANK_INFINITE,
+        dyadic_rank: (1, RANK_INFINITE),
+        insert: None,
+        table: None,
+        iterate: None,
+        inverse: None,
+        identity: None,
+        commutative: false,
+        associative: false,
+    },
+    VerbDescriptor {
+        symbol: '?',
+        spelling: "?",
+        monadic_name: "roll",
+        dyadic_name: "deal",
+        monad: Some(random::roll),
+        dyad: Some(random::deal),
+        monadic_rank: 0,
+        dyadic_rank: (RANK_INFINITE, RANK_INFINITE),
+        insert: None,
+        table: None,
+        iterate: None,
+        inverse: None,
+        identity: None,
+        commutative: false,
+        associative: false,
+    },
+    VerbDescriptor {
+        symbol: '¿',
+        spelling: "?.",
+        monadic_name: "roll (fixed seed)",
+        dyadic_name: "deal (fixed seed)",
+        monad: Some(random::roll_fixed),
+        dyad: Some(random::deal_fixed),
+        monadic_rank: 0,
+        dyadic_rank: (RANK_INFINITE, RANK_INFINITE),
+        insert: None,
+        table: None,
+        iterate: None,
+        inverse: None,
+        identity: None,
+        commutative: false,
+        associative: false,
+    },
+];
+
+pub fn lookup(symbol: char) -> Option<&'static VerbDescriptor> {
+    VERBS.iter().find(|verb| verb.symbol == symbol)
+}
+
+// Descriptor for a J spelling such as "+" or "<:"
+pub fn lookup_spelling(spelling: &str) -> Option<&'static VerbDescriptor> {
+    VERBS.iter().find(|verb| verb.spelling == spelling)
+}
+
+// True when some verb's spelling begins with this character
+pub fn starts_spelling(c: char) -> bool {
+    VERBS.iter().any(|verb| verb.spelling.starts_with(c))
+}
+
+// ELEMENTWISE KERNELS
+
+// A scalar dyad, written once per element type. The evaluator classifies
+// both arguments once and then runs a loop monomorphized for that pair.
+pub trait ScalarDyad {
+    const NAME: &'static str;
+    // Comparisons produce only 0/1 integers, which are collected unboxed
+    const PREDICATE: bool = false;
+    // Non-decreasing in each argument, so over ranges of arguments the
+    // extreme results come from the extreme arguments
+    const MONOTONE: bool = false;
+    // Integer form; None means the result does not fit and the whole
+    // operation is redone in floating point (J's automatic promotion)
+    fn int(a: i32, b: i32) -> Option<i32>;
+    fn float(a: f64, b: f64) -> JValue;
+    // Whether the dyad is defined on complex numbers, and its form on
+    // (real, imaginary) pairs; comparisons give 0 or 1 as the real part
+    const COMPLEX: bool = false;
+    #[inline]
+    fn complex(_a: Complex, _b: Complex) -> Complex {
+        (f64::NAN, f64::NAN)
+    }
+}
+
+pub type Complex = (f64, f64);
+
+pub struct Plus;
+impl ScalarDyad for Plus {
+    const NAME: &'static str = "Addition";
+    const MONOTONE: bool = true;
+    #[inline]
+    fn int(a: i32, b: i32) -> Option<i32> {
+        a.checked_add(b)
+    }
+    #[inline]
+    fn float(a: f64, b: f64) -> JValue {
+        JValue::Float(a + b)
+    }
+    const COMPLEX: bool = true;
+    #[inline]
+    fn complex(a: Complex, b: Complex) -> Complex {
+        (a.0 + b.0, a.1 + b.1)
+    }
+}
+
+pub struct Minus;
+impl ScalarDyad for Minus {
+    const NAME: &'static str = "Subtraction";
+    #[inline]
+    fn int(a: i32, b: i32) -> Option<i32> {
+        a.checked_sub(b)
+    }
+    #[inline]
+    fn float(a: f64, b: f64) -> JValue {
+        JValue::Float(a - b)
+    }
+    const COMPLEX: bool = true;
+    #[inline]
+    fn complex(a: Complex, b: Complex) -> Complex {
+        (a.0 - b.0, a.1 - b.1)
+    }
+}
+
+pub struct Times;
+impl ScalarDyad for Times {
+    const NAME: &'static str = "Multiplication";
+    #[inline]
+    fn int(a: i32, b: i32) -> Option<i32> {
+        a.checked_mul(b)
+    }
+    #[inline]
+    fn float(a: f64, b: f64) -> JValue {
+        JValue::Float(a * b)
+    }
+    const COMPLEX: bool = true;
+    #[inline]
+    fn complex(a: Complex, b: Complex) -> Complex {
+        (a.0 * b.0 - a.1 * b.1, a.0 * b.1 + a.1 * b.0)
+    }
+}
+
+// J's comparison tolerance: floats within this relative distance are equal
+pub const COMPARISON_TOLERANCE: f64 = 1.0 / (1u64 << 44) as f64;
+
+#[inline]
+pub fn tolerantly_equal(a: f64, b: f64) -> bool {
+    a == b || (a - b).abs() <= COMPARISON_TOLERANCE * a.abs().max(b.abs())
+}
+
+// The same test on complex numbers, by the magnitude of their difference
+#[inline]
+pub fn tolerantly_equal_complex(a: Complex, b: Complex) -> bool {
+    a == b || (a.0 - b.0).hypot(a.1 - b.1) <= COMPARISON_TOLERANCE * a.0.hypot(a.1).max(b.0.hypot(b.1))
+}
+
+// Comparisons: exact on integers, tolerant on floats
+macro_rules! comparison {
+    ($kernel:ident, $name:expr, |$a:ident, $b:ident| int: $int:expr, float: $float:expr $(, complex: $complex:expr)?) => {
+        pub struct $kernel;
+        impl ScalarDyad for $kernel {
+            const NAME: &'static str = $name;
+            const PREDICATE: bool = true;
+            #[inline]
+            fn int($a: i32, $b: i32) -> Option<i32> {
+                Some($int as i32)
+            }
+            #[inline]
+            fn float($a: f64, $b: f64) -> JValue {
+                JValue::Integer($float as i32)
+            }
+            $(
+                const COMPLEX: bool = true;
+                #[inline]
+                fn complex($a: Complex, $b: Complex) -> Complex {
+                    ($complex as i32 as f64, 0.0)
+                }
+            )?
+        }
+    };
+}
+
+// Only equality is defined on complex numbers, which have no order
+comparison!(Equal, "Comparison", |a, b| int: a == b, float: tolerantly_equal(a, b), complex: tolerantly_equal_complex(a, b));
+comparison!(NotEqual, "Comparison", |a, b| int: a != b, float: !tolerantly_equal(a, b), complex: !tolerantly_equal_complex(a, b));
+comparison!(LessThan, "Comparison", |a, b| int: a < b, float: a < b && !tolerantly_equal(a, b));
+comparison!(LessOrEqual, "Comparison", |a, b| int: a <= b, float: a < b || tolerantly_equal(a, b));
+comparison!(GreaterThan, "Comparison", |a, b| int: a > b, float: a > b && !tolerantly_equal(a, b));
+comparison!(GreaterOrEqual, "Comparison", |a, b| int: a >= b, float: a > b || tolerantly_equal(a, b));
+
+pub struct Minimum;
+impl ScalarDyad for Minimum {
+    const NAME: &'static str = "Minimum";
+    const MONOTONE: bool = true;
+    #[inline]
+    fn int(a: i32, b: i32) -> Option<i32> {
+        Some(a.min(b))
+    }
+    #[inline]
+    fn float(a: f64, b: f64) -> JValue {
+        JValue::Float(a.min(b))
+    }
+}
+
+pub struct Maximum;
+impl ScalarDyad for Maximum {
+    const NAME: &'static str = "Maximum";
+    const MONOTONE: bool = true;
+    #[inline]
+    fn int(a: i32, b: i32) -> Option<i32> {
+        Some(a.max(b))
+    }
+    #[inline]
+    fn float(a: f64, b: f64) -> JValue {
+        JValue::Float(a.max(b))
+    }
+}
+
+// Element type of a whole numeric array, decided once per call
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub enum NumericClass {
+    Integer,
+    Float,
+}
+
+pub fn numeric_class(array: &JArray, operation: &str) -> Result<NumericClass, EvaluationError> {
+    if array.packed().is_some() {
+        return Ok(NumericClass::Integer);
+    }
+    if array.floats().is_some() {
+        return Ok(NumericClass::Float);
+    }
+    let stored;
+    let values: Vec<&JValue> = match (array.runs(), array.sparse()) {
+        (Some(runs), _) => runs.values.iter().collect(),
+        (_, Some(sparse)) => sparse.values.iter().chain(std::iter::once(&sparse.fill)).collect(),
+        _ => {
+            stored = array.stored();
+            stored.iter().collect()
+        }
+    };
+    let mut class = NumericClass::Integer;
+    for value in values {
+        match value {
+            JValue::Integer(_) => {}
+            JValue::Float(_) => class = NumericClass::Float,
+            JValue::Complex(_) => {
+                return Err(EvaluationError::DomainError(
+                    format!("{} requires real values", operation)
+                ));
+            }
+            _ => {
+                return Err(EvaluationError::DomainError(
+                    format!("{} requires numeric values", operation)
+                ));
+            }
+        }
+    }
+    Ok(class)
+}
+
+// Reading an element whose type was already established by numeric_class
+pub trait Element: Copy {
+    fn read(value: &JValue) -> Self;
+    fn to_f64(self) -> f64;
+}
+
+impl Element for i32 {
+    #[inline]
+    fn read(value: &JValue) -> Self {
+        match value {
+            JValue::Integer(i) => *i,
+            _ => 0,
+        }
+    }
+    #[inline]
+    fn to_f64(self) -> f64 {
+        self as f64
+    }
+}
+
+impl Element for f64 {
+    #[inline]
+    fn read(value: &JValue) -> Self {
+        match value {
+            JValue::Integer(i) => *i as f64,
+            JValue::Float(f) => *f,
+            _ => 0.0,
+        }
+    }
+    #[inline]
+    fn to_f64(self) -> f64 {
+        self
+    }
+}
+
+// Shape of a dyad's result under J's prefix agreement: the argument with the
+// shorter shape must be a prefix of the other, and each of its atoms pairs
+// with a whole cell of the longer argument.
+pub fn agreement_shape(left: &JArray, right: &JArray) -> Result<ArrayShape, EvaluationError> {
+    let (short, long) = if left.shape.rank() <= right.shape.rank() {
+        (&left.shape, &right.shape)
+    } else {
+        (&right.shape, &left.shape)
+    };
+    if long.dimensions[..short.rank()] != short.dimensions[..] {
+        return Err(EvaluationError::DimensionMismatch(
+            format!("Length error: shapes {:?} and {:?} do not agree", left.shape.dimensions, right.shape.dimensions)
+        ));
+    }
+    Ok(long.clone())
+}
+
+// Apply `f` to every pair of agreeing atoms
+#[inline]
+fn zip_agree<L: Element, R: Element, T, F>(left: &[JValue], right: &[JValue], mut f: F) -> Vec<T>
+where
+    F: FnMut(L, R) -> T,
+{
+    if left.len() == right.len() {
+        return left.iter().zip(right).map(|(l, r)| f(L::read(l), R::read(r))).collect();
+    }
+    let mut result = Vec::with_capacity(left.len().max(right.len()));
+    if left.len() < right.len() {
+        if left.is_empty() {
+            return result;
+        }
+        let cell = right.len() / left.len();
+        for (l, cell_values) in left.iter().zip(right.chunks(cell)) {
+            let l = L::read(l);
+            result.extend(cell_values.iter().map(|r| f(l, R::read(r))));
+        }
+    } else {
+        if right.is_empty() {
+            return result;
+        }
+        let cell = left.len() / right.len();
+        for (r, cell_values) in right.iter().zip(left.chunks(cell)) {
+            let r = R::read(r);
+            result.extend(cell_values.iter().map(|l| f(L::read(l), r)));
+        }
+    }
+    result
+}
+
+// Run a scalar dyad with the loop picked once for the arguments' type pair
+pub fn scalar_dyad<K: ScalarDyad>(left: &JArray, right: &JArray) -> Result<JArray, EvaluationError> {
+    let classes = match (numeric_class(left, K::NAME), numeric_class(right, K::NAME)) {
+        (Ok(left_class), Ok(right_class)) => (left_class, right_class),
+        _ if is_complex(left) || is_complex(right) => return complex_dyad::<K>(left, right),
+        (left_class, right_class) => (left_class?, right_class?),
+    };
+    let shape = agreement_shape(left, right)?;
+
+    // Sparse arguments are combined at their stored entries only
+    if left.sparse().is_some() || right.sparse().is_some() {
+        if let Some(sparse) = zip_sparse::<K>(classes, left, right) {
+            return Ok(JArray::from_sparse(sparse, shape));
+        }
+    }
+
+    // Run-length encoded arguments are combined run by run
+    if left.runs().is_some() || right.runs().is_some() {
+        if let Some(runs) = zip_runs::<K>(classes, left, right) {
+            return Ok(JArray::from_runs(runs, shape));
+        }
+    }
+
+    // A comparison of a sorted packed array with an atom changes value at
+    // most twice, so two binary searches find the runs of the result
+    if K::PREDICATE {
+        if let Some(runs) = compare_sorted::<K>(left, right) {
+            return Ok(JArray::from_runs(runs, shape));
+        }
+    }
+
+    // Packed integers are read at their own width; results are packed
+    // again at whatever width they need
+    if let (Some(left_ints), Some(right_ints)) = (int_operand(left), int_operand(right)) {
+        if left.shape == right.shape || left.element_count() == 1 || right.element_count() == 1 {
+            if let Some(values) = zip_packed::<K>(&left_ints, &right_ints) {
+                return Ok(JArray::from_ints(values, shape));
+            }
+        }
+    }
+
+    // Float buffers are read in place and give a float buffer back
+    if let Some(values) = zip_floats::<K>(left, right) {
+        return Ok(JArray::from_floats(values.into(), shape));
+    }
+
+    if let (Some(left_data), Some(right_data)) = (left.contiguous(), right.contiguous()) {
+        return Ok(zip_dense::<K>(classes, left_data, right_data, shape));
+    }
+
+    if let Some(result) = zip_small_cell::<K>(classes, left, right) {
+        return Ok(result);
+    }
+
+    // Repeated operands pair element i with element i (or with a single
+    // atom), so the result repeats with the lcm of their periods and only
+    // one period of it needs computing
+    let same_pairing = left.shape == right.shape
+        || left.element_count() == 1
+        || right.element_count() == 1;
+    if let (true, Some(left_period), Some(right_period)) = (same_pairing, left.period(), right.period()) {
+        let period = lcm(left_period.len(), right_period.len());
+        if period * REPEAT_MIN_FACTOR <= shape.total_elements() {
+            let cycle = |values: &[JValue]| -> Vec<JValue> {
+                values.iter().cycle().take(period).cloned().collect()
+            };
+            let pattern = zip_classes::<K>(classes, &cycle(left_period), &cycle(right_period));
+            return Ok(JArray::repeated(pattern, shape));
+        }
+    }
+
+    let (left, right) = (left.to_dense(), right.to_dense());
+    Ok(zip_dense::<K>(classes, &left.data, &right.data, shape))
+}
+
+// Dense elementwise loop. Integer results (always, for comparisons) are
+// collected unboxed so that large results pack, comparisons to 1-byte flags.
+fn zip_dense<K: ScalarDyad>(classes: (NumericClass, NumericClass), left: &[JValue], right: &[JValue], shape: ArrayShape) -> JArray {
+    if K::PREDICATE || classes == (NumericClass::Integer, NumericClass::Integer) {
+        if let Some(ints) = zip_int_results::<K>(classes, left, right) {
+            return JArray::from_ints(ints, shape);
+        }
+    }
+    JArray::from_data(zip_classes::<K>(classes, left, right), shape)
+}
+
+// True when some element of the array is complex
+pub fn is_complex(array: &JArray) -> bool {
+    let complex = |value: &JValue| matches!(value, JValue::Complex(_));
+    match &array.layout {
+        Layout::Complex(_) => true,
+        Layout::Packed(_) | Layout::Floats(_) => false,
+        Layout::Runs(runs) => runs.values.iter().any(complex),
+        Layout::Sparse(sparse) => complex(&sparse.fill) || sparse.values.iter().any(complex),
+        _ => array.stored().iter().any(complex),
+    }
+}
+
+// The real and imaginary parts of a numeric array (see JArray::complex_parts)
+pub fn complex_parts<'a>(array: &'a JArray, operation: &str) -> Result<Cow<'a, ComplexParts>, EvaluationError> {
+    array.complex_parts()
+        .ok_or_else(|| EvaluationError::DomainError(format!("{} requires numeric values", operation)))
+}
+
+// A scalar dyad with a complex argument, the other promoted if real. The
+// parts are separate f64 buffers and an atom argument stays in registers,
+// so each loop vectorizes as the float loops do.
+fn complex_dyad<K: ScalarDyad>(left: &JArray, right: &JArray) -> Result<JArray, EvaluationError> {
+    if !K::COMPLEX {
+        return Err(EvaluationError::DomainError(format!("{} requires real values", K::NAME)));
+    }
+    let shape = agreement_shape(left, right)?;
+    let (left, right) = (complex_parts(left, K::NAME)?, complex_parts(right, K::NAME)?);
+    let count = shape.total_elements();
+    let (mut re, mut im) = (vec![0.0; count], vec![0.0; count]);
+    if count > 0 {
+        let (left_re, left_im) = (&left.re[..], &left.im[..]);
+        let (right_re, right_im) = (&right.re[..], &right.im[..]);
+        match (left.len(), right.len()) {
+            (l, r) if l == r => {
+                for i in 0..count {
+                    (re[i], im[i]) = K::complex((left_re[i], left_im[i]), (right_re[i], right_im[i]));
+                }
+            }
+            (1, _) => {
+                let a = (left_re[0], left_im[0]);
+                for i in 0..count {
+                    (re[i], im[i]) = K::complex(a, (right_re[i], right_im[i]));
+                }
+            }
+            (_, 1) => {
+                let b = (right_re[0], right_im[0]);
+                for i in 0..count {
+                    (re[i], im[i]) = K::complex((left_re[i], left_im[i]), b);
+                }
+            }
+            // Each atom of the shorter argument pairs with a cell of the other
+            (l, r) => {
+                let cell = l.max(r) / l.min(r);
+                for i in 0..count {
+                    let (a, b) = if l < r { (i / cell, i) } else { (i, i / cell) };
+                    (re[i], im[i]) = K::complex((left_re[a], left_im[a]), (right_re[b], right_im[b]));
+                }
+            }
+        }
+    }
+    if K::PREDICATE {
+        return Ok(JArray::from_ints(re.into_iter().map(|flag| flag as i32).collect(), shape));
+    }
+    Ok(JArray::from_complex(re, im, shape))
+}
+
+// Integer results, or None when an integer dyad overflows
+fn zip_int_results<K: ScalarDyad>(classes: (NumericClass, NumericClass), left: &[JValue], right: &[JValue]) -> Option<Vec<i32>> {
+    #[inline]
+    fn flag(value: JValue) -> i32 {
+        match value {
+            JValue::Integer(i) => i,
+            _ => 0,
+        }
+    }
+    match classes {
+        (NumericClass::Integer, NumericClass::Integer) => {
+            let mut overflowed = false;
+            let ints = zip_agree::<i32, i32, _, _>(left, right, |a, b| {
+                K::int(a, b).unwrap_or_else(|| {
+                    overflowed = true;
+                    0
+                })
+            });
+            if overflowed { None } else { Some(ints) }
+        }
+        (NumericClass::Integer, NumericClass::Float) => {
+            Some(zip_agree::<i32, f64, _, _>(left, right, |a, b| flag(K::float(a.to_f64(), b))))
+        }
+        (NumericClass::Float, NumericClass::Integer) => {
+            Some(zip_agree::<f64, i32, _, _>(left, right, |a, b| flag(K::float(a, b.to_f64()))))
+        }
+        (NumericClass::Float, NumericClass::Float) => {
+            Some(zip_agree::<f64, f64, _, _>(left, right, |a, b| flag(K::float(a, b))))
+        }
+    }
+}
+
+// An argument paired with one small cell repeated all over it, which is how
+// x u"1 y (or u"2) lays out a single vector or matrix y against a batch x.
+// Cells of the common geometric sizes are held in a fixed-size array, so
+// each cell of the batch is one unrolled step and the repeated argument is
+// never expanded.
+fn zip_small_cell<K: ScalarDyad>(classes: (NumericClass, NumericClass), left: &JArray, right: &JArray) -> Option<JArray> {
+    if left.shape != right.shape {
+        return None;
+    }
+    let (array, cell, cell_on_right) = match (left.period(), right.period()) {
+        (None, Some(cell)) => (batch_side(left, cell)?, cell, true),
+        (Some(cell), None) => (batch_side(right, cell)?, cell, false),
+        _ => return None,
+    };
+    let ints = classes == (NumericClass::Integer, NumericClass::Integer);
+    let values = match cell.len() {
+        2 => zip_cell::<K, 2>(ints, array, cell, cell_on_right),
+        3 => zip_cell::<K, 3>(ints, array, cell, cell_on_right),
+        4 => zip_cell::<K, 4>(ints, array, cell, cell_on_right),
+        9 => zip_cell::<K, 9>(ints, array, cell, cell_on_right),
+        16 => zip_cell::<K, 16>(ints, array, cell, cell_on_right),
+        _ => None,
+    }?;
+    Some(match values {
+        CellResults::Ints(ints) => JArray::from_ints(ints, array.shape.clone()),
+        CellResults::Values(values) => JArray::from_data(values, array.shape.clone()),
+    })
+}
+
+// The batch side, when it is stored flat and covers whole cells
+fn batch_side<'a>(array: &'a JArray, cell: &[JValue]) -> Option<&'a JArray> {
+    let flat = matches!(array.layout, Layout::Dense | Layout::Packed(_) | Layout::Rope(_));
+    (flat && array.element_count() % cell.len() == 0).then_some(array)
+}
+
+enum CellResults {
+    Ints(Vec<i32>),
+    Values(Vec<JValue>),
+}
+
+// None when an integer result overflows, leaving the promotion to floats
+// to the general path
+fn zip_cell<K: ScalarDyad, const N: usize>(ints: bool, array: &JArray, cell: &[JValue], cell_on_right: bool) -> Option<CellResults> {
+    if ints {
+        let cell: [i32; N] = std::array::from_fn(|k| i32::read(&cell[k]));
+        let results = match array.packed().map(|packed| &packed.ints) {
+            Some(PackedInts::I8(values)) => cycle_cell::<K, _, N>(values, |v| v.widen(), &cell, cell_on_right),
+            Some(PackedInts::I16(values)) => cycle_cell::<K, _, N>(values, |v| v.widen(), &cell, cell_on_right),
+            Some(PackedInts::I32(values)) => cycle_cell::<K, _, N>(values, |&v| v, &cell, cell_on_right),
+            None => cycle_cell::<K, _, N>(array.contiguous()?, i32::read, &cell, cell_on_right),
+        };
+        return results.map(CellResults::Ints);
+    }
+    let cell: [f64; N] = std::array::from_fn(|k| f64::read(&cell[k]));
+    let values = array.contiguous()?;
+    let mut results = Vec::with_capacity(values.len());
+    for chunk in values.chunks_exact(N) {
+        for k in 0..N {
+            let a = f64::read(&chunk[k]);
+            results.push(if cell_on_right { K::float(a, cell[k]) } else { K::float(cell[k], a) });
+        }
+    }
+    Some(CellResults::Values(results))
+}
+
+#[inline]
+fn cycle_cell<K: ScalarDyad, T, const N: usize>(values: &[T], read: impl Fn(&T) -> i32, cell: &[i32; N], cell_on_right: bool) -> Option<Vec<i32>> {
+    let mut results = Vec::with_capacity(values.len());
+    for chunk in values.chunks_exact(N) {
+        for k in 0..N {
+            let a = read(&chunk[k]);
+            results.push(if cell_on_right { K::int(a, cell[k])? } else { K::int(cell[k], a)? });
+        }
+    }
+    Some(results)
+}
+
+// Compare a sorted packed array with an integer atom. The elements below,
+// equal to and above the atom form three consecutive ranges, and every
+// comparison is constant on each range.
+fn compare_sorted<K: ScalarDyad>(left: &JArray, right: &JArray) -> Option<Runs> {
+    fn sorted(array: &JArray) -> Option<&Packed> {
+        array.packed().filter(|packed| packed.sorted)
+    }
+    fn atom(array: &JArray) -> Option<i32> {
+        match array.contiguous() {
+            Some([JValue::Integer(atom)]) => Some(*atom),
+            _ => None,
+        }
+    }
+    let (packed, atom, atom_left) = match (sorted(left), atom(right), atom(left), sorted(right)) {
+        (Some(packed), Some(atom), _, _) => (packed, atom, false),
+        (_, _, Some(atom), Some(packed)) => (packed, atom, true),
+        _ => return None,
+    };
+    let below = packed.partition_point(atom, false);
+    let not_above = packed.partition_point(atom, true);
+    let compare = |value: i32| if atom_left { K::int(atom, value) } else { K::int(value, atom) };
+    let mut values = Vec::new();
+    let mut ends = Vec::new();
+    // Representatives of each range: something below, the atom, something above
+    for (end, representative) in [(below, atom.wrapping_sub(1)), (not_above, atom), (packed.len(), atom.wrapping_add(1))] {
+        if ends.last().copied().unwrap_or(0) < end {
+            values.push(JValue::Integer(compare(representative)?));
+            ends.push(end);
+        }
+    }
+    Some(Runs::from_runs(values, ends))
+}
+
+fn zip_classes<K: ScalarDyad>(classes: (NumericClass, NumericClass), left: &[JValue], right: &[JValue]) -> Vec<JValue> {
+    match classes {
+        (NumericClass::Integer, NumericClass::Integer) => {
+            let mut overflowed = false;
+            let data = zip_agree::<i32, i32, _, _>(left, right, |a, b| {
+                JValue::Integer(K::int(a, b).unwrap_or_else(|| {
+                    overflowed = true;
+                    0
+                }))
+            });
+            if overflowed {
+                zip_agree::<i32, i32, _, _>(left, right, |a, b| K::float(a.to_f64(), b.to_f64()))
+            } else {
+                data
+            }
+        }
+        (NumericClass::Integer, NumericClass::Float) => {
+            zip_agree::<i32, f64, _, _>(left, right, |a, b| K::float(a.to_f64(), b))
+        }
+        (NumericClass::Float, NumericClass::Integer) => {
+            zip_agree::<f64, i32, _, _>(left, right, |a, b| K::float(a, b.to_f64()))
+        }
+        (NumericClass::Float, NumericClass::Float) => {
+            zip_agree::<f64, f64, _, _>(left, right, |a, b| K::float(a, b))
+        }
+    }
+}
+
+// Combine a run-length encoded argument with an atom or with another encoded
+// argument of the same shape. Each pair of overlapping runs is computed once.
+fn zip_runs<K: ScalarDyad>(classes: (NumericClass, NumericClass), left: &JArray, right: &JArray) -> Option<Runs> {
+    let atom = |array: &JArray| -> Option<JValue> {
+        if array.element_count() == 1 { Some(array.value(0)) } else { None }
+    };
+    match (left.runs(), right.runs()) {
+        (Some(runs), _) if atom(right).is_some() => {
+            let values = zip_classes::<K>(classes, &runs.values, &[atom(right)?]);
+            Some(Runs::from_runs(values, runs.ends.clone()))
+        }
+        (_, Some(runs)) if atom(left).is_some() => {
+            let values = zip_classes::<K>(classes, &[atom(left)?], &runs.values);
+            Some(Runs::from_runs(values, runs.ends.clone()))
+        }
+        (Some(left_runs), Some(right_runs)) if left.shape == right.shape => {
+            // Split both at every run boundary of either
+            let (mut i, mut j) = (0, 0);
+            let (mut lefts, mut rights, mut ends) = (Vec::new(), Vec::new(), Vec::new());
+            while i < left_runs.run_count() && j < right_runs.run_count() {
+                lefts.push(left_runs.values[i].clone());
+                rights.push(right_runs.values[j].clone());
+                let end = left_runs.ends[i].min(right_runs.ends[j]);
+                ends.push(end);
+                if left_runs.ends[i] == end {
+                    i += 1;
+                }
+                if right_runs.ends[j] == end {
+                    j += 1;
+                }
+            }
+            Some(Runs::from_runs(zip_classes::<K>(classes, &lefts, &rights), ends))
+        }
+        _ => None,
+    }
+}
+
+// Combine a sparse argument with an atom or with another sparse argument of
+// the same shape. The fill of the result is the dyad applied to the fills,
+// and is computed together with the entries so promotion applies to both.
+fn zip_sparse<K: ScalarDyad>(classes: (NumericClass, NumericClass), left: &JArray, right: &JArray) -> Option<Sparse> {
+    let atom = |array: &JArray| -> Option<JValue> {
+        if array.element_count() == 1 { Some(array.value(0)) } else { None }
+    };
+    let (indices, mut lefts, mut rights) = match (left.sparse(), right.sparse()) {
+        (Some(sparse), _) if atom(right).is_some() => {
+            let atom = atom(right)?;
+            let rights = vec![atom; sparse.nonzero_count() + 1];
+            (sparse.indices.clone(), sparse.values.clone(), rights)
+        }
+        (_, Some(sparse)) if atom(left).is_some() => {
+            let atom = atom(left)?;
+            let lefts = vec![atom; sparse.nonzero_count() + 1];
+            (sparse.indices.clone(), lefts, sparse.values.clone())
+        }
+        (Some(left_sparse), Some(right_sparse)) if left.shape == right.shape => {
+            // Union of both index sets; a side without an entry contributes its fill
+            let (mut i, mut j) = (0, 0);
+            let (mut indices, mut lefts, mut rights) = (Vec::new(), Vec::new(), Vec::new());
+            while i < left_sparse.nonzero_count() || j < right_sparse.nonzero_count() {
+                let li = left_sparse.indices.get(i).copied().unwrap_or(usize::MAX);
+                let rj = right_sparse.indices.get(j).copied().unwrap_or(usize::MAX);
+                let index = li.min(rj);
+                indices.push(index);
+                lefts.push(if li == index { i += 1; left_sparse.values[i - 1].clone() } else { left_sparse.fill.clone() });
+                rights.push(if rj == index { j += 1; right_sparse.values[j - 1].clone() } else { right_sparse.fill.clone() });
+            }
+            (indices, lefts, rights)
+        }
+        _ => return None,
+    };
+    // The fills go last, so they are combined in the same pass
+    if let Some(sparse) = left.sparse() {
+        lefts.push(sparse.fill.clone());
+    }
+    if let Some(sparse) = right.sparse() {
+        rights.push(sparse.fill.clone());
+    }
+    let mut values = zip_classes::<K>(classes, &lefts, &rights);
+    let fill = values.pop()?;
+    Some(Sparse::from_entries(indices, values, fill, left.element_count().max(right.element_count())))
+}
+
+// An argument the packed path can read: a packed array, or an integer atom
+// when the other argument is packed
+fn int_operand(array: &JArray) -> Option<Cow<'_, PackedInts>> {
+    match (array.packed(), array.contiguous()) {
+        (Some(packed), _) => Some(Cow::Borrowed(&packed.ints)),
+        (None, Some([JValue::Integer(atom)])) => Some(Cow::Owned(PackedInts::I32(vec![*atom].into()))),
+        _ => None,
+    }
+}
+
+// An argument the float path can read: a float buffer, or a numeric atom
+fn float_operand(array: &JArray) -> Option<Cow<'_, [f64]>> {
+    match (array.floats(), array.contiguous()) {
+        (Some(values), _) => Some(Cow::Borrowed(values)),
+        (None, Some([atom])) => atom.to_float().map(|value| Cow::Owned(vec![value])),
+        _ => None,
+    }
+}
+
+// A float dyad over a float buffer and another float buffer of the same
+// shape or an atom. None for comparisons, whose results are integers.
+fn zip_floats<K: ScalarDyad>(left: &JArray, right: &JArray) -> Option<Vec<f64>> {
+    if K::PREDICATE || (left.floats().is_none() && right.floats().is_none()) {
+        return None;
+    }
+    let (left, right) = (float_operand(left)?, float_operand(right)?);
+    let float = |a, b| match K::float(a, b) {
+        JValue::Float(value) => Some(value),
+        _ => None,
+    };
+    match (left.len(), right.len()) {
+        (l, r) if l == r => left.iter().zip(right.iter()).map(|(&a, &b)| float(a, b)).collect(),
+        (1, _) => right.iter().map(|&b| float(left[0], b)).collect(),
+        (_, 1) => left.iter().map(|&a| float(a, right[0])).collect(),
+        _ => None,
+    }
+}
+
+// Dispatch a packed dyad on the widths of both arguments. None when the
+// pair isn't worth packing (two atoms) or an integer result overflows.
+fn zip_packed<K: ScalarDyad>(left: &PackedInts, right: &PackedInts) -> Option<Vec<i32>> {
+    use PackedInts::*;
+    match (left, right) {
+        (I32(l), I32(r)) if l.len() == 1 && r.len() == 1 => None,
+        (I8(l), I8(r)) => zip_ints::<K, _, _>(l, r),
+        (I8(l), I16(r)) => zip_ints::<K, _, _>(l, r),
+        (I8(l), I32(r)) => zip_ints::<K, _, _>(l, r),
+        (I16(l), I8(r)) => zip_ints::<K, _, _>(l, r),
+        (I16(l), I16(r)) => zip_ints::<K, _, _>(l, r),
+        (I16(l), I32(r)) => zip_ints::<K, _, _>(l, r),
+        (I32(l), I8(r)) => zip_ints::<K, _, _>(l, r),
+        (I32(l), I16(r)) => zip_ints::<K, _, _>(l, r),
+        (I32(l), I32(r)) => zip_ints::<K, _, _>(l, r),
+    }
+}
+
+#[inline]
+fn zip_ints<K: ScalarDyad, L: PackedElement, R: PackedElement>(left: &[L], right: &[R]) -> Option<Vec<i32>> {
+    if left.len() == right.len() {
+        left.iter().zip(right).map(|(a, b)| K::int(a.widen(), b.widen())).collect()
+    } else if left.len() == 1 {
+        let a = left[0].widen();
+        right.iter().map(|b| K::int(a, b.widen())).collect()
+    } else {
+        let b = right[0].widen();
+        left.iter().map(|a| K::int(a.widen(), b)).collect()
+    }
+}
+
+fn lcm(a: usize, b: usize) -> usize {
+    let (mut x, mut y) = (a, b);
+    while y != 0 {
+        (x, y) = (y, x % y);
+    }
+    a / x * b
+}
+
+// MONADIC VERBS
+
+// Conjugate (+): identity on real numbers - returns the argument unchanged
+fn conjugate(array: &JArray) -> Result<JArray, EvaluationError> {
+    if !is_complex(array) {
+        return Ok(array.clone());
+    }
+    let parts = complex_parts(array, "Conjugate")?;
+    Ok(JArray::from_complex(parts.re.clone(), parts.im.iter().map(|im| -im).collect(), array.shape.clone()))
+}
+
+// Negate verb (-): 0 minus each atom
+fn negate(array: &JArray) -> Result<JArray, EvaluationError> {
+    scalar_dyad::<Minus>(&JArray::scalar(0), array)
+}
+
+// Signum verb (*): -1, 0 or 1 for reals; a complex number divided by its
+// magnitude
+fn signum(array: &JArray) -> Result<JArray, EvaluationError> {
+    if is_complex(array) {
+        let parts = complex_parts(array, "Signum")?;
+        let unit = |(re, im): Complex| match re.hypot(im) {
+            magnitude if magnitude == 0.0 => (0.0, 0.0),
+            magnitude => (re / magnitude, im / magnitude),
+        };
+        let (re, im) = parts.re.iter().zip(&parts.im).map(|(&re, &im)| unit((re, im))).unzip();
+        return Ok(JArray::from_complex(re, im, array.shape.clone()));
+    }
+    numeric_class(array, "Signum")?;
+    let sign = |value: f64| (value > 0.0) as i32 - (value < 0.0) as i32;
+    Ok(JArray::from_ints(array.elements().map(|value| sign(f64::read(&value))).collect(), array.shape.clone()))
+}
+
+// Iota verb (~): Generate a sequence of integers from 0 to n-1
+fn iota(array: &JArray) -> Result<JArray, EvaluationError> {
+    if !array.is_scalar() {
+        return Err(EvaluationError::DomainError(
+            "iota requires a scalar argument".to_string()
+        ));
+    }
+
+    let n = array.element(0).to_integer()
+        .ok_or(EvaluationError::DomainError("iota requires integer argument".to_string()))?;
+
+    if n < 0 {
+        return Err(EvaluationError::DomainError(
+            "iota requires a non-negative argument".to_string()
+        ));
+    }
+
+    let data: Vec<i32> = (0..n).collect();
+    Ok(JArray::vector(data))
+}
+
+// Tally verb (#): Count number of elements along first axis
+fn tally(array: &JArray) -> Result<JArray, EvaluationError> {
+    let count = array.tally() as i32;
+    Ok(JArray::scalar(count))
+}
+
+// Shape-of verb ($): The dimensions of an array as a vector
+fn shape_of(array: &JArray) -> Result<JArray, EvaluationError> {
+    Ok(JArray::vector(array.shape.dimensions.iter().map(|&d| d as i32).collect()))
+}
+
+// Ravel verb (,): Flatten array to vector
+fn ravel(array: &JArray) -> Result<JArray, EvaluationError> {
+    Ok(array.ravel())
+}
+
+// Box verb (<): Create boxed array
+fn box_verb(array: &JArray) -> Result<JArray, EvaluationError> {
+    Ok(JArray::box_array(array.clone()))
+}
+
+// Increment (>:) and decrement (<:)
+fn increment(array: &JArray) -> Result<JArray, EvaluationError> {
+    scalar_dyad::<Plus>(array, &JArray::scalar(1))
+}
+
+fn decrement(array: &JArray) -> Result<JArray, EvaluationError> {
+    scalar_dyad::<Plus>(array, &JArray::scalar(-1))
+}
+
+// Floor (<.) and ceiling (>.): tolerant, so a float within the comparison
+// tolerance of an integer rounds to that integer
+fn floor(array: &JArray) -> Result<JArray, EvaluationError> {
+    round_with(array, "Floor", f64::floor)
+}
+
+fn ceiling(array: &JArray) -> Result<JArray, EvaluationError> {
+    round_with(array, "Ceiling", f64::ceil)
+}
+
+fn round_with(array: &JArray, operation: &str, round: fn(f64) -> f64) -> Result<JArray, EvaluationError> {
+    if numeric_class(array, operation)? == NumericClass::Integer {
+        return Ok(array.clone());
+    }
+    Ok(map_values(array, |value| {
+        let x = f64::read(value);
+        let nearest = x.round();
+        let rounded = if tolerantly_equal(x, nearest) { nearest } else { round(x) };
+        if rounded >= i32::MIN as f64 && rounded <= i32::MAX as f64 {
+            JValue::Integer(rounded as i32)
+        } else {
+            JValue::Float(rounded)
+        }
+    }))
+}
+
+// Apply an elementwise function to the values an array stores, keeping
+// compressed layouts compressed
+fn map_values<F: Fn(&JValue) -> JValue>(array: &JArray, f: F) -> JArray {
+    let shape = array.shape.clone();
+    match &array.layout {
+        Layout::Repeated(pattern) => JArray::repeated(pattern.iter().map(&f).collect(), shape),
+        Layout::Runs(runs) => {
+            JArray::from_runs(Runs::from_runs(runs.values.iter().map(&f).collect(), runs.ends.clone()), shape)
+        }
+        Layout::Sparse(sparse) => {
+            let values = sparse.values.iter().map(&f).collect();
+            JArray::from_sparse(Sparse::from_entries(sparse.indices.clone(), values, f(&sparse.fill), sparse.len()), shape)
+        }
+        _ => JArray::from_data(array.elements().map(|value| f(&value)).collect(), shape),
+    }
+}
+
+// Open verb (>): the contents of a boxed atom; other arrays are unchanged
+fn open(array: &JArray) -> Result<JArray, EvaluationError> {
+    Ok(array.unbox().cloned().unwrap_or_else(|| array.clone()))
+}
+
+// DYADIC VERBS
+
+// Plus verb (+): Element-wise addition
+fn plus(left: &JArray, right: &JArray) -> Result<JArray, EvaluationError> {
+    scalar_dyad::<Plus>(left, right)
+}
+
+// Reshape verb ($): Reshape array to new dimensions, cycling its elements
+fn reshape(shape_array: &JArray, data_array: &JArray) -> Result<JArray, EvaluationError> {
+    // Extract shape dimensions
+    let new_dims: Result<Vec<usize>, _> = shape_array.elements()
+        .map(|v| match v.to_integer() {
+            Some(i) if i >= 0 => Ok(i as usize),
+            Some(_) => Err(EvaluationError::DomainError("Shape must not be negative".to_string())),
+            None => Err(EvaluationError::DomainError("Shape must contain integers".to_string())),
+        })
+        .collect();
+
+    let new_shape = ArrayShape { dimensions: new_dims? };
+    Ok(data_array.reshape(new_shape)?)
+}
+
+// Copy verb (#): Repeat each item of the right argument the number of times
+// given by the left (an atom applies to every item). A boolean left argument
+// compresses: the items under 1s are kept, the rest dropped.
+fn copy(counts: &JArray, source: &JArray) -> Result<JArray, EvaluationError> {
+    if counts.shape.rank() > 1 {
+        return Err(EvaluationError::RankError("Copy requires an atom or a list on the left".to_string()));
+    }
+    let items = source.tally();
+    let item_shape = source.shape.dimensions.get(1..).unwrap_or(&[]).to_vec();
+    let item_size: usize = item_shape.iter().product();
+    if counts.element_count() != 1 && counts.element_count() != items {
+        return Err(EvaluationError::DimensionMismatch(format!(
+            "Length error: {} counts for {} items", counts.element_count(), items
+        )));
+    }
+
+    // The result is sized from the counts alone, so check it before gathering
+    let spans = copy_spans(counts, items)?;
+    let total_items = spans.iter()
+        .try_fold(0usize, |total, span| (span.end - span.start).checked_mul(span.times).and_then(|n| total.checked_add(n)))
+        .ok_or(ArrayError::TooLarge(None))?;
+    check_elements(total_items.checked_mul(item_size))?;
+    let mut dimensions = vec![total_items];
+    dimensions.extend_from_slice(&item_shape);
+    let shape = ArrayShape { dimensions };
+
+    // Packed integers are gathered from the narrow buffer and packed again
+    if let Some(packed) = source.packed() {
+        fn widened<T: PackedElement>(values: Vec<T>) -> Vec<i32> {
+            values.into_iter().map(|v| v.widen()).collect()
+        }
+        let ints = match &packed.ints {
+            PackedInts::I8(values) => widened(gather_spans(values, &spans, item_size, total_items)),
+            PackedInts::I16(values) => widened(gather_spans(values, &spans, item_size, total_items)),
+            PackedInts::I32(values) => gather_spans(values, &spans, item_size, total_items),
+        };
+        return Ok(JArray::from_ints(ints, shape));
+    }
+    if let Some(parts) = source.complex() {
+        let re = gather_spans(&parts.re, &spans, item_size, total_items);
+        let im = gather_spans(&parts.im, &spans, item_size, total_items);
+        return Ok(JArray::from_complex(re, im, shape));
+    }
+    let source = source.to_dense();
+    Ok(JArray::from_data(gather_spans(&source.data, &spans, item_size, total_items), shape))
+}
+
+// A range of items copied `times` times each. Consecutive items kept once
+// are merged into one span, so a compress copies whole stretches at a time.
+struct CopySpan {
+    start: usize,
+    end: usize,
+    times: usize,
+}
+
+fn copy_spans(counts: &JArray, items: usize) -> Result<Vec<CopySpan>, EvaluationError> {
+    let count_at = |value: &JValue| -> Result<usize, EvaluationError> {
+        match value {
+            JValue::Integer(n) if *n >= 0 => Ok(*n as usize),
+            JValue::Integer(_) => Err(EvaluationError::DomainError("Copy counts must not be negative".to_string())),
+            _ => Err(EvaluationError::DomainError("Copy counts must be integers".to_string())),
+        }
+    };
+    let mut spans: Vec<CopySpan> = Vec::new();
+    let mut push = |start: usize, end: usize, times: usize| {
+        match spans.last_mut() {
+            _ if times == 0 || start == end => {}
+            Some(last) if times == 1 && last.times == 1 && last.end == start => last.end = end,
+            _ if times == 1 => spans.push(CopySpan { start, end, times }),
+            _ => spans.extend((start..end).map(|i| CopySpan { start: i, end: i + 1, times })),
+        }
+    };
+
+    if counts.element_count() == 1 {
+        push(0, items, count_at(&counts.value(0))?);
+    } else if let Some(runs) = counts.runs() {
+        let mut start = 0;
+        for (value, length) in runs.iter() {
+            push(start, start + length, count_at(value)?);
+            start += length;
+        }
+    } else if let Some(packed) = counts.packed() {
+        if packed.min < 0 {
+            return Err(EvaluationError::DomainError("Copy counts must not be negative".to_string()));
+        }
+        for i in 0..items {
+            push(i, i + 1, packed.get(i) as usize);
+        }
+    } else {
+        for (i, value) in counts.elements().enumerate() {
+            push(i, i + 1, count_at(&value)?);
+        }
+    }
+    Ok(spans)
+}
+
+// Copy the spans of items out of row-major `values`, presized to the result
+fn gather_spans<T: Clone>(values: &[T], spans: &[CopySpan], item_size: usize, total_items: usize) -> Vec<T> {
+    let mut result = Vec::with_capacity(total_items * item_size);
+    for span in spans {
+        let slice = &values[span.start * item_size..span.end * item_size];
+        for _ in 0..span.times {
+            result.extend_from_slice(slice);
+        }
+    }
+    result
+}
+
+// From verb ({): Index selection
+fn from(indices: &JArray, source: &JArray) -> Result<JArray, EvaluationError> {
+    Ok(source.select_from(indices)?)
+}
+
+// Minus and times (- *): elementwise, promoting to float on overflow
+fn minus(left: &JArray, right: &JArray) -> Result<JArray, EvaluationError> {
+    scalar_dyad::<Minus>(left, right)
+}
+
+fn times(left: &JArray, right: &JArray) -> Result<JArray, EvaluationError> {
+    scalar_dyad::<Times>(left, right)
+}
+
+// Append verb (,): Join arrays along the leading axis
+fn append(left: &JArray, right: &JArray) -> Result<JArray, EvaluationError> {
+    Ok(left.concatenate(right)?)
+}
+
+// Comparison verbs (= ~: < <: > >:): Element-wise, tolerant on floats
+fn equal(left: &JArray, right: &JArray) -> Result<JArray, EvaluationError> {
+    scalar_dyad::<Equal>(left, right)
+}
+
+fn not_equal(left: &JArray, right: &JArray) -> Result<JArray, EvaluationError> {
+    scalar_dyad::<NotEqual>(left, right)
+}
+
+fn less_than(left: &JArray, right: &JArray) -> Result<JArray, EvaluationError> {
+    scalar_dyad::<LessThan>(left, right)
+}
+
+fn less_or_equal(left: &JArray, right: &JArray) -> Result<JArray, EvaluationError> {
+    scalar_dyad::<LessOrEqual>(left, right)
+}
+
+fn greater_than(left: &JArray, right: &JArray) -> Result<JArray, EvaluationError> {
+    scalar_dyad::<GreaterThan>(left, right)
+}
+
+fn greater_or_equal(left: &JArray, right: &JArray) -> Result<JArray, EvaluationError> {
+    scalar_dyad::<GreaterOrEqual>(left, right)
+}
+
+// Minimum (<.) and maximum (>.)
+fn minimum(left: &JArray, right: &JArray) -> Result<JArray, EvaluationError> {
+    scalar_dyad::<Minimum>(left, right)
+}
+
+fn maximum(left: &JArray, right: &JArray) -> Result<JArray, EvaluationError> {
+    scalar_dyad::<Maximum>(left, right)
+}
+
+// TABLES
+
+// Elements of the right argument per tile: a tile stays in L1 cache while
+// every value of the left argument is broadcast across it
+const TABLE_TILE: usize = 4096;
+
+// Table (x f/ y) of a scalar dyad: f of every atom of x with every atom of y,
+// shaped x's shape followed by y's. The output is allocated once at its
+// final size and filled a tile of y at a time. Integer tables whose range is
+// known in advance (comparisons, monotone dyads) are written straight into
+// the narrowest packed width.
+fn table<K: ScalarDyad>(left: &JArray, right: &JArray) -> Result<JArray, EvaluationError> {
+    let mut dimensions = left.shape.dimensions.clone();
+    dimensions.extend_from_slice(&right.shape.dimensions);
+    let shape = ArrayShape { dimensions };
+    let count = check_elements(shape.checked_elements())?;
+    if is_complex(left) || is_complex(right) {
+        // Each atom of x meets the whole of y, as under agreement once y is
+        // repeated to the table's shape
+        return complex_dyad::<K>(left, &right.reshape(shape)?);
+    }
+    let classes = (numeric_class(left, K::NAME)?, numeric_class(right, K::NAME)?);
+
+    if classes == (NumericClass::Integer, NumericClass::Integer) {
+        let (left, right) = (read_elements::<i32>(left), read_elements::<i32>(right));
+        let pair = |a, b| K::int(a, b).unwrap_or(0);
+        match table_range::<K>(&left, &right) {
+            Some((low, high)) if low >= i8::MIN as i32 && high <= i8::MAX as i32 => {
+                let mut out = vec![0i8; count];
+                fill_table(&left, &right, &mut out, |a, b| pair(a, b) as i8);
+                return Ok(JArray::from_packed(PackedInts::I8(out), shape));
+            }
+            Some((low, high)) if low >= i16::MIN as i32 && high <= i16::MAX as i32 => {
+                let mut out = vec![0i16; count];
+                fill_table(&left, &right, &mut out, |a, b| pair(a, b) as i16);
+                return Ok(JArray::from_packed(PackedInts::I16(out), shape));
+            }
+            Some(_) => {
+                let mut out = vec![0i32; count];
+                fill_table(&left, &right, &mut out, pair);
+                return Ok(JArray::from_packed(PackedInts::I32(out.into()), shape));
+            }
+            None => {
+                let overflowed = std::cell::Cell::new(false);
+                let mut out = vec![0i32; count];
+                fill_table(&left, &right, &mut out, |a, b| K::int(a, b).unwrap_or_else(|| {
+                    overflowed.set(true);
+                    0
+                }));
+                if !overflowed.get() {
+                    return Ok(JArray::from_ints(out, shape));
+                }
+            }
+        }
+    }
+
+    // Floats, or integers that overflowed
+    let (left, right) = (read_elements::<f64>(left), read_elements::<f64>(right));
+    if K::PREDICATE {
+        let mut out = vec![0i8; count];
+        fill_table(&left, &right, &mut out, |a, b| matches!(K::float(a, b), JValue::Integer(1)) as i8);
+        return Ok(JArray::from_packed(PackedInts::I8(out), shape));
+    }
+    let mut out = vec![JValue::Integer(0); count];
+    fill_table(&left, &right, &mut out, K::float);
+    Ok(JArray::from_data(out, shape))
+}
+
+fn read_elements<T: Element>(array: &JArray) -> Vec<T> {
+    match array.packed() {
+        Some(packed) => (0..packed.len()).map(|i| T::read(&JValue::Integer(packed.get(i)))).collect(),
+        None => array.elements().map(|value| T::read(&value)).collect(),
+    }
+}
+
+// Bounds of every integer result of K over the two arguments, when they
+// can be known without computing the results
+fn table_range<K: ScalarDyad>(left: &[i32], right: &[i32]) -> Option<(i32, i32)> {
+    if K::PREDICATE {
+        return Some((0, 1));
+    }
+    if !K::MONOTONE {
+        return None;
+    }
+    let bounds = |values: &[i32]| Some((*values.iter().min()?, *values.iter().max()?));
+    let ((left_low, left_high), (right_low, right_high)) = match (bounds(left), bounds(right)) {
+        (Some(left), Some(right)) => (left, right),
+        _ => return Some((0, 0)), // an empty table
+    };
+    let corners = [
+        K::int(left_low, right_low)?,
+        K::int(left_low, right_high)?,
+        K::int(left_high, right_low)?,
+        K::int(left_high, right_high)?,
+    ];
+    Some((*corners.iter().min()?, *corners.iter().max()?))
+}
+
+// Fill `out`, rows of right.len() elements, with f of every pair
+fn fill_table<A: Copy, B: Copy, O>(left: &[A], right: &[B], out: &mut [O], f: impl Fn(A, B) -> O) {
+    let width = right.len();
+    for tile_start in (0..width).step_by(TABLE_TILE) {
+        let tile = &right[tile_start..(tile_start + TABLE_TILE).min(width)];
+        for (row, &a) in left.iter().enumerate() {
+            let start = row * width + tile_start;
+            for (slot, &b) in out[start..start + tile.len()].iter_mut().zip(tile) {
+                *slot = f(a, b);
+            }
+        }
+    }
+}
+
+// REPETITION
+
+// f^:n for the scalar verbs. Their monads step by a constant (increment and
+// decrement are 1&+ and _1&+), change nothing (conjugate) or are idempotent
+// (floor and ceiling), so none needs the general loop either.
+fn plus_iterate(left: Option<&JArray>, right: &JArray, repeat: Repeat) -> Result<Option<JArray>, EvaluationError> {
+    match left {
+        Some(left) => iterate_dyad::<Plus>(left, right, repeat),
+        None => Ok(Some(right.clone())),
+    }
+}
+
+fn less_or_equal_iterate(left: Option<&JArray>, right: &JArray, repeat: Repeat) -> Result<Option<JArray>, EvaluationError> {
+    match left {
+        Some(left) => iterate_dyad::<LessOrEqual>(left, right, repeat),
+        None => iterate_dyad::<Plus>(&JArray::scalar(-1), right, repeat),
+    }
+}
+
+fn greater_or_equal_iterate(left: Option<&JArray>, right: &JArray, repeat: Repeat) -> Result<Option<JArray>, EvaluationError> {
+    match left {
+        Some(left) => iterate_dyad::<GreaterOrEqual>(left, right, repeat),
+        None => iterate_dyad::<Plus>(&JArray::scalar(1), right, repeat),
+    }
+}
+
+fn minimum_iterate(left: Option<&JArray>, right: &JArray, repeat: Repeat) -> Result<Option<JArray>, EvaluationError> {
+    match (left, repeat) {
+        (Some(left), _) => iterate_dyad::<Minimum>(left, right, repeat),
+        (None, Repeat::Times(0)) => Ok(Some(right.clone())),
+        (None, _) => floor(right).map(Some),
+    }
+}
+
+fn maximum_iterate(left: Option<&JArray>, right: &JArray, repeat: Repeat) -> Result<Option<JArray>, EvaluationError> {
+    match (left, repeat) {
+        (Some(left), _) => iterate_dyad::<Maximum>(left, right, repeat),
+        (None, Repeat::Times(0)) => Ok(Some(right.clone())),
+        (None, _) => ceiling(right).map(Some),
+    }
+}
+
+// Verbs whose monad has nothing to gain from a kernel
+fn iterate<K: ScalarDyad>(left: Option<&JArray>, right: &JArray, repeat: Repeat) -> Result<Option<JArray>, EvaluationError> {
+    match left {
+        Some(left) => iterate_dyad::<K>(left, right, repeat),
+        None => Ok(None),
+    }
+}
+
+// x K^:n y for numeric x that is an atom or shaped like y. x is read once,
+// and the iterations alternate between two buffers, so none of them
+// allocates. Integers move to floats at the first overflow, carrying on
+// from the last exact step.
+fn iterate_dyad<K: ScalarDyad>(left: &JArray, right: &JArray, repeat: Repeat) -> Result<Option<JArray>, EvaluationError> {
+    if left.shape.rank() != 0 && left.shape != right.shape {
+        return Ok(None);
+    }
+    let classes = (numeric_class(left, K::NAME), numeric_class(right, K::NAME));
+    let integers = match classes {
+        (Ok(NumericClass::Integer), Ok(NumericClass::Integer)) => true,
+        // Float comparisons give integer flags, which the float buffers cannot hold
+        (Ok(_), Ok(_)) if !K::PREDICATE => false,
+        _ => return Ok(None),
+    };
+    let no_fixed_point = || EvaluationError::DomainError(format!(
+        "{} did not reach a fixed point within {} iterations", K::NAME, FIXED_POINT_LIMIT
+    ));
+
+    let (mut current, repeat) = if integers {
+        let mut current = read_elements::<i32>(right);
+        match run_buffered(&read_elements::<i32>(left), &mut current, repeat, K::int, |a, b| a == b) {
+            Run::Finished => return Ok(Some(JArray::from_ints(current, right.shape.clone()))),
+            Run::Unsettled => return Err(no_fixed_point()),
+            Run::Overflowed { completed } => {
+                let repeat = match repeat {
+                    Repeat::Times(times) => Repeat::Times(times - completed),
+                    Repeat::FixedPoint => Repeat::FixedPoint,
+                };
+                (current.into_iter().map(f64::from).collect(), repeat)
+            }
+        }
+    } else {
+        (read_elements::<f64>(right), repeat)
+    };
+    let step = |a: f64, b: f64| Some(f64::read(&K::float(a, b)));
+    match run_buffered(&read_elements::<f64>(left), &mut current, repeat, step, tolerantly_equal) {
+        Run::Unsettled => Err(no_fixed_point()),
+        _ => Ok(Some(JArray::from_data(current.into_iter().map(JValue::Float).collect(), right.shape.clone()))),
+    }
+}
+
+enum Run {
+    Finished,
+    // No fixed point within FIXED_POINT_LIMIT
+    Unsettled,
+    // A step failed after `completed` full iterations, whose result is kept
+    Overflowed { completed: usize },
+}
+
+// Apply step(x, value) to every value `repeat` times. Each iteration reads
+// `current` and writes the other buffer, then the two swap; keeping the
+// previous result intact is what lets a fixed point, or an overflow part
+// way through an iteration, be detected.
+fn run_buffered<T: Copy>(
+    left: &[T],
+    current: &mut Vec<T>,
+    repeat: Repeat,
+    step: impl Fn(T, T) -> Option<T>,
+    same: impl Fn(T, T) -> bool,
+) -> Run {
+    let limit = match repeat {
+        Repeat::Times(times) => times,
+        Repeat::FixedPoint => FIXED_POINT_LIMIT,
+    };
+    let mut next = current.clone();
+    for iteration in 0..limit {
+        let mut changed = false;
+        let mut apply = |slot: &mut T, value: T, x: T| match step(x, value) {
+            Some(result) => {
+                changed |= !same(result, value);
+                *slot = result;
+                true
+            }
+            None => false,
+        };
+        let mut pairs = next.iter_mut().zip(current.iter());
+        let stepped = match left {
+            [x] => pairs.all(|(slot, &value)| apply(slot, value, *x)),
+            _ => pairs.zip(left).all(|((slot, &value), &x)| apply(slot, value, x)),
+        };
+        if !stepped {
+            return Run::Overflowed { completed: iteration };
+        }
+        if repeat == Repeat::FixedPoint && !changed {
+            return Run::Finished;
+        }
+        std::mem::swap(current, &mut next);
+    }
+    match repeat {
+        Repeat::Times(_) => Run::Finished,
+        Repeat::FixedPoint => Run::Unsettled,
+    }
+}
+
+// REDUCTIONS
+
+// Sum (+/): add the items of an array along an axis. Compressed layouts are
+// summed without expanding them: runs and repeated patterns multiply each
+// value by its count, sparse arrays add their entries and account for the
+// fill per result position.
+fn sum(array: &JArray, axis: usize) -> Result<JArray, EvaluationError> {
+    if array.shape.rank() == 0 {
+        return Ok(array.clone());
+    }
+    let class = match numeric_class(array, "Sum") {
+        Ok(class) => class,
+        Err(_) if is_complex(array) => return complex_fold::<Plus>(array, axis),
+        Err(error) => return Err(error),
+    };
+    let along = Axis::new(&array.shape, axis);
+    if let Some(totals) = sum_small_cells(class, array, &along) {
+        return Ok(totals.into_array(along.result_shape(&array.shape)));
+    }
+    let cells = along.cells();
+    if cells == 1 && class == NumericClass::Float {
+        if let Some(total) = float_total(array, reduction()) {
+            return Ok(JArray::from_data(vec![JValue::Float(total)], along.result_shape(&array.shape)));
+        }
+    }
+    let mut totals = SumCells::new(class, cells);
+
+    match &array.layout {
+        Layout::Sparse(sparse) => {
+            let mut stored_per_cell = vec![0usize; cells];
+            for (index, value) in sparse.entries() {
+                totals.add(along.position(index), value, 1);
+                stored_per_cell[along.position(index)] += 1;
+            }
+            for (position, stored) in stored_per_cell.into_iter().enumerate() {
+                totals.add(position, &sparse.fill, along.items - stored);
+            }
+        }
+        Layout::Runs(runs) if cells == 1 => {
+            for (value, length) in runs.iter() {
+                totals.add(0, value, length);
+            }
+        }
+        Layout::Repeated(pattern) if cells == 1 => {
+            let (whole, rest) = (along.items / pattern.len(), along.items % pattern.len());
+            for (k, value) in pattern.iter().enumerate() {
+                totals.add(0, value, whole + (k < rest) as usize);
+            }
+        }
+        Layout::Packed(packed) => {
+            for index in 0..packed.len() {
+                totals.add_int(along.position(index), packed.get(index) as i64, 1);
+            }
+        }
+        _ => {
+            for (index, value) in array.elements().enumerate() {
+                totals.add(along.position(index), &value, 1);
+            }
+        }
+    }
+    Ok(totals.into_array(along.result_shape(&array.shape)))
+}
+
+// How a long float sum is split up. Fast gives each available thread one
+// chunk and adds the chunk totals, so the rounding depends on the thread
+// count; Reproducible adds fixed blocks of REDUCTION_BLOCK values and combines
+// the block totals pairwise in a fixed tree, so the same values give the same
+// bits on any machine, whatever their layout.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum Reduction {
+    Fast,
+    Reproducible,
+}
+
+pub const REDUCTION_BLOCK: usize = 1 << 12;
+
+// Lists shorter than this are reduced on the calling thread
+const PARALLEL_MIN_VALUES: usize = 1 << 16;
+
+thread_local! {
+    static REDUCTION: std::cell::Cell<Reduction> = const { std::cell::Cell::new(Reduction::Fast) };
+}
+
+// The reduction mode of the evaluation running on this thread
+pub fn reduction() -> Reduction {
+    REDUCTION.with(|mode| mode.get())
+}
+
+// Run `f` with float sums in the given mode, restoring the previous mode
+// afterwards. Code that spawns evaluation threads passes reduction() on.
+pub fn with_reduction<T>(mode: Reduction, f: impl FnOnce() -> T) -> T {
+    struct Restore(Reduction);
+    impl Drop for Restore {
+        fn drop(&mut self) {
+            REDUCTION.with(|mode| mode.set(self.0));
+        }
+    }
+    let _restore = Restore(REDUCTION.with(|current| current.replace(mode)));
+    f()
+}
+
+// The total of a float list, or None when the general loop should add it
+// (a short or compressed list in fast mode)
+fn float_total(array: &JArray, mode: Reduction) -> Option<f64> {
+    let threads = available_threads();
+    match (mode, &array.layout) {
+        (Reduction::Fast, Layout::Dense) if array.data.len() >= PARALLEL_MIN_VALUES && threads > 1 => {
+            Some(sum_floats(&array.data, f64::read, mode, threads))
+        }
+        (Reduction::Fast, _) => None,
+        (Reduction::Reproducible, Layout::Dense) => Some(sum_floats(&array.data, f64::read, mode, threads)),
+        (Reduction::Reproducible, _) => {
+            let values: Vec<f64> = array.elements().map(|value| f64::read(&value)).collect();
+            Some(sum_floats(&values, |&value| value, mode, threads))
+        }
+    }
+}
+
+pub fn available_threads() -> usize {
+    #[cfg(not(target_arch = "wasm32"))]
+    return std::thread::available_parallelism().map_or(1, |n| n.get());
+    #[cfg(target_arch = "wasm32")]
+    return 1;
+}
+
+// Add `values` in the given mode using up to `threads` threads. In
+// reproducible mode the threads only decide who adds which blocks, never
+// how the blocks are grouped.
+pub fn sum_floats<T: Sync>(values: &[T], read: impl Fn(&T) -> f64 + Sync, mode: Reduction, threads: usize) -> f64 {
+    let add = |part: &[T]| part.iter().fold(0.0, |total, value| total + read(value));
+    match mode {
+        Reduction::Fast => {
+            let chunk = values.len().div_ceil(threads.max(1)).max(1);
+            in_parallel(values, chunk, threads, &add).into_iter().fold(0.0, |total, part| total + part)
+        }
+        Reduction::Reproducible => {
+            let blocks = values.len().div_ceil(REDUCTION_BLOCK).max(1);
+            let per_thread = blocks.div_ceil(threads.max(1)) * REDUCTION_BLOCK;
+            let mut totals: Vec<f64> = in_parallel(values, per_thread, threads, &|part: &[T]| {
+                part.chunks(REDUCTION_BLOCK).map(add).collect::<Vec<_>>()
+            }).into_iter().flatten().collect();
+            while totals.len() > 1 {
+                totals = totals.chunks(2).map(|pair| pair.iter().sum()).collect();
+            }
+            totals.first().copied().unwrap_or(0.0)
+        }
+    }
+}
+
+// Apply `f` to consecutive chunks of `values`, in order, on scoped threads
+// when there is enough work to share. A panic in `f` carries on unwinding
+// in the caller, as it would have without the threads.
+pub fn in_parallel<T: Sync, R: Send>(values: &[T], chunk: usize, threads: usize, f: &(impl Fn(&[T]) -> R + Sync)) -> Vec<R> {
+    let chunk = chunk.max(1);
+    #[cfg(not(target_arch = "wasm32"))]
+    if threads > 1 && values.len() >= PARALLEL_MIN_VALUES && values.len() > chunk {
+        return std::thread::scope(|scope| {
+            let handles: Vec<_> = values.chunks(chunk).map(|part| scope.spawn(move || f(part))).collect();
+            handles.into_iter()
+                .map(|handle| handle.join().unwrap_or_else(|payload| std::panic::resume_unwind(payload)))
+                .collect()
+        });
+    }
+    let _ = threads;
+    values.chunks(chunk).map(f).collect()
+}
+
+// Insert a scalar dyad between complex items, over the real and imaginary
+// buffers; an empty axis leaves zeros, the identity of sum
+fn complex_fold<K: ScalarDyad>(array: &JArray, axis: usize) -> Result<JArray, EvaluationError> {
+    let parts = complex_parts(array, K::NAME)?;
+    let along = Axis::new(&array.shape, axis);
+    let (mut re, mut im) = (vec![0.0; along.cells()], vec![0.0; along.cells()]);
+    for index in 0..parts.len() {
+        let position = along.position(index);
+        let value = (parts.re[index], parts.im[index]);
+        (re[position], im[position]) = if along.is_first(index) {
+            value
+        } else {
+            K::complex((re[position], im[position]), value)
+        };
+    }
+    Ok(JArray::from_complex(re, im, along.result_shape(&array.shape)))
+}
+
+// Sums over the rows of a batch of short vectors (+/"1) or the columns of a
+// batch of small square matrices (+/"2), with each cell's totals kept in a
+// fixed-size accumulator instead of being indexed per element
+fn sum_small_cells(class: NumericClass, array: &JArray, along: &Axis) -> Option<SumCells> {
+    match (along.items, along.inner) {
+        (2, 1) => sum_small::<2, 1>(class, array),
+        (3, 1) => sum_small::<3, 1>(class, array),
+        (4, 1) => sum_small::<4, 1>(class, array),
+        (2, 2) => sum_small::<2, 2>(class, array),
+        (3, 3) => sum_small::<3, 3>(class, array),
+        (4, 4) => sum_small::<4, 4>(class, array),
+        _ => None,
+    }
+}
+
+fn sum_small<const ITEMS: usize, const INNER: usize>(class: NumericClass, array: &JArray) -> Option<SumCells> {
+    let ints = |ints| Some(SumCells { ints: Some(ints), floats: Vec::new() });
+    match (&array.layout, class) {
+        (Layout::Packed(packed), _) => match &packed.ints {
+            PackedInts::I8(values) => ints(sum_cells::<_, _, ITEMS, INNER>(values, |v| v.widen() as i64)),
+            PackedInts::I16(values) => ints(sum_cells::<_, _, ITEMS, INNER>(values, |v| v.widen() as i64)),
+            PackedInts::I32(values) => ints(sum_cells::<_, _, ITEMS, INNER>(values, |&v| v as i64)),
+        },
+        (Layout::Dense, NumericClass::Integer) => ints(sum_cells::<_, _, ITEMS, INNER>(&array.data, |v| i32::read(v) as i64)),
+        (Layout::Dense, NumericClass::Float) => {
+            Some(SumCells { ints: None, floats: sum_cells::<_, _, ITEMS, INNER>(&array.data, f64::read) })
+        }
+        _ => None,
+    }
+}
+
+#[inline]
+fn sum_cells<T, A, const ITEMS: usize, const INNER: usize>(values: &[T], read: impl Fn(&T) -> A) -> Vec<A>
+where
+    A: Copy + Default + std::ops::AddAssign,
+{
+    let mut totals = Vec::with_capacity(values.len() / ITEMS);
+    for cell in values.chunks_exact(ITEMS * INNER) {
+        let mut accumulator = [A::default(); INNER];
+        for item in 0..ITEMS {
+            for (total, value) in accumulator.iter_mut().zip(&cell[item * INNER..]) {
+                *total += read(value);
+            }
+        }
+        totals.extend_from_slice(&accumulator);
+    }
+    totals
+}
+
+// Join (,/): append the items along an axis to each other, which runs that
+// axis and the next together; no intermediate results are built
+fn join_items(array: &JArray, axis: usize) -> Result<JArray, EvaluationError> {
+    let mut dimensions = array.shape.dimensions.clone();
+    if axis + 1 < dimensions.len() {
+        let items = dimensions.remove(axis);
+        dimensions[axis] *= items;
+    }
+    Ok(JArray { data: array.data.clone(), shape: ArrayShape { dimensions }, layout: array.layout.clone() })
+}
+
+// Product (*/) of the items of an array
+fn product(array: &JArray, axis: usize) -> Result<JArray, EvaluationError> {
+    fold_items::<Times>(array, axis)
+}
+
+// Minimum and maximum (<./ and >./) of the items of an array
+fn minimum_insert(array: &JArray, axis: usize) -> Result<JArray, EvaluationError> {
+    fold_items::<Minimum>(array, axis)
+}
+
+fn maximum_insert(array: &JArray, axis: usize) -> Result<JArray, EvaluationError> {
+    fold_items::<Maximum>(array, axis)
+}
+
+// Insert a scalar dyad between the items along an axis of an array with at
+// least one item there, combining in one pass over the elements. Folding
+// left to right gives J's right-to-left result only because the dyads used
+// here are associative and commutative.
+fn fold_items<K: ScalarDyad>(array: &JArray, axis: usize) -> Result<JArray, EvaluationError> {
+    if array.shape.rank() == 0 {
+        return Ok(array.clone());
+    }
+    let class = match numeric_class(array, K::NAME) {
+        Ok(class) => class,
+        Err(_) if K::COMPLEX && is_complex(array) => return complex_fold::<K>(array, axis),
+        Err(error) => return Err(error),
+    };
+    let along = Axis::new(&array.shape, axis);
+    let shape = along.result_shape(&array.shape);
+
+    if class == NumericClass::Integer {
+        let mut totals = vec![0i32; along.cells()];
+        let mut overflowed = false;
+        for index in 0..array.element_count() {
+            let (total, value) = (&mut totals[along.position(index)], i32::read(&array.value(index)));
+            if along.is_first(index) {
+                *total = value;
+            } else {
+                match K::int(*total, value) {
+                    Some(value) => *total = value,
+                    None => overflowed = true,
+                }
+            }
+        }
+        if !overflowed {
+            return Ok(JArray::from_ints(totals, shape));
+        }
+    }
+    let mut totals = vec![JValue::Integer(0); along.cells()];
+    for index in 0..array.element_count() {
+        let (total, value) = (&mut totals[along.position(index)], f64::read(&array.value(index)));
+        *total = if along.is_first(index) { JValue::Float(value) } else { K::float(f64::read(total), value) };
+    }
+    Ok(JArray::from_data(totals, shape))
+}
+
+// Where each element lands when the items along one axis are combined: the
+// array is `outer` blocks of `items` items of `inner` values, and the result
+// keeps one value per (block, inner offset)
+struct Axis {
+    axis: usize,
+    outer: usize,
+    items: usize,
+    inner: usize,
+}
+
+impl Axis {
+    fn new(shape: &ArrayShape, axis: usize) -> Self {
+        let dimensions = &shape.dimensions;
+        Axis {
+            axis,
+            outer: dimensions[..axis].iter().product(),
+            items: dimensions[axis],
+            inner: dimensions[axis + 1..].iter().product(),
+        }
+    }
+
+    fn cells(&self) -> usize {
+        self.outer * self.inner
+    }
+
+    #[inline]
+    fn position(&self, index: usize) -> usize {
+        index / (self.items * self.inner) * self.inner + index % self.inner
+    }
+
+    #[inline]
+    fn is_first(&self, index: usize) -> bool {
+        index % (self.items * self.inner) < self.inner
+    }
+
+    fn result_shape(&self, shape: &ArrayShape) -> ArrayShape {
+        let mut dimensions = shape.dimensions.clone();
+        dimensions.remove(self.axis);
+        ArrayShape { dimensions }
+    }
+}
+
+// Per-cell accumulators: i64 for integer arrays (narrowed back to i32 when
+// the totals fit), f64 otherwise or once an i64 total would overflow
+struct SumCells {
+    ints: Option<Vec<i64>>,
+    floats: Vec<f64>,
+}
+
+impl SumCells {
+    fn new(class: NumericClass, cells: usize) -> Self {
+        match class {
+            NumericClass::Integer => SumCells { ints: Some(vec![0; cells]), floats: Vec::new() },
+            NumericClass::Float => SumCells { ints: None, floats: vec![0.0; cells] },
+        }
+    }
+
+    #[inline]
+    fn add(&mut self, position: usize, value: &JValue, count: usize) {
+        match &mut self.ints {
+            Some(_) => self.add_int(position, i32::read(value) as i64, count),
+            None => self.floats[position] += f64::read(value) * count as f64,
+        }
+    }
+
+    #[inline]
+    fn add_int(&mut self, position: usize, value: i64, count: usize) {
+        if let Some(ints) = &mut self.ints {
+            let total = i64::try_from(count).ok()
+                .and_then(|count| value.checked_mul(count))
+                .and_then(|scaled| ints[position].checked_add(scaled));
+            if let Some(total) = total {
+                ints[position] = total;
+                return;
+            }
+            self.promote();
+        }
+        self.floats[position] += value as f64 * count as f64;
+    }
+
+    // Carry on in floats, as the integer kernels do when a result overflows
+    fn promote(&mut self) {
+        if let Some(ints) = self.ints.take() {
+            self.floats = ints.into_iter().map(|t| t as f64).collect();
+        }
+    }
+
+    fn into_array(self, shape: ArrayShape) -> JArray {
+        match self.ints {
+            Some(ints) if ints.iter().all(|&t| i32::try_from(t).is_ok()) => {
+                JArray::from_ints(ints.into_iter().map(|t| t as i32).collect(), shape)
+            }
+            Some(ints) => JArray::from_data(ints.into_iter().map(|t| JValue::Float(t as f64)).collect(), shape),
+            None => JArray::from_data(self.floats.into_iter().map(JValue::Float).collect(), shape),
+        }
+    }
+}
@@ -25,6 +25,14 @@ impl ParseTreeVisualizer {
                 format!("{}Literal: {}", indent, self.format_array(array))
             }
             
+            JNode::Name(name) => {
+                format!("{}Name: {}", indent, name)
+            }
+            
+            JNode::Local(slot, name) => {
+                format!("{}Local: {} (slot {})", indent, name, slot)
+            }
+            
             JNode::MonadicVerb(verb, arg) => {
                 format!("{}MonadicVerb: '{}'\n{}", 
                     indent, 
@@ -42,6 +50,24 @@ impl ParseTreeVisualizer {
                 )
             }
             
+            JNode::DerivedVerb(verb, left, right) => {
+                let mut result = format!("{}DerivedVerb: '{}'", indent, verb);
+                if let Some(left_node) = left {
+                    result.push_str(&format!("\n{}", self.visualize_node(left_node, depth + 1)));
+                }
+                result.push_str(&format!("\n{}", self.visualize_node(right, depth + 1)));
+                result
+            }
+            
+            JNode::Shared(common, body) => {
+                let mut result = format!("{}Shared:", indent);
+                for node in common {
+                    result.push_str(&format!("\n{}", self.visualize_node(node, depth + 1)));
+                }
+                result.push_str(&format!("\n{}", self.visualize_node(body, depth + 1)));
+                result
+            }
+            
             JNode::AmbiguousVerb(verb, left, right) => {
                 let mut result = format!("{}AmbiguousVerb: '{}'", indent, verb);
                 
@@ -0,0 +1,441 @@
+// Workspace Module
+// Named values, some given directly and some defined by expressions over
+// other names. Each definition records the names it reads, so changing a name
+// recomputes only the definitions downstream of it, in topological order.
+// Propagation stops wherever a recomputed value comes out unchanged, and
+// definitions in the same wave do not read each other, so they are evaluated
+// on separate threads. An update either completes or leaves every value as
+// it was.
+//
+// The server keeps one workspace per client session (WorkspaceStore). When
+// several worker processes serve the port, they share each session through a
+// file of the updates that built it, so a client sees the same names whichever
+// worker takes the request.
+
+use crate::evaluator::Bindings;
+use crate::interpreter::{parse_binding_value, InterpreterError, JInterpreter, PreparedExpression};
+use crate::j_array::JArray;
+use crate::verbs;
+use std::collections::{HashMap, HashSet, VecDeque};
+use std::fs::{self, File, OpenOptions};
+use std::io::{Read, Seek, SeekFrom, Write};
+use std::path::{Path, PathBuf};
+use std::sync::{Arc, Mutex};
+use std::thread;
+
+// Names one workspace may hold
+pub const MAX_NAMES: usize = 1024;
+
+pub struct Workspace {
+    interpreter: JInterpreter,
+    values: Bindings,
+    definitions: HashMap<String, PreparedExpression>,
+    // Reverse edges: the definitions that read each name
+    dependents: HashMap<String, Vec<String>>,
+}
+
+impl Workspace {
+    pub fn new() -> Self {
+        Workspace {
+            interpreter: JInterpreter::new(),
+            values: Bindings::new(),
+            definitions: HashMap::new(),
+            dependents: HashMap::new(),
+        }
+    }
+
+    pub fn get(&self, name: &str) -> Option<&JArray> {
+        self.values.get(name)
+    }
+
+    // Give `name` a value, replacing any definition it had, and recompute
+    // what depends on it. Returns the names whose values changed.
+    pub fn set(&mut self, name: &str, value: JArray) -> Result<Vec<String>, InterpreterError> {
+        self.check_room(name)?;
+        let definition = self.forget_definition(name);
+        if self.values.get(name) == Some(&value) {
+            return Ok(Vec::new());
+        }
+        let previous = self.values.insert(name.to_string(), value);
+        let result = self.propagate(name);
+        if result.is_err() {
+            self.restore(name, previous, definition);
+        }
+        result
+    }
+
+    // Define `name` by an expression over names already in the workspace and
+    // recompute what depends on it. Returns the names whose values changed.
+    pub fn define(&mut self, name: &str, expression: &str) -> Result<Vec<String>, InterpreterError> {
+        let prepared = self.interpreter.prepare(expression)?;
+        for input in prepared.names() {
+            if input == name || self.downstream(name).contains(input.as_str()) {
+                return Err(InterpreterError::BindingError(format!(
+                    "defining '{}' in terms of '{}' would make a cycle", name, input
+                )));
+            }
+            if !self.values.contains_key(input) {
+                return Err(InterpreterError::BindingError(format!("'{}' is not defined", input)));
+            }
+        }
+        self.check_room(name)?;
+        let value = self.interpreter.execute_prepared_with(&prepared, &self.values)?;
+
+        let definition = self.forget_definition(name);
+        self.attach(name, prepared);
+        if self.values.get(name) == Some(&value) {
+            return Ok(Vec::new());
+        }
+        let previous = self.values.insert(name.to_string(), value);
+        let result = self.propagate(name);
+        if result.is_err() {
+            self.restore(name, previous, definition);
+        }
+        result
+    }
+
+    fn check_room(&self, name: &str) -> Result<(), InterpreterError> {
+        if self.values.len() >= MAX_NAMES && !self.values.contains_key(name) {
+            return Err(InterpreterError::BindingError(format!("the workspace is full ({} names)", MAX_NAMES)));
+        }
+        Ok(())
+    }
+
+    fn attach(&mut self, name: &str, prepared: PreparedExpression) {
+        for input in prepared.names() {
+            self.dependents.entry(input.clone()).or_default().push(name.to_string());
+        }
+        self.definitions.insert(name.to_string(), prepared);
+    }
+
+    fn forget_definition(&mut self, name: &str) -> Option<PreparedExpression> {
+        let prepared = self.definitions.remove(name)?;
+        for input in prepared.names() {
+            if let Some(readers) = self.dependents.get_mut(input) {
+                readers.retain(|reader| reader != name);
+            }
+        }
+        Some(prepared)
+    }
+
+    // Put back the value and definition `name` had before a failed update
+    fn restore(&mut self, name: &str, value: Option<JArray>, definition: Option<PreparedExpression>) {
+        self.forget_definition(name);
+        match value {
+            Some(value) => self.values.insert(name.to_string(), value),
+            None => self.values.remove(name),
+        };
+        if let Some(prepared) = definition {
+            self.attach(name, prepared);
+        }
+    }
+
+    // Every definition that reads `name`, directly or through others
+    fn downstream(&self, name: &str) -> HashSet<&str> {
+        let mut reached = HashSet::new();
+        let mut pending = vec![name];
+        while let Some(current) = pending.pop() {
+            for reader in self.dependents.get(current).into_iter().flatten() {
+                if reached.insert(reader.as_str()) {
+                    pending.push(reader);
+                }
+            }
+        }
+        reached
+    }
+
+    // Recompute the definitions downstream of `changed`, whose value has just
+    // been replaced. A definition runs once all of its affected inputs are
+    // settled, and only if one of them actually changed. Each wave is taken in
+    // name order. An error undoes the waves already applied, so the caller
+    // only has to put back `changed` itself.
+    fn propagate(&mut self, changed: &str) -> Result<Vec<String>, InterpreterError> {
+        let affected: HashSet<String> = self.downstream(changed).into_iter().map(String::from).collect();
+        let mut waiting: HashMap<&str, usize> = affected.iter()
+            .map(|name| {
+                let inputs = self.definitions[name].names();
+                (name.as_str(), inputs.iter().filter(|input| affected.contains(*input)).count())
+            })
+            .collect();
+        let mut changed_names: HashSet<String> = HashSet::from([changed.to_string()]);
+        let mut updated = vec![changed.to_string()];
+        let mut previous: Vec<(String, JArray)> = Vec::new();
+
+        let mut wave: Vec<&str> = waiting.iter().filter(|(_, &count)| count == 0).map(|(&name, _)| name).collect();
+        while !wave.is_empty() {
+            wave.sort_unstable();
+            let stale: Vec<&str> = wave.iter().copied()
+                .filter(|name| self.definitions[*name].names().iter().any(|input| changed_names.contains(input)))
+                .collect();
+            let results = match self.evaluate_wave(&stale).into_iter().collect::<Result<Vec<_>, _>>() {
+                Ok(results) => results,
+                Err(error) => {
+                    for (name, value) in previous.into_iter().rev() {
+                        self.values.insert(name, value);
+                    }
+                    return Err(error);
+                }
+            };
+            for (name, value) in stale.iter().zip(results) {
+                if self.values.get(*name) != Some(&value) {
+                    let old = self.values.insert(name.to_string(), value).expect("definitions have values");
+                    previous.push((name.to_string(), old));
+                    changed_names.insert(name.to_string());
+                    updated.push(name.to_string());
+                }
+            }
+
+            let mut next = Vec::new();
+            for name in wave {
+                for reader in self.dependents.get(name).into_iter().flatten() {
+                    let count = waiting.get_mut(reader.as_str()).expect("reader is downstream");
+                    *count -= 1;
+                    if *count == 0 {
+                        next.push(reader.as_str());
+                    }
+                }
+            }
+            wave = next;
+        }
+        Ok(updated)
+    }
+
+    // Evaluate definitions that do not read each other, spreading them over
+    // the available cores
+    fn evaluate_wave(&self, names: &[&str]) -> Vec<Result<JArray, InterpreterError>> {
+        let evaluate = |name: &&str| self.interpreter.execute_prepared_with(&self.definitions[*name], &self.values);
+        let threads = thread::available_parallelism().map_or(1, |n| n.get()).min(names.len());
+        if threads <= 1 {
+            return names.iter().map(evaluate).collect();
+        }
+        let chunk = (names.len() + threads - 1) / threads;
+        let mode = verbs::reduction();
+        thread::scope(|scope| {
+            let workers: Vec<_> = names.chunks(chunk)
+                .map(|chunk| scope.spawn(move || verbs::with_reduction(mode, || chunk.iter().map(evaluate).collect::<Vec<_>>())))
+                .collect();
+            workers.into_iter().flat_map(|worker| worker.join().expect("workspace evaluation panicked")).collect()
+        })
+    }
+}
+
+// Workspaces by client session, the oldest evicted once MAX_SESSIONS are held.
+// With a directory, each session also lives in a file of the updates that
+// built it, locked while a worker reads or writes it; a worker whose copy is
+// behind the file's version rebuilds the session from the file first.
+pub const MAX_SESSIONS: usize = 1024;
+
+// What an update gave a name: a value as typed, or a defining expression
+#[derive(Debug, Clone)]
+pub enum Source {
+    Value(String),
+    Expression(String),
+}
+
+struct Session {
+    workspace: Workspace,
+    // The update that last gave each name its value or definition
+    sources: Vec<(String, Source)>,
+    version: u64,
+}
+
+impl Session {
+    fn new() -> Self {
+        Session { workspace: Workspace::new(), sources: Vec::new(), version: 0 }
+    }
+
+    fn apply(&mut self, name: &str, source: Source) -> Result<Vec<String>, InterpreterError> {
+        let changed = match &source {
+            Source::Value(text) => self.workspace.set(name, parse_binding_value(text)?)?,
+            Source::Expression(text) => self.workspace.define(name, text)?,
+        };
+        self.sources.retain(|(existing, _)| existing != name);
+        self.sources.push((name.to_string(), source));
+        self.version += 1;
+        Ok(changed)
+    }
+
+    // Replay recorded updates: the values first, then each definition once
+    // the names it reads exist
+    fn rebuild(version: u64, sources: Vec<(String, Source)>) -> Result<Self, InterpreterError> {
+        let mut session = Session::new();
+        let (mut pending, values): (Vec<_>, Vec<_>) = sources.into_iter()
+            .partition(|(_, source)| matches!(source, Source::Expression(_)));
+        for (name, source) in values {
+            session.apply(&name, source)?;
+        }
+        while !pending.is_empty() {
+            let before = pending.len();
+            let mut failed = None;
+            pending.retain(|(name, source)| match session.apply(name, source.clone()) {
+                Ok(_) => false,
+                Err(error) => {
+                    failed = Some(error);
+                    true
+                }
+            });
+            if pending.len() == before {
+                return Err(failed.expect("a definition failed"));
+            }
+        }
+        session.version = version;
+        Ok(session)
+    }
+}
+
+pub struct WorkspaceStore {
+    directory: Option<PathBuf>,
+    // Held only to find or add a session; each session has its own lock, so
+    // updates to different sessions evaluate at the same time
+    sessions: Mutex<Sessions>,
+}
+
+struct Sessions {
+    order: VecDeque<String>,
+    by_name: HashMap<String, Arc<Mutex<Session>>>,
+}
+
+impl WorkspaceStore {
+    pub fn new(directory: Option<PathBuf>) -> Self {
+        WorkspaceStore {
+            directory,
+            sessions: Mutex::new(Sessions { order: VecDeque::new(), by_name: HashMap::new() }),
+        }
+    }
+
+    // Apply one update to a session's workspace. Returns the names whose
+    // values changed, with their new values, in the order they were settled.
+    pub fn update(&self, session: &str, name: &str, source: Source) -> Result<Vec<(String, JArray)>, InterpreterError> {
+        if session.is_empty() || session.len() > 64
+            || !session.chars().all(|c| c.is_ascii_alphanumeric() || c == '-' || c == '_')
+        {
+            return Err(InterpreterError::BindingError(
+                "a session is 1 to 64 letters, digits, '-' or '_'".to_string()
+            ));
+        }
+        let entry = self.session(session);
+        let mut current = entry.lock().unwrap();
+
+        let mut file = match &self.directory {
+            Some(directory) => Some(open_session_file(directory, session).map_err(storage_error)?),
+            None => None,
+        };
+        if let Some(file) = file.as_mut() {
+            let (version, sources) = read_sources(file).map_err(storage_error)?;
+            if version != current.version {
+                *current = Session::rebuild(version, sources)?;
+            }
+        }
+
+        let changed = current.apply(name, source)?;
+        if let Some(file) = file.as_mut() {
+            write_sources(file, current.version, &current.sources).map_err(storage_error)?;
+        }
+        Ok(changed.into_iter()
+            .filter_map(|name| current.workspace.get(&name).cloned().map(|value| (name, value)))
+            .collect())
+    }
+
+    // The session's entry, created if it is new
+    fn session(&self, session: &str) -> Arc<Mutex<Session>> {
+        let mut sessions = self.sessions.lock().unwrap();
+        if let Some(entry) = sessions.by_name.get(session) {
+            return Arc::clone(entry);
+        }
+        sessions.order.push_back(session.to_string());
+        while sessions.order.len() > MAX_SESSIONS {
+            if let Some(oldest) = sessions.order.pop_front() {
+                sessions.by_name.remove(&oldest);
+            }
+        }
+        let entry = Arc::new(Mutex::new(Session::new()));
+        sessions.by_name.insert(session.to_string(), Arc::clone(&entry));
+        entry
+    }
+}
+
+fn storage_error(error: std::io::Error) -> InterpreterError {
+    InterpreterError::BindingError(format!("workspace storage: {}", error))
+}
+
+// The session's file, locked until it is dropped. Creating one past
+// MAX_SESSIONS removes the least recently written.
+fn open_session_file(directory: &Path, session: &str) -> std::io::Result<File> {
+    let path = directory.join(session);
+    let created = !path.exists();
+    let file = OpenOptions::new().read(true).write(true).create(true).truncate(false).open(&path)?;
+    file.lock()?;
+    if created {
+        let mut files: Vec<_> = fs::read_dir(directory)?
+            .filter_map(|entry| entry.ok())
+            .filter_map(|entry| Some((entry.metadata().ok()?.modified().ok()?, entry.path())))
+            .collect();
+        if files.len() > MAX_SESSIONS {
+            let excess = files.len() - MAX_SESSIONS;
+            files.sort();
+            for (_, oldest) in files.into_iter().filter(|(_, other)| *other != path).take(excess) {
+                let _ = fs::remove_file(oldest);
+            }
+        }
+    }
+    Ok(file)
+}
+
+// A session file is its version on the first line, then one line per name:
+//   value<TAB>name<TAB>text  or  expression<TAB>name<TAB>text
+// with backslashes, tabs and newlines in the text escaped
+fn read_sources(file: &mut File) -> std::io::Result<(u64, Vec<(String, Source)>)> {
+    let mut contents = String::new();
+    file.read_to_string(&mut contents)?;
+    let mut lines = contents.lines();
+    let version = lines.next().and_then(|line| line.parse().ok()).unwrap_or(0);
+    let sources = lines
+        .filter_map(|line| {
+            let mut fields = line.splitn(3, '\t');
+            let (kind, name, text) = (fields.next()?, fields.next()?, unescape(fields.next()?));
+            let source = match kind {
+                "value" => Source::Value(text),
+                "expression" => Source::Expression(text),
+                _ => return None,
+            };
+            Some((name.to_string(), source))
+        })
+        .collect();
+    Ok((version, sources))
+}
+
+fn write_sources(file: &mut File, version: u64, sources: &[(String, Source)]) -> std::io::Result<()> {
+    let mut contents = format!("{}\n", version);
+    for (name, source) in sources {
+        let (kind, text) = match source {
+            Source::Value(text) => ("value", text),
+            Source::Expression(text) => ("expression", text),
+        };
+        contents.push_str(&format!("{}\t{}\t{}\n", kind, name, escape(text)));
+    }
+    file.set_len(0)?;
+    file.seek(SeekFrom::Start(0))?;
+    file.write_all(contents.as_bytes())
+}
+
+fn escape(text: &str) -> String {
+    text.replace('\\', "\\\\").replace('\t', "\\t").replace('\n', "\\n")
+}
+
+fn unescape(text: &str) -> String {
+    let mut result = String::with_capacity(text.len());
+    let mut chars = text.chars();
+    while let Some(c) = chars.next() {
+        if c != '\\' {
+            result.push(c);
+            continue;
+        }
+        match chars.next() {
+            Some('t') => result.push('\t'),
+            Some('n') => result.push('\n'),
+            Some(other) => result.push(other),
+            None => {}
+        }
+    }
+    result
+}
@@ -12,6 +12,19 @@ class WasmHttpAdapter {
                 json: () => Promise.resolve(JSON.parse(response))
             };
         }
+        // Prepared expressions: same JSON bodies as the server endpoints
+        if (url === '/j_prepare' && options.method === 'POST') {
+            const response = this.wasm.handle_j_prepare_request(options.body);
+            return {
+                json: () => Promise.resolve(JSON.parse(response))
+            };
+        }
+        if (url === '/j_execute' && options.method === 'POST') {
+            const response = this.wasm.handle_j_execute_request(options.body);
+            return {
+                json: () => Promise.resolve(JSON.parse(response))
+            };
+        }
         throw new Error('Unsupported request');
     }
 }
@@ -20,7 +33,7 @@ class WasmHttpAdapter {
 let wasmAdapter;
 const originalFetch = window.fetch;
 window.fetch = async function(url, options) {
-    if (wasmAdapter && url === '/j_eval') {
+    if (wasmAdapter && (url === '/j_eval' || url === '/j_prepare' || url === '/j_execute')) {
         return wasmAdapter.fetch(url, options);
     }
     return originalFetch(url, options);